@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "host_test.h"
+#include "usb_storage.h"
+
+/*
+ * Segment writer (usb_log_append, flushed like the data logger does) against
+ * the per-record path it replaced (usb_append_log: open, write, fsync, close
+ * for every line). Both write the same lines, so the closed segment must be
+ * byte-identical to the old log file.
+ */
+#define BENCH_SEG_RECORDS       20000
+#define BENCH_SEG_FLUSH_EVERY   50      // records between flushes (5 s at 10 Hz)
+#define BENCH_SEG_LINES         64      // distinct lines cycled through
+
+static char s_lines[BENCH_SEG_LINES][96];
+
+static bool same_file(const char *a, const char *b)
+{
+    FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+    bool same = fa && fb;
+    while (same) {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        if (ca != cb) same = false;
+        if (ca == EOF || cb == EOF) break;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return same;
+}
+
+int bench_seg_writer(void)
+{
+    int failures = 0;
+    const char *root = host_test_scratch("seg_writer");
+    usb_storage_init(root);
+    for (int i = 0; i < BENCH_SEG_LINES; i++) {
+        snprintf(s_lines[i], sizeof(s_lines[i]), "{\"ts\":%d, \"rpm\":%d, \"speed\":%d, \"maf\":%d.%02d}",
+                 1000000 + i * 100, 800 + i * 37, i, i / 3, i % 100);
+    }
+
+    long long t0 = host_test_now_ns();
+    for (int i = 0; i < BENCH_SEG_RECORDS; i++) {
+        if (usb_append_log("old/log.json", s_lines[i % BENCH_SEG_LINES]) != 0) {
+            failures++;
+            break;
+        }
+    }
+    long long old_ns = host_test_now_ns() - t0;
+
+    t0 = host_test_now_ns();
+    if (usb_log_open("new") != 0) failures++;
+    for (int i = 0; i < BENCH_SEG_RECORDS; i++) {
+        const char *line = s_lines[i % BENCH_SEG_LINES];
+        if (usb_log_append(i, line, strlen(line)) != 0) {
+            failures++;
+            break;
+        }
+        if ((i + 1) % BENCH_SEG_FLUSH_EVERY == 0) usb_log_flush();
+    }
+    usb_log_close();
+    long long new_ns = host_test_now_ns() - t0;
+
+    printf("bench_seg_writer: %d records, old %.0f ns/record, new %.0f ns/record, speedup %.1fx\n",
+           BENCH_SEG_RECORDS, (double)old_ns / BENCH_SEG_RECORDS, (double)new_ns / BENCH_SEG_RECORDS,
+           new_ns ? (double)old_ns / (double)new_ns : 0.0);
+
+    char old_path[192], new_path[192], end_path[192];
+    snprintf(old_path, sizeof(old_path), "%s/old/log.json", root);
+    snprintf(new_path, sizeof(new_path), "%s/new/seg-00001.json", root);
+    snprintf(end_path, sizeof(end_path), "%s/new/seg-00001.end", root);
+    if (!same_file(old_path, new_path)) {
+        printf("bench_seg_writer: closed segment differs from the per-record log\n");
+        failures++;
+    }
+    struct stat st;
+    if (stat(end_path, &st) == 0) {
+        printf("bench_seg_writer: end marker left after close\n");
+        failures++;
+    }
+    usb_storage_deinit();
+    return failures;
+}
@@ -0,0 +1,27 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+/*
+ * Host benchmarks and checks, run in list order by host_test_main.c. Each
+ * prints its figures as "<name>: ..." lines for pytest_host_test.py and
+ * returns the number of failed checks.
+ */
+#define HOST_TEST_LIST(X) \
+    X(bench_seg_writer) \
+    X(test_record_json) \
+    X(test_obd_plan) \
+    X(test_can_frame)
+
+#define HOST_TEST_DECL(name) int name(void);
+HOST_TEST_LIST(HOST_TEST_DECL)
+#undef HOST_TEST_DECL
+
+#define HOST_TEST_DIR   "host_test_run"     // scratch "stick", recreated by every test that uses it
+
+/** Remove and recreate HOST_TEST_DIR/sub, returns its path. */
+const char *host_test_scratch(const char *sub);
+
+/** Monotonic time in nanoseconds. */
+long long host_test_now_ns(void);
+
+#endif // HOST_TEST_H
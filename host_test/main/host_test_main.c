@@ -0,0 +1,48 @@
+#define _XOPEN_SOURCE 700     // nftw()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include "host_test.h"
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw)
+{
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+const char *host_test_scratch(const char *sub)
+{
+    static char path[128];
+    snprintf(path, sizeof(path), "%s/%s", HOST_TEST_DIR, sub);
+    nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    mkdir(HOST_TEST_DIR, 0755);
+    mkdir(path, 0755);
+    return path;
+}
+
+long long host_test_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void app_main(void)
+{
+    int failures = 0;
+#define HOST_TEST_RUN(name) \
+    do { \
+        int f = name(); \
+        printf("%s: %s\n", #name, f ? "FAIL" : "PASS"); \
+        failures += f; \
+    } while (0);
+    HOST_TEST_LIST(HOST_TEST_RUN)
+#undef HOST_TEST_RUN
+    printf("host_test done: %d failures\n", failures);
+    fflush(stdout);
+    exit(failures ? 1 : 0);
+}
@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <string.h>
+#include "host_test.h"
+#include "can_frame.h"
+
+/*
+ * Monitor-mode parser (can_frame.c): ATMA lines fed in arbitrary chunks,
+ * Intel and Motorola signals (signed, unaligned, crossing bytes), adapter
+ * messages counted as overruns or errors, then the parse rate against what
+ * a saturated bus can deliver.
+ */
+#define CAN_FRAME_BENCH_FRAMES  200000
+#define CAN_FRAME_BUS_MAX_FPS   4500        // 8-byte frames/s on a fully loaded 500 kbit/s bus
+#define CAN_FRAME_CHUNK         256         // bytes per link read, as in obd_monitor_task
+
+static const can_signal_t s_test_signals[] = {
+    // ch, start, len, intel, signed, id, num, den, offset
+    { OBD_CH_RPM,      16, 16, 1, 0, 0x280, 1, 4,   0 },   // Intel, bytes 2-3 (the VAG Motor_1 rpm)
+    { OBD_CH_COOLANT,   4,  8, 1, 1, 0x281, 1, 1,   0 },   // Intel signed, across bytes 0-1
+    { OBD_CH_SPEED,     7, 16, 0, 0, 0x3E0, 1, 1,   0 },   // Motorola, bytes 0-1
+    { OBD_CH_THROTTLE,  3, 12, 0, 0, 0x3E1, 1, 1,   0 },   // Motorola, low nibble of byte 0 + byte 1
+    { OBD_CH_MAF,      15,  8, 0, 1, 0x3E2, 10, 1, -5 },   // Motorola signed, byte 1, scaled
+    { OBD_CH_RPM,      56, 16, 1, 0, 0x3E3, 1, 1,   0 },   // Intel past a short payload: skipped
+};
+#define TEST_SIGNAL_COUNT   ((int)(sizeof(s_test_signals) / sizeof(s_test_signals[0])))
+
+static int s_failures;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok && s_failures++ < 20) printf("test_can_frame: FAILED %s\n", what);
+}
+
+// Feed one line in chunks of chunk bytes; true if the value of ch became expect
+static bool decodes(const char *line, size_t chunk, int ch, int32_t expect)
+{
+    static obd_record_t rec;
+    static obd_monitor_stats_t stats;
+    static can_frame_parser_t p;
+    memset(&rec, 0, sizeof(rec));
+    can_frame_init(&p, s_test_signals, TEST_SIGNAL_COUNT, &rec, &stats);
+    size_t len = strlen(line);
+    for (size_t i = 0; i < len; i += chunk) {
+        can_frame_feed(&p, (const uint8_t *)line + i, len - i < chunk ? len - i : chunk);
+    }
+    return (rec.valid & (1u << ch)) && rec.v[ch] == expect;
+}
+
+static void check_decode(const char *line, int ch, int32_t expect)
+{
+    static const size_t chunks[] = { 1, 3, 64 };
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        if (!decodes(line, chunks[i], ch, expect)) {
+            char what[128];
+            snprintf(what, sizeof(what), "\"%.*s\" (chunks of %zu) should give %ld on channel %d",
+                     (int)strcspn(line, "\r"), line, chunks[i], (long)expect, ch);
+            check(false, what);
+        }
+    }
+}
+
+static void check_stream(void)
+{
+    // what an ELM327 prints around a buffer overrun, then a re-armed monitor
+    static const char stream[] =
+        "2800011D00C00000000\r"     // frame
+        "3E01234\r"                 // frame, 2 bytes
+        "\r"                        // blank
+        "CAN ERROR\r"               // error
+        "2800\r"                    // odd number of data digits: error
+        "280001122334455667788\r"   // 9 data bytes: error
+        "7FF00\r"                   // frame, no signal of the table
+        "BUFFER FULL\r"             // overrun
+        ">"                         // prompt: monitoring stopped
+        "STOPPED\r"                 // answer to the re-arming command: ignored
+        "3E2FF80\r";                // frame
+    obd_record_t rec = { 0 };
+    obd_monitor_stats_t stats = { 0 };
+    can_frame_parser_t p;
+    can_frame_init(&p, s_test_signals, TEST_SIGNAL_COUNT, &rec, &stats);
+    bool prompt = can_frame_feed(&p, (const uint8_t *)stream, sizeof(stream) - 1);
+    check(prompt, "prompt after BUFFER FULL not reported");
+    check(stats.frames == 4, "frames");
+    check(stats.decoded == 3, "decoded");
+    check(stats.overruns == 1, "BUFFER FULL not counted as an overrun");
+    check(stats.errors == 3, "errors");
+    check(rec.v[OBD_CH_MAF] == 10 * -128 - 5, "frame after the re-arm");
+    if (s_failures) {
+        printf("test_can_frame: frames %u decoded %u overruns %u errors %u\n", (unsigned)stats.frames,
+               (unsigned)stats.decoded, (unsigned)stats.overruns, (unsigned)stats.errors);
+    }
+}
+
+static void bench(void)
+{
+    static const char *const lines[] = {
+        "2800011D00C00000000\r", "281F00F\r", "3E012345678\r", "3E1ABCD\r", "3E2FF80AA\r", "5A0010203040506\r",
+    };
+    static char stream[CAN_FRAME_BENCH_FRAMES * 20];
+    size_t len = 0;
+    for (int i = 0; i < CAN_FRAME_BENCH_FRAMES; i++) {
+        const char *l = lines[i % (sizeof(lines) / sizeof(lines[0]))];
+        size_t n = strlen(l);
+        memcpy(stream + len, l, n);
+        len += n;
+    }
+
+    obd_record_t rec = { 0 };
+    obd_monitor_stats_t stats = { 0 };
+    can_frame_parser_t p;
+    can_frame_init(&p, s_test_signals, TEST_SIGNAL_COUNT, &rec, &stats);
+    long long t0 = host_test_now_ns();
+    for (size_t i = 0; i < len; i += CAN_FRAME_CHUNK) {
+        can_frame_feed(&p, (const uint8_t *)stream + i, len - i < CAN_FRAME_CHUNK ? len - i : CAN_FRAME_CHUNK);
+    }
+    long long ns = host_test_now_ns() - t0;
+    check(stats.frames == CAN_FRAME_BENCH_FRAMES, "benchmark frames lost");
+    double fps = ns ? CAN_FRAME_BENCH_FRAMES * 1e9 / (double)ns : 0.0;
+    printf("test_can_frame: %d frames, %.1f ns/frame, %.0f frames/s (bus max %d)\n", CAN_FRAME_BENCH_FRAMES,
+           (double)ns / CAN_FRAME_BENCH_FRAMES, fps, CAN_FRAME_BUS_MAX_FPS);
+    check(fps > CAN_FRAME_BUS_MAX_FPS, "parser slower than a saturated bus");
+}
+
+int test_can_frame(void)
+{
+    s_failures = 0;
+
+    check_decode("2800011D00C00000000\r", OBD_CH_RPM, 0x0CD0 / 4);
+    check_decode("281F00F\r", OBD_CH_COOLANT, -1);                  // 0x0FF0 >> 4 = 0xFF
+    check_decode("281F007\r", OBD_CH_COOLANT, 0x7F);                 // 0x07F0 >> 4
+    check_decode("3E01234\r", OBD_CH_SPEED, 0x1234);
+    check_decode("3E0FFFF0102\r", OBD_CH_SPEED, 0xFFFF);
+    check_decode("3E1ABCD\r", OBD_CH_THROTTLE, 0xBCD);
+    check_decode("3E2007F\r", OBD_CH_MAF, 10 * 127 - 5);
+    check_decode("3E200FE\r", OBD_CH_MAF, 10 * -2 - 5);
+    check_decode("3E20080\r", OBD_CH_MAF, 10 * -128 - 5);
+    check(!decodes("3E30102\r", 1, OBD_CH_RPM, 0x0201), "Intel signal past the payload decoded");
+    check(!decodes("3E01234\r", 1, OBD_CH_RPM, 0), "signal of another ID decoded");
+
+    // the firmware's own table: same IDs as obd_can_monitor programs into the filter
+    check(can_signal_count() > 0 && can_signals()[0].id == 0x280, "can_signals.h table");
+
+    check_stream();
+    bench();
+    printf("test_can_frame: %d failures\n", s_failures);
+    return s_failures;
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include "host_test.h"
+#include "obd_plan.h"
+
+/*
+ * Manifest formula compiler and bytecode interpreter: the channel table's
+ * formulas, given as a manifest, must decode every reply exactly like their
+ * C versions; then operator precedence and associativity, and the errors a
+ * bad manifest line has to be rejected with.
+ */
+#define OBD_PLAN_TEST_SLOT_KEY  "t"     // scratch channel the single formulas are compiled into
+
+static int s_failures;
+
+static void check(bool ok, const char *what)
+{
+    if (!ok && s_failures++ < 20) printf("test_obd_plan: FAILED %s\n", what);
+}
+
+static int slot_of(const char *key)
+{
+    for (int i = 0; i < obd_slot_count(); i++) {
+        if (strcmp(obd_slots()[i].key, key) == 0) return i;
+    }
+    return -1;
+}
+
+// Compile "t 0C <bytes> 0 FAST 0 ENGINE <formula>"; NULL and *out = its value on d, or the error
+static const char *eval(const char *formula, int bytes, const uint8_t *d, int32_t *out)
+{
+    static char err[64];
+    char line[OBD_PLAN_TEXT_MAX];
+    int len = snprintf(line, sizeof(line), OBD_PLAN_TEST_SLOT_KEY " 0C %d 0 FAST 0 ENGINE %s\n", bytes, formula);
+    if (obd_plan_load(line, (size_t)len, err, sizeof(err)) < 0) return err;
+    obd_plan_adopt();
+    *out = obd_plan_decode(obd_plan_active(), slot_of(OBD_PLAN_TEST_SLOT_KEY), d);
+    return NULL;
+}
+
+static void check_value(const char *formula, uint8_t a, uint8_t b, uint8_t c, int32_t expect)
+{
+    const uint8_t d[4] = { a, b, c, 0 };
+    int32_t v = 0;
+    const char *err = eval(formula, 3, d, &v);
+    if (err || v != expect) {
+        char what[128];
+        snprintf(what, sizeof(what), "%s with A=%u B=%u C=%u: %s %ld, expected %ld", formula, a, b, c,
+                 err ? err : "got", (long)v, (long)expect);
+        check(false, what);
+    }
+}
+
+static void check_error(const char *formula, int bytes, const char *expect)
+{
+    static const uint8_t d[4];
+    int32_t v;
+    const char *err = eval(formula, bytes, d, &v);
+    char what[160];
+    snprintf(what, sizeof(what), "%.60s: %s, expected \"%s\"", formula, err ? err : "accepted", expect);
+    check(err && strstr(err, expect), what);
+}
+
+// The built-in table as a manifest: same keys, so the same slots, but compiled formulas
+static void check_builtin_formulas(void)
+{
+    static char text[OBD_PLAN_TEXT_MAX];
+    int len = 0;
+#define PLAN_TEST_LINE(id, key, pid, bytes, decimals, formula, rate, deadband, ecu) \
+    len += snprintf(text + len, sizeof(text) - len, "%s %02X %d %d %s %d %s %s\n", \
+                    key, pid, bytes, decimals, #rate, deadband, #ecu, #formula);
+    OBD_CHANNEL_LIST(PLAN_TEST_LINE)
+#undef PLAN_TEST_LINE
+
+    char err[64] = "";
+    obd_plan_load("", 0, err, sizeof(err));    // built-in table, C formulas
+    obd_plan_adopt();
+    static obd_plan_t native;
+    native = *obd_plan_active();
+    check(obd_plan_load(text, (size_t)len, err, sizeof(err)) == OBD_CH_COUNT, err);
+    obd_plan_adopt();
+    const obd_plan_t *compiled = obd_plan_active();
+
+    long decodes = 0;
+    for (int ch = 0; ch < OBD_CH_COUNT; ch++) {
+        // every value of the bytes the channel's reply has (the table's replies are at most 2 bytes)
+        int b_max = compiled->bytes[ch] > 1 ? 255 : 0;
+        for (int a = 0; a <= 255; a++) {
+            for (int b = 0; b <= b_max; b++) {
+                const uint8_t d[4] = { (uint8_t)a, (uint8_t)b, 0, 0 };
+                int32_t want = obd_plan_decode(&native, ch, d), got = obd_plan_decode(compiled, ch, d);
+                decodes++;
+                if (got != want) {
+                    char what[96];
+                    snprintf(what, sizeof(what), "%s A=%d B=%d: bytecode %ld, C %ld", obd_slots()[ch].key, a, b,
+                             (long)got, (long)want);
+                    check(false, what);
+                }
+            }
+        }
+    }
+    printf("test_obd_plan: %ld decodes of %d built-in formulas checked against C\n", decodes, OBD_CH_COUNT);
+}
+
+int test_obd_plan(void)
+{
+    s_failures = 0;
+    obd_plan_init();
+    check_builtin_formulas();
+
+    check_value("A*256+B", 2, 3, 0, 515);
+    check_value("A + B * 256", 2, 3, 0, 770);
+    check_value("A-B-C", 10, 3, 2, 5);
+    check_value("A/B/C", 100, 5, 2, 10);
+    check_value("A<<8|B", 1, 1, 0, 257);
+    check_value("A | B & C", 1, 6, 3, 3);
+    check_value("A << 1 + B", 1, 2, 0, 8);
+    check_value("-A+B", 5, 2, 0, -3);
+    check_value("A*-B", 5, 2, 0, -10);
+    check_value("--A", 7, 0, 0, 7);
+    check_value("-(A-B)", 5, 2, 0, -3);
+    check_value("(A - 40) * 9 / 5 + 32", 140, 0, 0, 212);
+    check_value("040 + 0x10", 0, 0, 0, 56);
+    check_value("A / (B - B)", 9, 1, 0, 0);
+    check_value("2147483647 + A", 1, 0, 0, INT32_MIN);
+
+    check_error("(A + B", 2, "missing )");
+    check_error("A + 4294967296", 1, "constant out of range");
+    check_error("B", 1, "more bytes than the reply has");
+    check_error("A + D", 3, "more bytes than the reply has");
+    check_error("A +", 1, "expected A-D");
+    check_error("A $ B", 2, "unexpected character");
+    char deep[64];
+    memset(deep, '(', OBD_PLAN_NEST_MAX + 1);
+    strcpy(deep + OBD_PLAN_NEST_MAX + 1, "A");
+    check_error(deep, 1, "too deeply nested");
+    memset(deep, '-', OBD_PLAN_NEST_MAX + 1);
+    check_error(deep, 1, "too deeply nested");
+    check_value(deep + 1, 3, 0, 0, 3);      // OBD_PLAN_NEST_MAX (even) minus signs: accepted
+
+    char err[64];
+    obd_plan_load("", 0, err, sizeof(err));    // leave the built-in table in use
+    obd_plan_adopt();
+    printf("test_obd_plan: %d failures\n", s_failures);
+    return s_failures;
+}
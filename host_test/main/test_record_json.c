@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "host_test.h"
+#include "record_json.h"
+#include "obd_plan.h"
+
+/*
+ * obd_record_to_json() against the snprintf formatting it replaced: random
+ * records (plus the extremes of every field) must serialize byte for byte
+ * the same, then both are timed on the same records.
+ */
+#define RECORD_JSON_CHECKS      100000
+#define RECORD_JSON_BENCH       200000
+#define RECORD_JSON_POOL        1024        // distinct records cycled through by the benchmark
+
+static obd_record_t s_pool[RECORD_JSON_POOL];
+
+static uint32_t s_rng = 0x2545F491;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+// The old formatting: one snprintf per field, fixed point split with / and %
+static size_t record_json_snprintf(const obd_record_t *rec, char *buf, size_t buf_sz)
+{
+    const obd_slot_t *slots = obd_slots();
+    int n = snprintf(buf, buf_sz, "{\"ts\":%" PRId64, rec->ts);
+    for (int i = 0; i < OBD_CH_MAX; i++) {
+        if (!(rec->valid & (1u << i))) continue;
+        int64_t v = rec->v[i];
+        const char *sign = v < 0 ? "-" : "";
+        if (v < 0) v = -v;
+        if (slots[i].decimals == 0) {
+            n += snprintf(buf + n, buf_sz - n, ", \"%s\":%s%" PRId64, slots[i].key, sign, v);
+        } else {
+            int64_t scale = 1;
+            for (int d = 0; d < slots[i].decimals; d++) scale *= 10;
+            n += snprintf(buf + n, buf_sz - n, ", \"%s\":%s%" PRId64 ".%0*" PRId64, slots[i].key, sign,
+                          v / scale, (int)slots[i].decimals, v % scale);
+        }
+    }
+    n += snprintf(buf + n, buf_sz - n, "}");
+    return (size_t)n;
+}
+
+static int32_t rnd_value(void)
+{
+    static const int32_t edges[] = { 0, 1, -1, 9, 10, 99, 100, -100, 12345, INT32_MAX, INT32_MIN, INT32_MIN + 1 };
+    switch (rnd() % 4) {
+    case 0: return edges[rnd() % (sizeof(edges) / sizeof(edges[0]))];
+    case 1: return (int32_t)(rnd() % 10000);
+    case 2: return (int32_t)(rnd() % 2000) - 1000;
+    default: return (int32_t)rnd();
+    }
+}
+
+static void rnd_record(obd_record_t *rec)
+{
+    static const int64_t edges[] = { 0, 1, 999, 1000, 4294967295LL, 4294967296LL, 99999999999999999LL,
+                                     INT64_MAX, -1, INT64_MIN };
+    memset(rec, 0, sizeof(*rec));
+    rec->ts = rnd() % 8 == 0 ? edges[rnd() % (sizeof(edges) / sizeof(edges[0]))]
+                             : (int64_t)(((uint64_t)rnd() << 32 | rnd()) >> (rnd() % 40));
+    rec->valid = rnd() % 8 == 0 ? (1u << OBD_CH_COUNT) - 1 : rnd() & ((1u << OBD_CH_COUNT) - 1);
+    for (int i = 0; i < OBD_CH_COUNT; i++) rec->v[i] = rnd_value();
+}
+
+int test_record_json(void)
+{
+    int failures = 0;
+    obd_plan_init();    // built-in channel slots (no NVS: no saved manifest)
+    static char a[OBD_RECORD_JSON_MAX], b[OBD_RECORD_JSON_MAX + 64];
+
+    for (int i = 0; i < RECORD_JSON_CHECKS; i++) {
+        obd_record_t rec;
+        rnd_record(&rec);
+        size_t na = obd_record_to_json(&rec, a, sizeof(a));
+        size_t nb = record_json_snprintf(&rec, b, sizeof(b));
+        if (na != nb || memcmp(a, b, na) != 0) {
+            if (failures++ < 5) {
+                printf("test_record_json: mismatch\n  new %.*s\n  old %.*s\n", (int)na, a, (int)nb, b);
+            }
+        }
+    }
+
+    for (int i = 0; i < RECORD_JSON_POOL; i++) {
+        rnd_record(&s_pool[i]);
+        s_pool[i].ts = 1000000 + i * 100;               // realistic: ms since boot
+        s_pool[i].valid = (1u << OBD_CH_COUNT) - 1;     // every channel sampled
+        for (int ch = 0; ch < OBD_CH_COUNT; ch++) s_pool[i].v[ch] = (int32_t)(rnd() % 5000);
+    }
+    size_t sink = 0;
+    long long t0 = host_test_now_ns();
+    for (int i = 0; i < RECORD_JSON_BENCH; i++) sink += obd_record_to_json(&s_pool[i % RECORD_JSON_POOL], a, sizeof(a));
+    long long new_ns = host_test_now_ns() - t0;
+    t0 = host_test_now_ns();
+    for (int i = 0; i < RECORD_JSON_BENCH; i++) sink += record_json_snprintf(&s_pool[i % RECORD_JSON_POOL], b, sizeof(b));
+    long long old_ns = host_test_now_ns() - t0;
+
+    printf("test_record_json: %d records identical to snprintf, %d mismatches\n", RECORD_JSON_CHECKS - failures, failures);
+    printf("test_record_json: obd_record_to_json %.1f ns/record, snprintf %.1f ns/record, speedup %.1fx (%zu bytes)\n",
+           (double)new_ns / RECORD_JSON_BENCH, (double)old_ns / RECORD_JSON_BENCH,
+           new_ns ? (double)old_ns / (double)new_ns : 0.0, sink);
+    return failures;
+}
@@ -0,0 +1,37 @@
+# SPDX-License-Identifier: CC0-1.0
+import logging
+
+import pytest
+from pytest_embedded_idf.dut import IdfDut
+from pytest_embedded_idf.utils import idf_parametrize
+
+
+@pytest.mark.host_test
+@idf_parametrize('target', ['linux'], indirect=['target'])
+def test_host_benchmarks(dut: IdfDut) -> None:
+    seg = dut.expect(r'bench_seg_writer: \d+ records, old (\d+) ns/record, new (\d+) ns/record', timeout=120)
+    old_ns, new_ns = int(seg.group(1)), int(seg.group(2))
+    logging.info('segment writer: old %d ns/record, new %d ns/record', old_ns, new_ns)
+    assert new_ns < old_ns, 'segment writer is not faster than the per-record path'
+    dut.expect_exact('bench_seg_writer: PASS')
+
+    same = dut.expect(r'test_record_json: (\d+) records identical to snprintf, (\d+) mismatches', timeout=60)
+    assert int(same.group(2)) == 0, 'obd_record_to_json output differs from the snprintf format'
+    ser = dut.expect(r'test_record_json: obd_record_to_json ([\d.]+) ns/record, snprintf ([\d.]+) ns/record')
+    logging.info('record_json: %s ns/record, snprintf %s ns/record', ser.group(1).decode(), ser.group(2).decode())
+    assert float(ser.group(1)) < float(ser.group(2)), 'obd_record_to_json is not faster than snprintf'
+    dut.expect_exact('test_record_json: PASS')
+
+    plan = dut.expect(r'test_obd_plan: (\d+) decodes of (\d+) built-in formulas checked against C', timeout=60)
+    logging.info('obd_plan: %s decodes of %s built-in formulas', plan.group(1).decode(), plan.group(2).decode())
+    dut.expect(r'test_obd_plan: 0 failures')
+    dut.expect_exact('test_obd_plan: PASS')
+
+    can = dut.expect(r'test_can_frame: (\d+) frames, ([\d.]+) ns/frame, (\d+) frames/s \(bus max (\d+)\)', timeout=60)
+    logging.info('can_frame: %s ns/frame, %s frames/s', can.group(2).decode(), can.group(3).decode())
+    assert int(can.group(3)) > int(can.group(4)), 'monitor parser is slower than a saturated bus'
+    dut.expect(r'test_can_frame: 0 failures')
+    dut.expect_exact('test_can_frame: PASS')
+
+    done = dut.expect(r'host_test done: (\d+) failures', timeout=60)
+    assert int(done.group(1)) == 0
@@ -0,0 +1,78 @@
+#ifndef APP_ALLOC_H
+#define APP_ALLOC_H
+
+/*
+ * Build option for heap-free steady state. With APP_STATIC_ALLOC=1 every
+ * task, queue and buffer of the application is placed in static storage at
+ * link time, so nothing is taken from the heap after boot and long drives
+ * cannot fragment it. With 0 the same call sites fall back to the dynamic
+ * FreeRTOS constructors.
+ *
+ * Usage at file scope:
+ *     APP_TASK_STORAGE(poll_task, 4096);
+ *     APP_TASK_CREATE(poll_task, fn, "name", arg, prio, &handle);
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+
+#ifndef APP_STATIC_ALLOC
+#define APP_STATIC_ALLOC 1
+#endif
+
+#if APP_STATIC_ALLOC
+
+#define APP_TASK_STORAGE(name, stack_bytes) \
+    static StaticTask_t name##_tcb; \
+    static StackType_t name##_stack[stack_bytes]
+#define APP_TASK_CREATE(name, fn, label, arg, prio, handle_out) \
+    app_task_create_static(fn, label, sizeof(name##_stack), arg, prio, name##_stack, &name##_tcb, handle_out)
+
+#define APP_QUEUE_STORAGE(name, len, item_sz) \
+    static StaticQueue_t name##_qcb; \
+    static uint8_t name##_qbuf[(len) * (item_sz)]
+#define APP_QUEUE_CREATE(name, len, item_sz) \
+    xQueueCreateStatic(len, item_sz, name##_qbuf, &name##_qcb)
+
+#define APP_STREAM_STORAGE(name, size) \
+    static StaticStreamBuffer_t name##_scb; \
+    static uint8_t name##_sbuf[(size) + 1]
+#define APP_STREAM_CREATE(name, size, trigger) \
+    xStreamBufferCreateStatic(size, trigger, name##_sbuf, &name##_scb)
+
+#define APP_MUTEX_STORAGE(name) \
+    static StaticSemaphore_t name##_mcb
+#define APP_MUTEX_CREATE(name) \
+    xSemaphoreCreateMutexStatic(&name##_mcb)
+
+// xTaskCreateStatic returns the handle; keep the xTaskCreate calling convention
+static inline BaseType_t app_task_create_static(TaskFunction_t fn, const char *label, uint32_t stack_bytes,
+                                                void *arg, UBaseType_t prio, StackType_t *stack,
+                                                StaticTask_t *tcb, TaskHandle_t *handle_out)
+{
+    TaskHandle_t h = xTaskCreateStatic(fn, label, stack_bytes, arg, prio, stack, tcb);
+    if (handle_out) *handle_out = h;
+    return h ? pdPASS : pdFAIL;
+}
+
+#else // dynamic allocation
+
+#define APP_TASK_STORAGE(name, stack_bytes)     enum { name##_stack_bytes = (stack_bytes) }
+#define APP_TASK_CREATE(name, fn, label, arg, prio, handle_out) \
+    xTaskCreate(fn, label, name##_stack_bytes, arg, prio, handle_out)
+
+#define APP_QUEUE_STORAGE(name, len, item_sz)   enum { name##_unused_q }
+#define APP_QUEUE_CREATE(name, len, item_sz)    xQueueCreate(len, item_sz)
+
+#define APP_STREAM_STORAGE(name, size)          enum { name##_unused_s }
+#define APP_STREAM_CREATE(name, size, trigger)  xStreamBufferCreate(size, trigger)
+
+#define APP_MUTEX_STORAGE(name)                 enum { name##_unused_m }
+#define APP_MUTEX_CREATE(name)                  xSemaphoreCreateMutex()
+
+#endif // APP_STATIC_ALLOC
+
+#endif // APP_ALLOC_H
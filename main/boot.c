@@ -0,0 +1,222 @@
+#include "boot.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs_flash.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "wifi_manager.h"
+#include "network_upload.h"
+#endif
+#include "usb_storage.h"
+#include "obd_bluetooth.h"
+#include "obd_can_monitor.h"
+#include "obd_plan.h"
+#include "data_logger.h"
+#include "dlog.h"
+#include "log_clock.h"
+#include "http_api.h"
+#include "app_alloc.h"
+
+static const char *TAG = "boot";
+
+#define LINUX_STORAGE_DIR "usb_host_run"   // storage root when running on the Linux target
+
+static esp_err_t boot_nvs(void)
+{
+    esp_err_t ret = nvs_flash_init();
+    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ret = nvs_flash_erase();
+        if (ret == ESP_OK) ret = nvs_flash_init();
+    }
+    return ret;
+}
+
+static esp_err_t boot_clock(void)
+{
+    return log_clock_init();
+}
+
+static esp_err_t boot_logger(void)
+{
+    dlog_start();
+    return data_logger_start("logs");
+}
+
+static esp_err_t boot_bt(void)
+{
+    return obd_bt_init();
+}
+
+static esp_err_t boot_plan(void)
+{
+    return obd_plan_init();
+}
+
+static esp_err_t boot_obd(void)
+{
+#if CONFIG_OBD_CAN_MONITOR
+    esp_err_t err = obd_start_monitor(MAC_ADDRESS_OBD, 1000);
+#else
+    esp_err_t err = obd_start_polling(MAC_ADDRESS_OBD, 1000); // MAC ELM327 reale, intervallo 1000 ms
+#endif
+    int64_t up_ms = esp_timer_get_time() / 1000;
+    if (up_ms > BOOT_OBD_BUDGET_MS) {
+        ESP_LOGW(TAG, "OBD polling started %lld ms after power-up (budget %d ms)", (long long)up_ms, BOOT_OBD_BUDGET_MS);
+    }
+    return err;
+}
+
+static esp_err_t boot_usb(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    // host run: loopback adapter, "stick" is a local directory
+    mkdir(LINUX_STORAGE_DIR, 0755);
+    return usb_storage_init(LINUX_STORAGE_DIR);
+#else
+    esp_err_t err = usb_storage_start();
+    if (err != ESP_OK) return err;
+    return usb_storage_wait_mounted(BOOT_USB_MOUNT_TIMEOUT_MS) ? ESP_OK : ESP_ERR_TIMEOUT;
+#endif
+}
+
+static esp_err_t boot_wifi(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    // radio stays off: the uploader switches it on when there is a backlog
+    esp_err_t err = wifi_init();
+    if (err != ESP_OK) return err;
+    return log_clock_start_ntp();
+#endif
+}
+
+static esp_err_t boot_upload(void)
+{
+#if CONFIG_IDF_TARGET_LINUX
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    return network_upload_start();
+#endif
+}
+
+static esp_err_t boot_api(void)
+{
+    return http_api_start();
+}
+
+static const struct {
+    const char *name;
+    uint32_t deps;
+    esp_err_t (*fn)(void);
+} s_phases[BOOT_PHASE_COUNT] = {
+#define BOOT_PHASE(id, name, deps, fn) { name, deps, fn },
+    BOOT_PHASE_LIST(BOOT_PHASE)
+#undef BOOT_PHASE
+};
+
+#define BOOT_ALL_BITS   ((1u << BOOT_PHASE_COUNT) - 1)
+
+static boot_phase_metrics_t s_metrics[BOOT_PHASE_COUNT];
+static uint32_t s_started = 0;      // phases handed to a worker
+static uint32_t s_failed = 0;
+static uint32_t s_finished = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static EventGroupHandle_t s_done = NULL;   // bit per finished phase
+static StaticEventGroup_t s_done_buf;
+
+APP_TASK_STORAGE(s_worker0, 4096);
+APP_TASK_STORAGE(s_worker1, 4096);
+APP_TASK_STORAGE(s_worker2, 4096);
+_Static_assert(BOOT_WORKERS == 3, "one APP_TASK_STORAGE per boot worker");
+_Static_assert(BOOT_PHASE_COUNT <= 24, "event group bits");
+
+static void log_summary(void)
+{
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        const boot_phase_metrics_t *m = &s_metrics[i];
+        ESP_LOGI(TAG, "%-6s start %5lld ms  took %5lld ms  %s", s_phases[i].name,
+                 (long long)(m->start_us / 1000), (long long)((m->end_us - m->start_us) / 1000),
+                 m->err == ESP_OK ? "ok" : esp_err_to_name(m->err));
+    }
+}
+
+// Take the first phase whose dependencies have finished, run it, repeat
+static void boot_worker(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        uint32_t done = xEventGroupGetBits(s_done) & BOOT_ALL_BITS;
+        int pick = -1;
+        portENTER_CRITICAL(&s_lock);
+        for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+            if (!(s_started & (1u << i)) && (done & s_phases[i].deps) == s_phases[i].deps) {
+                s_started |= 1u << i;
+                pick = i;
+                break;
+            }
+        }
+        bool all_started = s_started == BOOT_ALL_BITS;
+        portEXIT_CRITICAL(&s_lock);
+
+        if (pick < 0) {
+            if (all_started) break;
+            // sleep until any phase not yet seen as finished completes
+            xEventGroupWaitBits(s_done, ~done & BOOT_ALL_BITS, pdFALSE, pdFALSE, portMAX_DELAY);
+            continue;
+        }
+
+        boot_phase_metrics_t *m = &s_metrics[pick];
+        m->start_us = esp_timer_get_time();
+        if (s_failed & s_phases[pick].deps) {
+            m->err = ESP_ERR_INVALID_STATE;
+        } else {
+            m->err = s_phases[pick].fn();
+        }
+        m->end_us = esp_timer_get_time();
+        if (m->err != ESP_OK) {
+            ESP_LOGW(TAG, "phase %s: %s", s_phases[pick].name, esp_err_to_name(m->err));
+        }
+        portENTER_CRITICAL(&s_lock);
+        if (m->err != ESP_OK) s_failed |= 1u << pick;
+        s_finished |= 1u << pick;
+        bool last = s_finished == BOOT_ALL_BITS;
+        portEXIT_CRITICAL(&s_lock);
+        xEventGroupSetBits(s_done, 1u << pick);
+        if (last) log_summary();
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t boot_start(void)
+{
+    if (s_done) return ESP_OK;
+    s_done = xEventGroupCreateStatic(&s_done_buf);
+
+    if (APP_TASK_CREATE(s_worker0, boot_worker, "boot0", NULL, tskIDLE_PRIORITY + 5, NULL) != pdPASS ||
+        APP_TASK_CREATE(s_worker1, boot_worker, "boot1", NULL, tskIDLE_PRIORITY + 5, NULL) != pdPASS ||
+        APP_TASK_CREATE(s_worker2, boot_worker, "boot2", NULL, tskIDLE_PRIORITY + 5, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "failed to start boot workers");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool boot_wait(uint32_t mask, int timeout_ms)
+{
+    if (!s_done) return false;
+    mask &= BOOT_ALL_BITS;
+    EventBits_t bits = xEventGroupWaitBits(s_done, mask, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms));
+    return (bits & mask) == mask;
+}
+
+void boot_get_metrics(boot_phase_metrics_t out[BOOT_PHASE_COUNT])
+{
+    memcpy(out, s_metrics, sizeof(s_metrics));
+}
@@ -0,0 +1,58 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+/*
+ * Parallel startup. Every phase runs on a small pool of worker tasks as soon
+ * as the phases it depends on have finished, so a slow one (Wi-Fi connect,
+ * waiting for the stick) never delays OBD logging, which only needs
+ * Bluetooth, the logger and the channel plan. A phase whose dependency
+ * failed is skipped.
+ *
+ * X(id, name, deps, fn) - deps is a mask of BOOT_BIT(id), fn lives in boot.c.
+ * Phases are handed to free workers in list order.
+ */
+#define BOOT_PHASE_LIST(X) \
+    X(NVS,      "nvs",      0,                                  boot_nvs) \
+    X(CLOCK,    "clock",    BOOT_BIT(NVS),                      boot_clock) \
+    X(LOGGER,   "logger",   BOOT_BIT(CLOCK),                    boot_logger) \
+    X(BT,       "bt",       BOOT_BIT(NVS),                      boot_bt) \
+    X(PLAN,     "plan",     BOOT_BIT(NVS),                      boot_plan) \
+    X(OBD,      "obd",      BOOT_BIT(BT) | BOOT_BIT(LOGGER) | BOOT_BIT(PLAN), boot_obd) \
+    X(USB,      "usb",      0,                                  boot_usb) \
+    X(WIFI,     "wifi",     BOOT_BIT(NVS),                      boot_wifi) \
+    X(UPLOAD,   "upload",   BOOT_BIT(WIFI) | BOOT_BIT(CLOCK),   boot_upload) \
+    X(API,      "api",      BOOT_BIT(CLOCK) | BOOT_BIT(PLAN),   boot_api)
+
+typedef enum {
+#define BOOT_ENUM(id, name, deps, fn) BOOT_##id,
+    BOOT_PHASE_LIST(BOOT_ENUM)
+#undef BOOT_ENUM
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+#define BOOT_BIT(id)                (1u << BOOT_##id)
+
+#define BOOT_WORKERS                3       // phases running at the same time
+#define BOOT_USB_MOUNT_TIMEOUT_MS   10000   // usb phase gives up waiting (the logger opens lazily)
+#define BOOT_OBD_BUDGET_MS          3000    // warn if OBD polling starts later than this after power-up
+
+typedef struct {
+    int64_t start_us;   // esp_timer time (since power-up), 0 if never started
+    int64_t end_us;
+    esp_err_t err;      // ESP_ERR_INVALID_STATE: skipped, a dependency failed
+} boot_phase_metrics_t;
+
+/** Start the workers and return; phases complete in the background. */
+esp_err_t boot_start(void);
+
+/** Wait until every phase in mask (BOOT_BIT()s) has finished. Returns false on timeout. */
+bool boot_wait(uint32_t mask, int timeout_ms);
+
+/** Copy the per-phase timings (indexed by boot_phase_t). */
+void boot_get_metrics(boot_phase_metrics_t out[BOOT_PHASE_COUNT]);
+
+#endif // BOOT_H
@@ -0,0 +1,136 @@
+#include "can_frame.h"
+
+#include <string.h>
+#include "can_signals.h"
+
+static const can_signal_t s_signals[] = {
+#define CAN_SIGNAL(ch, id, start, len, intel, is_signed, num, den, offset) \
+    { OBD_CH_##ch, start, len, intel, is_signed, id, num, den, offset },
+    CAN_SIGNAL_LIST(CAN_SIGNAL)
+#undef CAN_SIGNAL
+};
+
+const can_signal_t *can_signals(void)
+{
+    return s_signals;
+}
+
+int can_signal_count(void)
+{
+    return (int)(sizeof(s_signals) / sizeof(s_signals[0]));
+}
+
+static int hex_val(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+uint32_t can_frame_extract(const uint8_t *d, int dlc, const can_signal_t *sig)
+{
+    uint64_t raw = 0;
+    if (sig->intel) {
+        for (int i = dlc - 1; i >= 0; i--) raw = (raw << 8) | d[i];
+        raw >>= sig->start;
+    } else {
+        // Motorola: start bit is the MSB in DBC sawtooth numbering
+        for (int i = 0; i < 8; i++) raw = (raw << 8) | (i < dlc ? d[i] : 0);
+        int msb = (sig->start / 8) * 8 + (7 - sig->start % 8);   // bit index counted from the first byte's MSB
+        raw >>= 64 - (msb + sig->len);
+    }
+    return (uint32_t)(raw & ((sig->len >= 32) ? 0xFFFFFFFFu : ((1u << sig->len) - 1)));
+}
+
+static void dispatch_frame(can_frame_parser_t *p, int dlc)
+{
+    bool matched = false;
+    for (int i = 0; i < p->signal_count; i++) {
+        const can_signal_t *sig = &p->signals[i];
+        if (sig->id != p->id) continue;
+        // Intel signals must fit the payload; Motorola reads missing bytes as 0
+        if (sig->intel && (sig->start + sig->len) > dlc * 8) continue;
+        int64_t raw = can_frame_extract(p->data, dlc, sig);
+        if (sig->is_signed && (raw & (1LL << (sig->len - 1)))) raw -= 1LL << sig->len;
+        p->out->v[sig->ch] = (int32_t)((raw * sig->num) / sig->den) + sig->offset;
+        p->out->valid |= 1u << sig->ch;
+        matched = true;
+    }
+    if (matched) p->stats->decoded++;
+}
+
+void can_frame_reset(can_frame_parser_t *p)
+{
+    p->id = 0;
+    p->nibbles = 0;
+    p->bad = false;
+    p->text_len = 0;
+}
+
+void can_frame_init(can_frame_parser_t *p, const can_signal_t *signals, int count, obd_record_t *out,
+                    obd_monitor_stats_t *stats)
+{
+    p->signals = signals;
+    p->signal_count = count;
+    p->out = out;
+    p->stats = stats;
+    can_frame_reset(p);
+}
+
+static void end_line(can_frame_parser_t *p)
+{
+    if (p->nibbles == 0 && p->text_len == 0) return; // blank line
+    p->text[p->text_len] = '\0';
+    int data_nibbles = p->nibbles - CAN_FRAME_ID_HEX_LEN;
+
+    if (p->bad || data_nibbles < 0 || (data_nibbles & 1)) {
+        if (strncmp(p->text, "BUFFER FULL", 11) == 0) {
+            p->stats->overruns++;
+        } else if (strncmp(p->text, "STOPPED", 7) != 0 && strncmp(p->text, "OK", 2) != 0) {
+            p->stats->errors++;
+        }
+        return;
+    }
+    p->stats->frames++;
+    dispatch_frame(p, data_nibbles / 2);
+}
+
+bool can_frame_feed(can_frame_parser_t *p, const uint8_t *buf, size_t len)
+{
+    bool prompt = false;
+    for (size_t i = 0; i < len; i++) {
+        char c = (char)buf[i];
+        if (c == '\r' || c == '\n') {
+            end_line(p);
+            can_frame_reset(p);
+            continue;
+        }
+        if (c == '>') {
+            prompt = true;
+            can_frame_reset(p);
+            continue;
+        }
+        if (p->text_len < (int)sizeof(p->text) - 1) p->text[p->text_len++] = c;
+        if (c == ' ') continue;
+
+        int v = hex_val(c);
+        if (v < 0 || p->bad) {
+            p->bad = true;
+            continue;
+        }
+        if (p->nibbles < CAN_FRAME_ID_HEX_LEN) {
+            p->id = (p->id << 4) | (uint32_t)v;
+        } else {
+            int idx = (p->nibbles - CAN_FRAME_ID_HEX_LEN) / 2;
+            if (idx >= 8) {
+                p->bad = true;
+                continue;
+            }
+            if ((p->nibbles - CAN_FRAME_ID_HEX_LEN) & 1) p->data[idx] = (uint8_t)((p->data[idx] << 4) | v);
+            else p->data[idx] = (uint8_t)v;
+        }
+        p->nibbles++;
+    }
+    return prompt;
+}
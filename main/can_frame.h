@@ -0,0 +1,72 @@
+#ifndef CAN_FRAME_H
+#define CAN_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "obd_channels.h"
+
+/*
+ * Adapter output in monitor mode (ATMA / STMA with ATS0 ATH1 ATCAF0): one
+ * frame per line, header then data bytes ("280 0011D00C..."). The parser
+ * takes the stream in whatever chunks the link delivers and decodes every
+ * complete frame against a signal table (can_signals.h) into a record.
+ */
+#define CAN_FRAME_ID_HEX_LEN    3       // header digits per frame: 3 = 11-bit IDs, 8 = 29-bit
+
+/* One DBC signal, see CAN_SIGNAL_LIST */
+typedef struct {
+    uint8_t ch;
+    uint8_t start;
+    uint8_t len;
+    uint8_t intel;
+    uint8_t is_signed;
+    uint32_t id;
+    int32_t num;
+    int32_t den;
+    int32_t offset;
+} can_signal_t;
+
+typedef struct {
+    uint32_t frames;        // complete frames parsed
+    uint32_t decoded;       // frames that matched a signal of the table
+    uint32_t overruns;      // "BUFFER FULL" reports (adapter dropped frames)
+    uint32_t errors;        // CAN ERROR / <RX ERROR / malformed lines
+    uint32_t restarts;      // monitor re-armed after it stopped
+} obd_monitor_stats_t;
+
+typedef struct {
+    const can_signal_t *signals;
+    int signal_count;
+    obd_record_t *out;          // latest value per channel, valid bit set on update
+    obd_monitor_stats_t *stats;
+    // current line
+    uint32_t id;
+    uint8_t data[8];
+    int nibbles;                // hex digits seen on this line (header + data)
+    bool bad;                   // non-hex character seen
+    char text[16];              // start of the line, to recognise adapter messages
+    int text_len;
+} can_frame_parser_t;
+
+/** The table of can_signals.h. */
+const can_signal_t *can_signals(void);
+int can_signal_count(void);
+
+/** Decode frames against signals[0..count) into out, counting in stats. */
+void can_frame_init(can_frame_parser_t *p, const can_signal_t *signals, int count, obd_record_t *out,
+                    obd_monitor_stats_t *stats);
+
+/** Forget a partial line (after re-arming the monitor). */
+void can_frame_reset(can_frame_parser_t *p);
+
+/**
+ * Feed received bytes. Returns true if the adapter printed its prompt, i.e.
+ * monitoring stopped (BUFFER FULL, or any byte we sent) and must be re-armed.
+ */
+bool can_frame_feed(can_frame_parser_t *p, const uint8_t *buf, size_t len);
+
+/** Raw bits of sig from a payload of dlc bytes (Motorola reads missing bytes as 0). */
+uint32_t can_frame_extract(const uint8_t *d, int dlc, const can_signal_t *sig);
+
+#endif // CAN_FRAME_H
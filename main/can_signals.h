@@ -0,0 +1,26 @@
+#ifndef CAN_SIGNALS_H
+#define CAN_SIGNALS_H
+
+#include "obd_channels.h"
+
+/*
+ * Broadcast CAN signals decoded in monitor mode, DBC style.
+ *
+ * X(channel, can_id, start_bit, length, intel, is_signed, num, den, offset)
+ *   channel    obd_channel_t suffix the value is stored in
+ *   can_id     11-bit frame identifier
+ *   start_bit  DBC start bit (LSB for Intel, MSB for Motorola byte order)
+ *   length     signal length in bits
+ *   intel      1 = little endian (@1), 0 = big endian / Motorola (@0)
+ *   num, den   raw -> channel units: value = raw * num / den + offset
+ *              (channel units include the channel's fixed-point decimals)
+ *
+ * The defaults are the VAG PQ35/46 powertrain frames (Motor_1, Motor_2,
+ * Bremse_1); adjust per car.
+ */
+#define CAN_SIGNAL_LIST(X) \
+    X(RPM,      0x280, 16, 16, 1, 0, 1,   4,   0) \
+    X(COOLANT,  0x288,  8,  8, 1, 0, 3,   4, -48) \
+    X(SPEED,    0x1A0, 17, 15, 1, 0, 1, 100,   0)
+
+#endif // CAN_SIGNALS_H
@@ -0,0 +1,166 @@
+#include "data_logger.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "record_json.h"
+#include "usb_storage.h"
+#include "app_alloc.h"
+#include "heap_guard.h"
+#include "trace.h"
+#include "log_clock.h"
+#include "obd_plan.h"
+
+static const char *TAG = "data_logger";
+
+static QueueHandle_t s_record_queue = NULL;
+static char s_base[32] = {0};      // parent of the session directories
+static char s_reldir[64] = {0};    // session directory, e.g. logs/s00012, once the stick is seen
+static uint32_t s_dropped = 0;
+
+APP_QUEUE_STORAGE(s_records, DATA_LOGGER_QUEUE_LEN, sizeof(obd_record_t));
+APP_TASK_STORAGE(s_logger_task, 4096);
+
+#if TRACE_ENABLED
+// Order of a dump file name (session, dump number), 0 if it is not one
+static uint64_t trace_file_key(const char *name)
+{
+    unsigned session, seq;
+    int end = 0;
+    if (sscanf(name, "s%5u-%5u.json%n", &session, &seq, &end) != 2 || end == 0 || name[end] != '\0') return 0;
+    return (uint64_t)session << 32 | seq;
+}
+
+// Delete the oldest dumps until TRACE_DUMP_KEEP are left
+static void trace_prune(void)
+{
+    for (;;) {
+        DIR *d = usb_opendir(TRACE_DUMP_DIR);
+        if (!d) return;
+        int count = 0;
+        uint64_t oldest = UINT64_MAX;
+        struct dirent *e;
+        while ((e = readdir(d)) != NULL) {
+            uint64_t key = trace_file_key(e->d_name);
+            if (key == 0) continue;
+            count++;
+            if (key < oldest) oldest = key;
+        }
+        closedir(d);
+        if (count <= TRACE_DUMP_KEEP) return;
+        char relpath[48];
+        snprintf(relpath, sizeof(relpath), TRACE_DUMP_DIR "/s%05u-%05u.json",
+                 (unsigned)(oldest >> 32), (unsigned)(oldest & 0xFFFFFFFFu));
+        if (usb_remove(relpath) != 0) return;
+    }
+}
+
+// Write the trace rings to trace/sNNNNN-MMMMM.json on the stick, keeping
+// the newest TRACE_DUMP_KEEP dumps of this and earlier sessions
+static void dump_trace(void)
+{
+    static unsigned s_trace_seq = 0;
+    char relpath[48];
+    snprintf(relpath, sizeof(relpath), TRACE_DUMP_DIR "/s%05u-%05u.json",
+             (unsigned)log_clock_session(), ++s_trace_seq);
+    heap_guard_exempt_begin();     // stdio allocates the FILE and its buffer, opendir the DIR
+    FILE *f = usb_fopen(relpath, "w");
+    if (f) {
+        int n = trace_dump(f);
+        fclose(f);
+        ESP_LOGI(TAG, "dumped %d trace events to %s", n, relpath);
+    }
+    trace_prune();
+    heap_guard_exempt_end();
+}
+#endif
+
+static void data_logger_task(void *arg)
+{
+    (void)arg;
+    static char line[OBD_RECORD_JSON_MAX];
+    bool seg_open = false;
+    TickType_t last_flush = xTaskGetTickCount();
+#if TRACE_ENABLED
+    TickType_t last_trace_dump = last_flush;
+#endif
+
+    heap_guard_watch_task(NULL);
+
+    for (;;) {
+        obd_record_t rec;
+        bool got = xQueueReceive(s_record_queue, &rec, pdMS_TO_TICKS(DATA_LOGGER_FLUSH_MS)) == pdTRUE;
+
+        // the stick may be mounted after polling started: open lazily
+        if (!seg_open && usb_storage_wait_mounted(0)) {
+            // opening a segment allocates the FATFS file object once per segment
+            heap_guard_exempt_begin();
+            // the session number depends on the directories already on the stick
+            if (!s_reldir[0]) log_clock_session_dir(s_reldir, sizeof(s_reldir), s_base);
+            seg_open = usb_log_open(s_reldir) == 0;
+            heap_guard_exempt_end();
+        }
+        if (got) {
+            // JSON and staging; a full block adds a nested usb_write span
+            int64_t t_rec = TRACE_BEGIN();
+            size_t len = obd_record_to_json(&rec, line, sizeof(line));
+            if (!seg_open || usb_log_append(rec.ts, line, len) != 0) {
+                s_dropped++;
+                seg_open = false;
+            }
+            TRACE_END(SERIALIZE, t_rec);
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if (seg_open && (now - last_flush) >= pdMS_TO_TICKS(DATA_LOGGER_FLUSH_MS)) {
+            int64_t t_fsync = TRACE_BEGIN();
+            usb_log_flush();
+            TRACE_END(USB_FSYNC, t_fsync);
+            heap_guard_exempt_begin();  // open() of the clock map file, fopen() of the manifest
+            log_clock_persist();
+            obd_plan_check_file();
+            heap_guard_exempt_end();
+            last_flush = now;
+            if (s_dropped) {
+                ESP_LOGW(TAG, "%u records dropped so far", (unsigned)s_dropped);
+            }
+        }
+#if TRACE_ENABLED
+        if (seg_open && (now - last_trace_dump) >= pdMS_TO_TICKS(TRACE_DUMP_PERIOD_MS)) {
+            dump_trace();
+            last_trace_dump = now;
+        }
+#endif
+    }
+}
+
+esp_err_t data_logger_start(const char *reldir)
+{
+    if (!reldir) return ESP_ERR_INVALID_ARG;
+    if (s_record_queue) return ESP_OK;
+    snprintf(s_base, sizeof(s_base), "%s", reldir);
+
+    s_record_queue = APP_QUEUE_CREATE(s_records, DATA_LOGGER_QUEUE_LEN, sizeof(obd_record_t));
+    if (!s_record_queue) return ESP_ERR_NO_MEM;
+
+    BaseType_t ok = APP_TASK_CREATE(s_logger_task, data_logger_task, "data_logger", NULL, tskIDLE_PRIORITY + 3, NULL);
+    if (ok != pdPASS) {
+        ESP_LOGE(TAG, "failed to start data logger task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool data_logger_submit(const obd_record_t *rec)
+{
+    if (!s_record_queue || !rec) return false;
+    if (xQueueSend(s_record_queue, rec, 0) != pdTRUE) {
+        s_dropped++;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,22 @@
+#ifndef DATA_LOGGER_H
+#define DATA_LOGGER_H
+
+#include <stdbool.h>
+#include <esp_err.h>
+#include "obd_channels.h"
+
+#define DATA_LOGGER_QUEUE_LEN       32      // records buffered between polling and storage
+#define DATA_LOGGER_FLUSH_MS        5000    // staging block flushed + fsync'd at least this often
+
+/**
+ * Start the storage task. Records submitted with data_logger_submit() are
+ * serialized to JSON lines and appended to log segments in the boot
+ * session's directory under reldir (relative to the USB mount point, see
+ * log_clock.h). Record timestamps are log_clock_now_ms() values.
+ */
+esp_err_t data_logger_start(const char *reldir);
+
+/** Queue a record for storage without blocking. Returns false if dropped. */
+bool data_logger_submit(const obd_record_t *rec);
+
+#endif // DATA_LOGGER_H
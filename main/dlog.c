@@ -0,0 +1,94 @@
+#include "dlog.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_alloc.h"
+
+static const char *TAG = "dlog";
+
+typedef struct {
+    int64_t ts_us;
+    uint16_t id;
+    uint32_t args[DLOG_MAX_ARGS];
+} dlog_entry_t;
+
+static const struct {
+    esp_log_level_t level;
+    const char *fmt;
+} s_msgs[DLOG_MSG_COUNT] = {
+#define DLOG_LEVEL_E ESP_LOG_ERROR
+#define DLOG_LEVEL_W ESP_LOG_WARN
+#define DLOG_LEVEL_I ESP_LOG_INFO
+#define DLOG_LEVEL_D ESP_LOG_DEBUG
+#define DLOG_MSG(id, level, fmt) { DLOG_LEVEL_##level, fmt },
+    DLOG_MSG_LIST(DLOG_MSG)
+#undef DLOG_MSG
+};
+
+static dlog_entry_t s_ring[DLOG_RING_LEN];
+static uint32_t s_head = 0;     // next slot written
+static uint32_t s_tail = 0;     // next slot rendered
+static uint32_t s_dropped = 0;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+APP_TASK_STORAGE(s_render_task, 3072);
+
+void dlog_write(dlog_msg_t id, const uint32_t args[DLOG_MAX_ARGS])
+{
+    int64_t ts = esp_timer_get_time();
+    portENTER_CRITICAL_SAFE(&s_lock);
+    if (s_head - s_tail >= DLOG_RING_LEN) {
+        s_dropped++;
+    } else {
+        dlog_entry_t *e = &s_ring[s_head & (DLOG_RING_LEN - 1)];
+        e->ts_us = ts;
+        e->id = (uint16_t)id;
+        for (int i = 0; i < DLOG_MAX_ARGS; i++) e->args[i] = args[i];
+        s_head++;
+    }
+    portEXIT_CRITICAL_SAFE(&s_lock);
+}
+
+static void dlog_render_task(void *arg)
+{
+    (void)arg;
+    char text[128];
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(DLOG_RENDER_MS));
+
+        uint32_t dropped;
+        portENTER_CRITICAL(&s_lock);
+        dropped = s_dropped;
+        s_dropped = 0;
+        portEXIT_CRITICAL(&s_lock);
+        if (dropped) {
+            ESP_LOGW(TAG, "%u messages dropped (ring full)", (unsigned)dropped);
+        }
+
+        while (s_tail != s_head) {
+            // entries are only rewritten once s_tail has moved past them
+            dlog_entry_t e = s_ring[s_tail & (DLOG_RING_LEN - 1)];
+            portENTER_CRITICAL(&s_lock);
+            s_tail++;
+            portEXIT_CRITICAL(&s_lock);
+
+            if (e.id >= DLOG_MSG_COUNT) continue;
+            snprintf(text, sizeof(text), s_msgs[e.id].fmt, e.args[0], e.args[1], e.args[2]);
+            esp_log_write(s_msgs[e.id].level, TAG, "[%lld us] %s\n", (long long)e.ts_us, text);
+        }
+    }
+}
+
+esp_err_t dlog_start(void)
+{
+    static bool started = false;
+    if (started) return ESP_OK;
+    BaseType_t ok = APP_TASK_CREATE(s_render_task, dlog_render_task, "dlog", NULL, tskIDLE_PRIORITY, NULL);
+    if (ok != pdPASS) return ESP_FAIL;
+    started = true;
+    return ESP_OK;
+}
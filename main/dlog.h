@@ -0,0 +1,43 @@
+#ifndef DLOG_H
+#define DLOG_H
+
+#include <stdint.h>
+#include <esp_err.h>
+
+/*
+ * Deferred logging for hot paths. DLOG() stores a message ID, a timestamp
+ * and up to DLOG_MAX_ARGS raw 32-bit arguments in a ring buffer; formatting
+ * and UART output happen later in an idle-priority task. Arguments are
+ * copied by value, so only int-sized values can be logged (no strings).
+ *
+ * X(id, level, format)  level is one of E, W, I, D; format uses int-sized
+ * conversions only (%d %u %x).
+ */
+#define DLOG_MSG_LIST(X) \
+    X(RX_DATA,      D, "RX data len=%u") \
+    X(SPP_CONG,     I, "SPP congestion=%u") \
+    X(RX_OVERFLOW,  W, "RX stream full, dropped %u bytes") \
+    X(RPM_SAMPLE,   I, "RPM: %d") \
+    X(PARSE_FAIL,   W, "Failed to parse PID %02X, reply %d bytes")
+
+typedef enum {
+#define DLOG_ENUM(id, level, fmt) DLOG_##id,
+    DLOG_MSG_LIST(DLOG_ENUM)
+#undef DLOG_ENUM
+    DLOG_MSG_COUNT
+} dlog_msg_t;
+
+#define DLOG_MAX_ARGS       3
+#define DLOG_RING_LEN       256     // entries, power of two
+#define DLOG_RENDER_MS      100     // render task wake-up period
+
+/** Log a message by ID with 1..DLOG_MAX_ARGS int-sized arguments. Safe from callbacks. */
+#define DLOG(id, ...) \
+    dlog_write(DLOG_##id, (const uint32_t[DLOG_MAX_ARGS]){ __VA_ARGS__ })
+
+void dlog_write(dlog_msg_t id, const uint32_t args[DLOG_MAX_ARGS]);
+
+/** Start the idle-priority render task. */
+esp_err_t dlog_start(void);
+
+#endif // DLOG_H
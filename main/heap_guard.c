@@ -0,0 +1,153 @@
+#include "heap_guard.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+
+static const char *TAG = "heap_guard";
+
+static TaskHandle_t s_watched[HEAP_GUARD_MAX_TASKS];
+static volatile uint8_t s_exempt_depth[HEAP_GUARD_MAX_TASKS];
+static volatile uint32_t s_allocs = 0;
+static volatile uint32_t s_frees = 0;
+static volatile uint32_t s_exempt = 0;
+static uint32_t s_violations = 0;
+static uint32_t s_samples = 0;
+static uint32_t s_window_allocs = 0;
+static uint32_t s_window_frees = 0;
+
+static inline int IRAM_ATTR watched_slot(void)
+{
+    TaskHandle_t cur = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < HEAP_GUARD_MAX_TASKS; i++) {
+        if (s_watched[i] && s_watched[i] == cur) return i;
+    }
+    return -1;
+}
+
+static inline void IRAM_ATTR count_alloc(void)
+{
+    int slot = watched_slot();
+    if (slot < 0) return;
+    if (s_exempt_depth[slot]) {
+        __atomic_fetch_add(&s_exempt, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&s_allocs, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static inline void IRAM_ATTR count_free(void)
+{
+    int slot = watched_slot();
+    if (slot < 0 || s_exempt_depth[slot]) return;
+    __atomic_fetch_add(&s_frees, 1, __ATOMIC_RELAXED);
+}
+
+#if CONFIG_IDF_TARGET_LINUX
+// No heap_caps hooks on the host: wrap the glibc allocator. Tasks are
+// threads of one process and only one runs at a time, so the current task
+// is the caller.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size)
+{
+    count_alloc();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    count_alloc();
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    count_alloc();
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr) count_free();
+    __libc_free(ptr);
+}
+#elif CONFIG_HEAP_USE_HOOKS
+// Called by heap_caps on every allocation/free (may run from ISR: keep it tiny)
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    (void)ptr; (void)size; (void)caps;
+    count_alloc();
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr)
+{
+    (void)ptr;
+    count_free();
+}
+#endif
+
+void heap_guard_watch_task(TaskHandle_t task)
+{
+    if (!task) task = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < HEAP_GUARD_MAX_TASKS; i++) {
+        if (s_watched[i] == task) return;
+        if (!s_watched[i]) {
+            s_watched[i] = task;
+            return;
+        }
+    }
+    ESP_LOGW(TAG, "no free slot to watch task");
+}
+
+void heap_guard_exempt_begin(void)
+{
+    int slot = watched_slot();
+    if (slot >= 0) s_exempt_depth[slot]++;
+}
+
+void heap_guard_exempt_end(void)
+{
+    int slot = watched_slot();
+    if (slot >= 0 && s_exempt_depth[slot]) s_exempt_depth[slot]--;
+}
+
+void heap_guard_sample_begin(void)
+{
+    s_window_allocs = s_allocs;
+    s_window_frees = s_frees;
+}
+
+bool heap_guard_sample_end(void)
+{
+    uint32_t allocs = s_allocs - s_window_allocs;
+    uint32_t frees = s_frees - s_window_frees;
+    bool clean = ++s_samples <= HEAP_GUARD_WARMUP_SAMPLES || (allocs == 0 && frees == 0);
+    if (!clean) {
+        s_violations++;
+        ESP_LOGE(TAG, "steady state touched the heap: %u allocs, %u frees in one sample",
+                 (unsigned)allocs, (unsigned)frees);
+#if HEAP_GUARD_STRICT
+        abort();
+#endif
+    }
+    if (s_samples % HEAP_GUARD_REPORT_SAMPLES == 0) {
+        ESP_LOGI(TAG, "%u samples, %u violations, %u exempt allocations%s", (unsigned)s_samples,
+                 (unsigned)s_violations, (unsigned)s_exempt, HEAP_GUARD_STRICT ? " (strict)" : "");
+    }
+    return clean;
+}
+
+void heap_guard_get_stats(heap_guard_stats_t *out)
+{
+    if (!out) return;
+    out->allocs = s_allocs;
+    out->frees = s_frees;
+    out->exempt = s_exempt;
+    out->violations = s_violations;
+}
@@ -0,0 +1,61 @@
+#ifndef HEAP_GUARD_H
+#define HEAP_GUARD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Allocation counter for the steady state. On the chip it requires
+ * CONFIG_HEAP_USE_HOOKS (set in sdkconfig.defaults), without it every call
+ * is a no-op; on the linux target the C library allocator is wrapped instead.
+ *
+ * Tasks registered with heap_guard_watch_task() have their heap operations
+ * counted. The polling task brackets each sample with
+ * heap_guard_sample_begin()/heap_guard_sample_end(); after the warm-up
+ * samples any allocation inside the window is reported, and with
+ * HEAP_GUARD_STRICT (CONFIG_HEAP_GUARD_STRICT) the firmware aborts so a
+ * regression cannot go unnoticed. Every HEAP_GUARD_REPORT_SAMPLES samples the
+ * totals are logged.
+ */
+
+#ifndef HEAP_GUARD_STRICT
+#if CONFIG_HEAP_GUARD_STRICT
+#define HEAP_GUARD_STRICT 1
+#else
+#define HEAP_GUARD_STRICT 0
+#endif
+#endif
+
+#define HEAP_GUARD_MAX_TASKS        4
+#define HEAP_GUARD_WARMUP_SAMPLES   3   // first-use allocations (newlib reent, log locks) are allowed
+#define HEAP_GUARD_REPORT_SAMPLES   32
+
+typedef struct {
+    uint32_t allocs;        // counted allocations on watched tasks
+    uint32_t frees;         // counted frees on watched tasks
+    uint32_t exempt;        // allocations inside HEAP_GUARD_EXEMPT sections
+    uint32_t violations;    // samples that allocated after warm-up
+} heap_guard_stats_t;
+
+/** Count heap operations made by task (NULL = calling task). */
+void heap_guard_watch_task(TaskHandle_t task);
+
+/*
+ * Third-party calls that allocate internally on the caller's task (e.g.
+ * esp_spp_write deep-copies into Bluedroid's message queue) are wrapped so
+ * their allocations are accounted separately instead of as violations.
+ */
+void heap_guard_exempt_begin(void);
+void heap_guard_exempt_end(void);
+
+void heap_guard_sample_begin(void);
+
+/** Returns true if the sample window was heap-free. */
+bool heap_guard_sample_end(void);
+
+void heap_guard_get_stats(heap_guard_stats_t *out);
+
+#endif // HEAP_GUARD_H
@@ -0,0 +1,153 @@
+#include "http_api.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "esp_http_server.h"
+#include "log_query.h"
+#include "obd_plan.h"
+#include "usb_storage.h"
+
+static const char *TAG = "http_api";
+
+static httpd_handle_t s_server = NULL;
+
+static int send_chunk(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, (ssize_t)len) == ESP_OK ? 0 : -1;
+}
+
+// Optional integer parameter; false if present but malformed
+static bool query_i64(const char *qs, const char *key, int64_t *out)
+{
+    char v[24];
+    if (httpd_query_key_value(qs, key, v, sizeof(v)) != ESP_OK) return true;
+    char *end;
+    long long x = strtoll(v, &end, 10);
+    if (end == v || *end != '\0') return false;
+    *out = x;
+    return true;
+}
+
+static esp_err_t data_get_handler(httpd_req_t *req)
+{
+    char qs[HTTP_API_QUERY_MAX] = "";
+    log_query_t q = { .from_ms = 0, .to_ms = INT64_MAX, .channels = 0 };
+    if (httpd_req_get_url_query_len(req) >= sizeof(qs)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "query too long");
+    }
+    httpd_req_get_url_query_str(req, qs, sizeof(qs)); // ESP_ERR_NOT_FOUND without a query: all defaults
+
+    char channels[96];
+    if (!query_i64(qs, "from", &q.from_ms) || !query_i64(qs, "to", &q.to_ms) || q.to_ms < q.from_ms) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "from/to: epoch milliseconds, from <= to");
+    }
+    if (httpd_query_key_value(qs, "channels", channels, sizeof(channels)) == ESP_OK &&
+        log_query_parse_channels(channels, &q.channels) != 0) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "unknown channel");
+    }
+
+    if (!usb_storage_wait_mounted(0)) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, "no stick\n", HTTPD_RESP_USE_STRLEN);
+    }
+
+    httpd_resp_set_type(req, "application/x-ndjson");
+    long n = log_query_run(&q, send_chunk, req);
+    if (n < 0) {
+        ESP_LOGW(TAG, "GET /data aborted, client gone");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "GET /data from %lld to %lld: %ld bytes", (long long)q.from_ms, (long long)q.to_ms, n);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t reindex_post_handler(httpd_req_t *req)
+{
+    if (!usb_storage_wait_mounted(0)) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        return httpd_resp_send(req, "no stick\n", HTTPD_RESP_USE_STRLEN);
+    }
+    char body[32];
+    int n = snprintf(body, sizeof(body), "{\"segments\":%d}\n", log_index_rebuild_all());
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, body, n);
+}
+
+// "Bearer <CONFIG_HTTP_API_TOKEN>", compared without an early exit
+static bool authorized(httpd_req_t *req)
+{
+    static const char expect[] = "Bearer " CONFIG_HTTP_API_TOKEN;
+    char got[HTTP_API_AUTH_MAX];
+    if (sizeof(expect) > sizeof(got) ||
+        httpd_req_get_hdr_value_len(req, "Authorization") != sizeof(expect) - 1 ||
+        httpd_req_get_hdr_value_str(req, "Authorization", got, sizeof(got)) != ESP_OK) {
+        return false;
+    }
+    uint8_t diff = 0;
+    for (size_t i = 0; i < sizeof(expect) - 1; i++) diff |= (uint8_t)(got[i] ^ expect[i]);
+    return diff == 0;
+}
+
+static esp_err_t channels_post_handler(httpd_req_t *req)
+{
+    if (sizeof(CONFIG_HTTP_API_TOKEN) == 1) {
+        return httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "no token configured, use obd_channels.txt on the stick");
+    }
+    if (!authorized(req)) {
+        ESP_LOGW(TAG, "POST /channels rejected: bad or missing token");
+        httpd_resp_set_hdr(req, "WWW-Authenticate", "Bearer");
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "token required");
+    }
+    static char text[OBD_PLAN_TEXT_MAX];   // one request at a time: the server has a single task
+    if (req->content_len >= sizeof(text)) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "manifest too long");
+    }
+    size_t len = 0;
+    while (len < req->content_len) {
+        int r = httpd_req_recv(req, text + len, req->content_len - len);
+        if (r == HTTPD_SOCK_ERR_TIMEOUT) continue;
+        if (r <= 0) return ESP_FAIL;
+        len += (size_t)r;
+    }
+
+    char err[64];
+    int n = obd_plan_load(text, len, err, sizeof(err));
+    if (n < 0) return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, err);
+    char body[32];
+    int blen = snprintf(body, sizeof(body), "{\"channels\":%d}\n", n);
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_send(req, body, blen);
+}
+
+esp_err_t http_api_start(void)
+{
+    if (s_server) return ESP_OK;
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.server_port = HTTP_API_PORT;
+    config.stack_size = HTTP_API_STACK;
+    esp_err_t err = httpd_start(&s_server, &config);
+    if (err != ESP_OK) return err;
+
+    static const httpd_uri_t data_uri = {
+        .uri = "/data",
+        .method = HTTP_GET,
+        .handler = data_get_handler,
+    };
+    static const httpd_uri_t reindex_uri = {
+        .uri = "/reindex",
+        .method = HTTP_POST,
+        .handler = reindex_post_handler,
+    };
+    static const httpd_uri_t channels_uri = {
+        .uri = "/channels",
+        .method = HTTP_POST,
+        .handler = channels_post_handler,
+    };
+    httpd_register_uri_handler(s_server, &data_uri);
+    httpd_register_uri_handler(s_server, &reindex_uri);
+    httpd_register_uri_handler(s_server, &channels_uri);
+    ESP_LOGI(TAG, "listening on port %d", HTTP_API_PORT);
+    return ESP_OK;
+}
@@ -0,0 +1,34 @@
+#ifndef HTTP_API_H
+#define HTTP_API_H
+
+#include <esp_err.h>
+#include "sdkconfig.h"
+
+/*
+ * Small HTTP server on whatever interface is up (the station while an
+ * upload session runs; on the Linux target, localhost):
+ *
+ *   GET  /data?from=<epoch ms>&to=<epoch ms>&channels=rpm,speed
+ *        NDJSON stream of the records in range (log_query.h), all
+ *        parameters optional
+ *   POST /reindex
+ *        rebuild the time index of every closed segment
+ *   POST /channels
+ *        replace the polled channels with the manifest in the body
+ *        (obd_plan.h); an empty body restores the built-in table.
+ *        Needs "Authorization: Bearer <CONFIG_HTTP_API_TOKEN>"; with no
+ *        token configured it answers 403 and manifests come only from
+ *        the stick
+ */
+#if CONFIG_IDF_TARGET_LINUX
+#define HTTP_API_PORT           8080    // unprivileged on the host
+#else
+#define HTTP_API_PORT           80
+#endif
+#define HTTP_API_STACK          6144
+#define HTTP_API_QUERY_MAX      192     // longest query string accepted
+#define HTTP_API_AUTH_MAX       80      // longest Authorization header read
+
+esp_err_t http_api_start(void);
+
+#endif // HTTP_API_H
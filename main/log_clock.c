@@ -0,0 +1,259 @@
+#include "log_clock.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "esp_netif_sntp.h"
+#endif
+#include "usb_storage.h"
+#include "app_alloc.h"
+
+static const char *TAG = "log_clock";
+
+typedef struct {
+    uint32_t session;
+    int64_t offset_ms;      // epoch_ms - mono_ms
+} clock_map_t;
+
+static uint32_t s_session = 0;
+static bool s_session_settled = false;  // checked against the stick, see log_clock_session_dir()
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Current session: latest mapping, and the one not yet on the stick
+static bool s_cur_valid = false;
+static int64_t s_cur_offset = 0;
+static bool s_pending = false;
+static int64_t s_pending_mono = 0;
+static int64_t s_pending_epoch = 0;
+
+// Earlier sessions: a cache of LOG_CLOCK_MAP_PATH, loaded on first use.
+// The file is the record; sessions that dropped out are read back from it.
+// Shared by the uploader and the HTTP task; a mutex, as lookups read the file.
+static clock_map_t s_map[LOG_CLOCK_MAP_MAX];
+static int s_map_n = 0;
+static bool s_map_loaded = false;
+static uint32_t s_map_gen = 0;         // usb_storage_generation() the cache was loaded from
+static SemaphoreHandle_t s_map_mutex = NULL;
+APP_MUTEX_STORAGE(s_map_mutex_buf);
+
+esp_err_t log_clock_init(void)
+{
+    if (!s_map_mutex) {
+        s_map_mutex = APP_MUTEX_CREATE(s_map_mutex_buf);
+        if (!s_map_mutex) return ESP_ERR_NO_MEM;
+    }
+
+    // provisional: log_clock_session_dir() settles it once the stick is mounted
+    uint32_t boots = 0;
+    nvs_handle_t h;
+    esp_err_t err = nvs_open("clock", NVS_READONLY, &h);
+    if (err == ESP_OK) {
+        nvs_get_u32(h, "boots", &boots); // ESP_ERR_NVS_NOT_FOUND on first boot
+        nvs_close(h);
+    } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW(TAG, "boot counter unavailable (%s), numbering from the stick", esp_err_to_name(err));
+    }
+    s_session = boots + 1;
+#if CONFIG_IDF_TARGET_LINUX
+    log_clock_on_sync(); // host clock is already synced
+#endif
+    return ESP_OK;
+}
+
+// Highest sNNNNN directory under base, 0 if none
+static uint32_t last_session_on_stick(const char *base)
+{
+    DIR *d = usb_opendir(base);
+    if (!d) return 0;
+    uint32_t last = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        unsigned session;
+        char extra;
+        if (sscanf(e->d_name, "s%05u%c", &session, &extra) == 1 && session > last) last = session;
+    }
+    closedir(d);
+    return last;
+}
+
+// Best effort: a failure only means the stick alone numbers the next boot
+static void store_boot_counter(uint32_t session)
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open("clock", NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_u32(h, "boots", session);
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) ESP_LOGW(TAG, "boot counter not saved: %s", esp_err_to_name(err));
+}
+
+uint32_t log_clock_session(void)
+{
+    return s_session;
+}
+
+void log_clock_session_dir(char *out, size_t out_sz, const char *base)
+{
+    if (!s_session_settled) {
+        s_session_settled = true;
+        uint32_t last = last_session_on_stick(base);
+        if (last >= s_session) {
+            // NVS erased or unreadable, or the stick came from another unit
+            ESP_LOGW(TAG, "s%05" PRIu32 " already on the stick", last);
+            s_session = last + 1;
+        }
+        store_boot_counter(s_session);
+        ESP_LOGI(TAG, "session %" PRIu32, s_session);
+    }
+    snprintf(out, out_sz, "%s/s%05" PRIu32, base, s_session);
+}
+
+void log_clock_on_sync(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t mono = log_clock_now_ms();
+    int64_t epoch = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+
+    portENTER_CRITICAL(&s_lock);
+    s_cur_offset = epoch - mono;
+    s_cur_valid = true;
+    s_pending = true;
+    s_pending_mono = mono;
+    s_pending_epoch = epoch;
+    portEXIT_CRITICAL(&s_lock);
+    ESP_LOGI(TAG, "clock synced, offset %lld ms", (long long)(epoch - mono));
+}
+
+int log_clock_persist(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool pending = s_pending;
+    int64_t mono = s_pending_mono, epoch = s_pending_epoch;
+    s_pending = false;
+    portEXIT_CRITICAL(&s_lock);
+    if (!pending) return 0;
+
+    char line[64];
+    snprintf(line, sizeof(line), "%" PRIu32 " %lld %lld", s_session, (long long)mono, (long long)epoch);
+    if (usb_append_log(LOG_CLOCK_MAP_PATH, line) != 0) {
+        portENTER_CRITICAL(&s_lock);
+        s_pending = true; // keep the newest mapping for the next try
+        portEXIT_CRITICAL(&s_lock);
+        return -1;
+    }
+    return 0;
+}
+
+// Later lines win: a session that synced twice keeps its last offset
+static void map_put(uint32_t session, int64_t offset_ms)
+{
+    for (int i = 0; i < s_map_n; i++) {
+        if (s_map[i].session == session) {
+            s_map[i].offset_ms = offset_ms;
+            return;
+        }
+    }
+    if (s_map_n == LOG_CLOCK_MAP_MAX) {
+        memmove(&s_map[0], &s_map[1], sizeof(s_map[0]) * (LOG_CLOCK_MAP_MAX - 1));
+        s_map_n--;
+    }
+    s_map[s_map_n++] = (clock_map_t){ session, offset_ms };
+}
+
+// Fill the cache from the file of the stick now mounted (caller holds s_map_mutex)
+static void map_load(void)
+{
+    s_map_n = 0;
+    s_map_gen = usb_storage_generation();
+    s_map_loaded = !usb_file_exists(LOG_CLOCK_MAP_PATH);
+    if (s_map_loaded) return;
+    FILE *f = usb_fopen(LOG_CLOCK_MAP_PATH, "r");
+    if (!f) return;     // retried on the next lookup
+    s_map_loaded = true;
+    char line[64];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned session;
+        long long mono, epoch;
+        if (sscanf(line, "%u %lld %lld", &session, &mono, &epoch) == 3) {
+            map_put(session, epoch - mono);
+        }
+    }
+    fclose(f);
+    ESP_LOGI(TAG, "loaded clock map (%d sessions)", s_map_n);
+}
+
+// Look one session up in LOG_CLOCK_MAP_PATH (last line wins) and cache it
+static bool map_find_file(uint32_t session, int64_t *offset_ms)
+{
+    if (!usb_file_exists(LOG_CLOCK_MAP_PATH)) return false;
+    FILE *f = usb_fopen(LOG_CLOCK_MAP_PATH, "r");
+    if (!f) return false;
+    bool found = false;
+    char line[64];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned s;
+        long long mono, epoch;
+        if (sscanf(line, "%u %lld %lld", &s, &mono, &epoch) == 3 && s == session) {
+            *offset_ms = epoch - mono;
+            found = true;
+        }
+    }
+    fclose(f);
+    if (found) map_put(session, *offset_ms);
+    return found;
+}
+
+bool log_clock_offset(uint32_t session, int64_t *offset_ms)
+{
+    if (session == s_session) {
+        portENTER_CRITICAL(&s_lock);
+        bool valid = s_cur_valid;
+        *offset_ms = s_cur_offset;
+        portEXIT_CRITICAL(&s_lock);
+        return valid;
+    }
+    xSemaphoreTake(s_map_mutex, portMAX_DELAY);
+    // a swapped stick has its own clock map
+    if (!s_map_loaded || s_map_gen != usb_storage_generation()) map_load();
+    bool found = false;
+    for (int i = 0; i < s_map_n && !found; i++) {
+        if (s_map[i].session == session) {
+            *offset_ms = s_map[i].offset_ms;
+            found = true;
+        }
+    }
+    // not cached: evicted (more than LOG_CLOCK_MAP_MAX sessions on the stick) or never synced
+    if (!found && s_map_n == LOG_CLOCK_MAP_MAX) found = map_find_file(session, offset_ms);
+    xSemaphoreGive(s_map_mutex);
+    return found;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+static void ntp_sync_cb(struct timeval *tv)
+{
+    (void)tv;
+    log_clock_on_sync();
+}
+
+esp_err_t log_clock_start_ntp(void)
+{
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(LOG_CLOCK_NTP_SERVER);
+    config.sync_cb = ntp_sync_cb;
+    return esp_netif_sntp_init(&config);
+}
+#else
+esp_err_t log_clock_start_ntp(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+#endif
@@ -0,0 +1,60 @@
+#ifndef LOG_CLOCK_H
+#define LOG_CLOCK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "esp_timer.h"
+
+/*
+ * Log timestamps. Samples carry the esp_timer clock in milliseconds, which
+ * is cheap and never jumps, and each boot writes its logs under its own
+ * session directory (logs/sNNNNN). Whenever NTP syncs, the offset between
+ * the two clocks is recorded for the session in a small table on the stick
+ * (LOG_CLOCK_MAP_PATH, one "session mono_ms epoch_ms" line per sync). The
+ * uploader adds the offset while streaming, so files are never rewritten.
+ */
+#define LOG_CLOCK_MAP_PATH      "logs/clockmap.txt"
+#define LOG_CLOCK_MAP_MAX       32      // sessions cached in RAM; the rest are read back from the file
+#define LOG_CLOCK_NTP_SERVER    "pool.ntp.org"
+
+/**
+ * Start a new session from the NVS boot counter (boot "clock" phase). The
+ * number is provisional until log_clock_session_dir(); NVS errors are logged
+ * and never fail the phase.
+ */
+esp_err_t log_clock_init(void);
+
+uint32_t log_clock_session(void);
+
+/**
+ * Session directory under base, e.g. "logs/s00012". Call once the stick is
+ * mounted: the first call settles the session one past both the NVS counter
+ * and the highest sNNNNN under base, so a wiped NVS never reuses a directory,
+ * and stores it back to NVS.
+ */
+void log_clock_session_dir(char *out, size_t out_sz, const char *base);
+
+/** Monotonic sample time in milliseconds since boot. */
+static inline int64_t log_clock_now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+/** Record the current mono -> epoch mapping (call right after the wall clock was set). */
+void log_clock_on_sync(void);
+
+/** Append mappings recorded since the last call to LOG_CLOCK_MAP_PATH. Storage task only. */
+int log_clock_persist(void);
+
+/**
+ * Offset to add to a session's sample times to get epoch milliseconds.
+ * Returns false if that session never saw an NTP sync.
+ */
+bool log_clock_offset(uint32_t session, int64_t *offset_ms);
+
+/** Start SNTP; every sync calls log_clock_on_sync(). Needs the network stack. */
+esp_err_t log_clock_start_ntp(void);
+
+#endif // LOG_CLOCK_H
@@ -0,0 +1,340 @@
+#include "log_query.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+#include "obd_channels.h"
+#include "obd_plan.h"
+#include "record_json.h"
+#include "usb_storage.h"
+#include "log_clock.h"
+
+static const char *TAG = "log_query";
+
+static char s_out[LOG_QUERY_BUF_SIZE];
+static size_t s_out_len = 0;
+static char s_line[OBD_RECORD_JSON_MAX + 64];  // longer lines are split, and skipped as non-records
+
+typedef struct {
+    log_query_emit_t emit;
+    void *ctx;
+    long total;
+} sink_t;
+
+static int out_flush(sink_t *s)
+{
+    if (s_out_len == 0) return 0;
+    if (s->emit(s->ctx, s_out, s_out_len) != 0) return -1;
+    s->total += (long)s_out_len;
+    s_out_len = 0;
+    return 0;
+}
+
+static int out_put(sink_t *s, const char *p, size_t n)
+{
+    if (s_out_len + n > sizeof(s_out) && out_flush(s) != 0) return -1;
+    memcpy(s_out + s_out_len, p, n);
+    s_out_len += n;
+    return 0;
+}
+
+// "ts" of a record line, false if the line is not a record
+static bool line_ts(const char *line, int64_t *ts)
+{
+    static const char prefix[] = "{\"ts\":";
+    if (strncmp(line, prefix, sizeof(prefix) - 1) != 0) return false;
+    char *end;
+    long long v = strtoll(line + sizeof(prefix) - 1, &end, 10);
+    if (end == line + sizeof(prefix) - 1) return false;
+    *ts = v;
+    return true;
+}
+
+static void index_relpath(const char *seg_relpath, char *out, size_t out_sz)
+{
+    size_t n = strlen(seg_relpath);
+    if (n > 5 && strcmp(seg_relpath + n - 5, ".json") == 0) n -= 5;
+    snprintf(out, out_sz, "%.*s.idx", (int)n, seg_relpath);
+}
+
+static int cmp_unsigned(const void *a, const void *b)
+{
+    unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+    return (x > y) - (x < y);
+}
+
+// The lowest max indexes above `after` of the entries of reldir matching fmt
+// and ending in suffix, ascending. Every entry is looked at (readdir order
+// is arbitrary), so calling again with after = the last index returned
+// walks the whole directory in order with a bounded buffer.
+static int collect_sorted(const char *reldir, const char *fmt, const char *suffix, long after, unsigned *out, int max)
+{
+    DIR *d = usb_opendir(reldir);
+    if (!d) return 0;
+    int n = 0;
+    size_t slen = strlen(suffix);
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        unsigned idx;
+        size_t len = strlen(e->d_name);
+        if (sscanf(e->d_name, fmt, &idx) != 1 || len < slen || strcmp(e->d_name + len - slen, suffix) != 0) continue;
+        if ((long)idx <= after) continue;
+        if (n < max) {
+            out[n++] = idx;
+        } else {
+            // full: keep the max lowest, replace the current highest
+            int hi = 0;
+            for (int i = 1; i < n; i++) if (out[i] > out[hi]) hi = i;
+            if (idx < out[hi]) out[hi] = idx;
+        }
+    }
+    closedir(d);
+    qsort(out, (size_t)n, sizeof(out[0]), cmp_unsigned);
+    return n;
+}
+
+int log_query_parse_channels(const char *list, uint32_t *mask)
+{
+    *mask = 0;
+    while (list && *list) {
+        const char *comma = strchr(list, ',');
+        size_t len = comma ? (size_t)(comma - list) : strlen(list);
+        // a key logged with different decimals over time has one slot for each
+        uint32_t found = 0;
+        const obd_slot_t *slots = obd_slots();
+        for (int ch = 0; ch < obd_slot_count(); ch++) {
+            if (strlen(slots[ch].key) == len && memcmp(slots[ch].key, list, len) == 0) found |= 1u << ch;
+        }
+        if (!found) return -1;
+        *mask |= found;
+        list = comma ? comma + 1 : NULL;
+    }
+    return 0;
+}
+
+// Where to start looking for the from and to bounds: the offset of the last
+// index entry keyed below each. Returns -1 if the segment has no index.
+static int index_hints(const char *idx_relpath, int64_t from, int64_t to_excl, long end,
+                       long *hint_from, long *hint_to)
+{
+    if (!usb_file_exists(idx_relpath)) return -1;
+    FILE *f = usb_fopen(idx_relpath, "r");
+    if (!f) return -1;
+    *hint_from = 0;
+    *hint_to = 0;
+    char line[48];
+    while (fgets(line, sizeof(line), f)) {
+        long long ts;
+        long off;
+        if (sscanf(line, "%lld %ld", &ts, &off) != 2 || off < 0 || off >= end) continue;
+        if (ts < from) *hint_from = off;
+        if (ts >= to_excl) break; // entries are in ts order
+        *hint_to = off;
+    }
+    fclose(f);
+    return 0;
+}
+
+// Offset of the first record at or after off with ts >= key, end if none
+static long seek_ts(FILE *f, long off, long end, int64_t key)
+{
+    if (fseek(f, off, SEEK_SET) != 0) return end;
+    while (off < end && fgets(s_line, sizeof(s_line), f)) {
+        int64_t ts;
+        if (line_ts(s_line, &ts) && ts >= key) return off;
+        off += (long)strlen(s_line);
+    }
+    return off < end ? off : end;
+}
+
+// Whole lines [start, stop) as stored, read straight into the output chunk
+static int copy_range(sink_t *s, FILE *f, long start, long stop)
+{
+    if (fseek(f, start, SEEK_SET) != 0) return 0;
+    long left = stop - start;
+    while (left > 0) {
+        if (s_out_len == sizeof(s_out) && out_flush(s) != 0) return -1;
+        size_t want = sizeof(s_out) - s_out_len;
+        if ((long)want > left) want = (size_t)left;
+        size_t n = fread(s_out + s_out_len, 1, want, f);
+        if (n == 0) break;
+        s_out_len += n;
+        left -= (long)n;
+    }
+    return 0;
+}
+
+// "ts" and the selected keys of one record line; 0 if it is not a record
+static size_t project_line(const char *line, uint32_t mask, char *out)
+{
+    int64_t ts;
+    if (!line_ts(line, &ts)) return 0;
+    const char *p = strpbrk(line + 6, ",}");
+    if (!p) return 0;
+    size_t n = (size_t)(p - line);
+    memcpy(out, line, n);
+    while (*p == ',') {
+        const char *field = p;              // ", \"key\":value"
+        const char *k = strchr(p, '"');
+        const char *ke = k ? strchr(k + 1, '"') : NULL;
+        if (!ke) break;
+        p = strpbrk(ke, ",}");
+        if (!p) break;
+        size_t klen = (size_t)(ke - k - 1);
+        const obd_slot_t *slots = obd_slots();
+        for (int ch = 0; ch < obd_slot_count(); ch++) {
+            if ((mask & (1u << ch)) && strlen(slots[ch].key) == klen && memcmp(slots[ch].key, k + 1, klen) == 0) {
+                memcpy(out + n, field, (size_t)(p - field));
+                n += (size_t)(p - field);
+                break;
+            }
+        }
+    }
+    out[n++] = '}';
+    out[n++] = '\n';
+    return n;
+}
+
+static int project_range(sink_t *s, FILE *f, long start, long stop, uint32_t mask)
+{
+    if (fseek(f, start, SEEK_SET) != 0) return 0;
+    long off = start;
+    char out[sizeof(s_line) + 2];
+    while (off < stop && fgets(s_line, sizeof(s_line), f)) {
+        off += (long)strlen(s_line);
+        size_t n = project_line(s_line, mask, out);
+        if (n && out_put(s, out, n) != 0) return -1;
+    }
+    return 0;
+}
+
+static int query_segment(sink_t *s, const char *relpath, const log_query_t *q, int64_t from, int64_t to_excl,
+                         unsigned session, int64_t offset_ms, bool *header_sent)
+{
+    long end = usb_log_data_end(relpath);
+    if (end <= 0) return 0;
+
+    char idx[96];
+    index_relpath(relpath, idx, sizeof(idx));
+    long hint_from = 0, hint_to = 0;
+    if (index_hints(idx, from, to_excl, end, &hint_from, &hint_to) != 0 &&
+        log_index_rebuild(relpath) >= 0) {
+        index_hints(idx, from, to_excl, end, &hint_from, &hint_to);
+    }
+
+    FILE *f = usb_fopen(relpath, "r");
+    if (!f) return 0; // e.g. held open by the writer: skipped
+    int ret = 0;
+    long start = seek_ts(f, hint_from, end, from);
+    long stop = start < end ? seek_ts(f, hint_to > start ? hint_to : start, end, to_excl) : end;
+    if (start < stop) {
+        if (!*header_sent) {
+            char hdr[64];
+            int n = snprintf(hdr, sizeof(hdr), "{\"session\":%u,\"offset_ms\":%lld}\n", session, (long long)offset_ms);
+            ret = out_put(s, hdr, (size_t)n);
+            *header_sent = true;
+        }
+        if (ret == 0) ret = q->channels ? project_range(s, f, start, stop, q->channels) : copy_range(s, f, start, stop);
+    }
+    fclose(f);
+    return ret;
+}
+
+static int query_session(sink_t *s, const log_query_t *q, unsigned session)
+{
+    int64_t offset_ms;
+    if (!log_clock_offset(session, &offset_ms)) return 0; // never synced: no epoch time
+    int64_t from = q->from_ms - offset_ms;
+    int64_t to_excl = q->to_ms == INT64_MAX ? INT64_MAX : q->to_ms - offset_ms + 1;
+    if (to_excl <= from) return 0;
+
+    static unsigned segs[LOG_QUERY_MAX_SEGMENTS];
+    char dir[32];
+    snprintf(dir, sizeof(dir), "%s/s%05u", LOG_QUERY_BASE_DIR, session);
+    bool header_sent = false;
+    int nseg;
+    for (long after = -1; (nseg = collect_sorted(dir, "seg-%05u", ".json", after, segs, LOG_QUERY_MAX_SEGMENTS)) > 0;
+         after = segs[nseg - 1]) {
+        for (int k = 0; k < nseg; k++) {
+            char relpath[64];
+            snprintf(relpath, sizeof(relpath), "%s/seg-%05u.json", dir, segs[k]);
+            if (query_segment(s, relpath, q, from, to_excl, session, offset_ms, &header_sent) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+long log_query_run(const log_query_t *q, log_query_emit_t emit, void *ctx)
+{
+    sink_t s = { .emit = emit, .ctx = ctx, .total = 0 };
+    s_out_len = 0;
+
+    static unsigned sessions[LOG_QUERY_MAX_SESSIONS];
+    int ns;
+    for (long after = -1; (ns = collect_sorted(LOG_QUERY_BASE_DIR, "s%05u", "", after, sessions, LOG_QUERY_MAX_SESSIONS)) > 0;
+         after = sessions[ns - 1]) {
+        for (int i = 0; i < ns; i++) {
+            if (query_session(&s, q, sessions[i]) != 0) return -1;
+        }
+    }
+    if (out_flush(&s) != 0) return -1;
+    return s.total;
+}
+
+int log_index_rebuild(const char *seg_relpath)
+{
+    if (usb_log_is_current(seg_relpath)) return -1; // the writer owns that index
+    long end = usb_log_data_end(seg_relpath);
+    if (end < 0) return -1;
+    FILE *f = usb_fopen(seg_relpath, "r");
+    if (!f) return -1;
+    char idx[96];
+    index_relpath(seg_relpath, idx, sizeof(idx));
+    FILE *o = usb_fopen(idx, "w");
+    if (!o) {
+        fclose(f);
+        return -1;
+    }
+
+    int n = 0;
+    long off = 0, next = 0;
+    while (off < end && fgets(s_line, sizeof(s_line), f)) {
+        int64_t ts;
+        if (off >= next && line_ts(s_line, &ts)) {
+            fprintf(o, "%lld %ld\n", (long long)ts, off);
+            n++;
+            next = (off / USB_INDEX_STRIDE + 1) * USB_INDEX_STRIDE;
+        }
+        off += (long)strlen(s_line);
+    }
+    fclose(o);
+    fclose(f);
+    ESP_LOGI(TAG, "rebuilt %s (%d entries)", idx, n);
+    return n;
+}
+
+int log_index_rebuild_all(void)
+{
+    static unsigned sessions[LOG_QUERY_MAX_SESSIONS];
+    static unsigned segs[LOG_QUERY_MAX_SEGMENTS];
+    int done = 0;
+    int ns, nseg;
+    for (long after = -1; (ns = collect_sorted(LOG_QUERY_BASE_DIR, "s%05u", "", after, sessions, LOG_QUERY_MAX_SESSIONS)) > 0;
+         after = sessions[ns - 1]) {
+        for (int i = 0; i < ns; i++) {
+            char dir[32];
+            snprintf(dir, sizeof(dir), "%s/s%05u", LOG_QUERY_BASE_DIR, sessions[i]);
+            for (long seg_after = -1; (nseg = collect_sorted(dir, "seg-%05u", ".json", seg_after, segs, LOG_QUERY_MAX_SEGMENTS)) > 0;
+                 seg_after = segs[nseg - 1]) {
+                for (int k = 0; k < nseg; k++) {
+                    char relpath[64];
+                    snprintf(relpath, sizeof(relpath), "%s/seg-%05u.json", dir, segs[k]);
+                    if (log_index_rebuild(relpath) >= 0) done++;
+                }
+            }
+        }
+    }
+    return done;
+}
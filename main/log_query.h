@@ -0,0 +1,48 @@
+#ifndef LOG_QUERY_H
+#define LOG_QUERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Time range queries over the segments on the stick. For each session with
+ * a known clock offset (log_clock.h) the range is mapped to the session's
+ * monotonic ms, each segment's sparse index (usb_storage.h) gives the
+ * stride to start reading from, and a short scan finds the exact first and
+ * last record. Without a channel filter the byte range in between is copied
+ * as is, file reads straight into the output buffer; with one every line is
+ * reduced to "ts" and the selected keys.
+ *
+ * Output is NDJSON. Records keep the session's "ts"; each session starts
+ * with a {"session":N,"offset_ms":X} line, so epoch ms = ts + offset_ms.
+ *
+ * One query at a time (static buffers).
+ */
+#define LOG_QUERY_BASE_DIR      "logs"
+#define LOG_QUERY_MAX_SESSIONS  64      // sessions per directory scan; a query walks all of them, oldest first
+#define LOG_QUERY_MAX_SEGMENTS  128     // segments per directory scan
+#define LOG_QUERY_BUF_SIZE      4096    // output chunk
+
+typedef struct {
+    int64_t from_ms;        // epoch ms, inclusive
+    int64_t to_ms;          // epoch ms, inclusive
+    uint32_t channels;      // bit per channel slot (obd_plan.h), 0 = records as stored
+} log_query_t;
+
+/** Output sink; return 0 to continue, -1 to abort the query. */
+typedef int (*log_query_emit_t)(void *ctx, const char *data, size_t len);
+
+/** Parse a comma separated list of channel keys ("rpm,speed"). Returns -1 on an unknown key. */
+int log_query_parse_channels(const char *list, uint32_t *mask);
+
+/** Stream the matching records to emit. Returns the bytes emitted, -1 if emit aborted. */
+long log_query_run(const log_query_t *q, log_query_emit_t emit, void *ctx);
+
+/** Recreate the .idx of a closed segment from its data. Returns the entries written, -1 on error. */
+int log_index_rebuild(const char *seg_relpath);
+
+/** Rebuild the index of every closed segment. Returns the segments reindexed. */
+int log_index_rebuild_all(void);
+
+#endif // LOG_QUERY_H
@@ -16,21 +16,13 @@
 #include "esp_system.h"
 #include "esp_mac.h"
 #include "esp_log.h"
-#include "nvs_flash.h"
-#include "wifi_manager.h"
-#include "usb_storage.h"
-#include "obd_bluetooth.h"
-
-
+#include "boot.h"
 
 void app_main(void)
 {
     printf("Hello world!\n");
 
-    // wifi_scan_and_connect();
-    // usb_main_test();
-    obd_bt_init();
-    obd_start_polling(MAC_ADDRESS_OBD, 1000); // MAC ELM327 reale, intervallo 1000 ms
-    
-    
+    // NVS, Bluetooth, storage and Wi-Fi come up in parallel; OBD polling
+    // starts as soon as Bluetooth and the logger are ready (boot.h)
+    boot_start();
 }
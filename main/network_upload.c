@@ -0,0 +1,349 @@
+#include "network_upload.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_http_client.h"
+#include "wifi_manager.h"
+#include "usb_storage.h"
+#include "log_clock.h"
+#include "app_alloc.h"
+#include "trace.h"
+#include "radio_coex.h"
+
+static const char *TAG = "upload";
+
+static network_upload_stats_t s_stats;
+static char s_in[UPLOAD_CHUNK_SIZE];            // segment bytes, incomplete last line carried over
+static char s_out[UPLOAD_CHUNK_SIZE + 32];      // rewritten lines waiting to be sent
+static size_t s_out_len = 0;
+
+APP_TASK_STORAGE(s_upload_task, 6144);
+
+// Copy one line, replacing the leading "ts" (ms since boot) with epoch ms
+static size_t rewrite_line(const char *line, size_t len, int64_t offset_ms, char *out)
+{
+    static const char prefix[] = "{\"ts\":";
+    const size_t plen = sizeof(prefix) - 1;
+    if (len > plen && memcmp(line, prefix, plen) == 0) {
+        char *end;
+        long long ts = strtoll(line + plen, &end, 10); // stops at the ',' or '}' after the digits
+        if (end > line + plen) {
+            int n = sprintf(out, "%s%lld", prefix, ts + offset_ms);
+            size_t rest = len - (size_t)(end - line);
+            memcpy(out + n, end, rest);
+            return (size_t)n + rest;
+        }
+    }
+    memcpy(out, line, len);
+    return len;
+}
+
+// Send s_out as chunks of the chunked POST body, each sized to fit a gap
+// between OBD requests (radio_coex.h)
+static int send_chunk(esp_http_client_handle_t client)
+{
+    bool ok = true;
+    for (size_t sent = 0; ok && sent < s_out_len;) {
+        size_t len = radio_coex_tx_grant(s_out_len - sent);
+        char hdr[12];
+        int n = snprintf(hdr, sizeof(hdr), "%x\r\n", (unsigned)len);
+        int64_t t_chunk = TRACE_BEGIN();
+        ok = esp_http_client_write(client, hdr, n) == n &&
+             esp_http_client_write(client, s_out + sent, (int)len) == (int)len &&
+             esp_http_client_write(client, "\r\n", 2) == 2;
+        TRACE_END(HTTP_CHUNK, t_chunk);
+        sent += len;
+    }
+    s_stats.bytes += s_out_len;
+    s_out_len = 0;
+    return ok ? 0 : -1;
+}
+
+// Stream one closed segment; returns 0 once the server confirmed it
+static int upload_segment(const char *relpath, int64_t offset_ms)
+{
+    long end = usb_log_data_end(relpath);
+    if (end <= 0) return end == 0 ? 0 : -1;
+    FILE *f = usb_fopen(relpath, "r");
+    if (!f) return -1;
+
+    esp_http_client_config_t cfg = {
+        .url = UPLOAD_URL,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = UPLOAD_TIMEOUT_MS,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&cfg);
+    if (!client) {
+        fclose(f);
+        return -1;
+    }
+    esp_http_client_set_header(client, "Content-Type", "application/x-ndjson");
+
+    int ret = -1;
+    if (esp_http_client_open(client, -1) != ESP_OK) { // -1: chunked body
+        ESP_LOGW(TAG, "connect to %s failed", UPLOAD_URL);
+        goto out;
+    }
+
+    long remaining = end;
+    size_t carry = 0;
+    s_out_len = 0;
+    while (remaining > 0) {
+        size_t want = sizeof(s_in) - carry;
+        if ((long)want > remaining) want = (size_t)remaining;
+        size_t n = fread(s_in + carry, 1, want, f);
+        if (n == 0) goto out;
+        remaining -= (long)n;
+        size_t avail = carry + n;
+
+        size_t pos = 0;
+        char *nl;
+        while ((nl = memchr(s_in + pos, '\n', avail - pos)) != NULL) {
+            size_t len = (size_t)(nl - (s_in + pos)) + 1;
+            if (s_out_len + len + 32 > sizeof(s_out) && send_chunk(client) != 0) goto out;
+            s_out_len += rewrite_line(s_in + pos, len, offset_ms, s_out + s_out_len);
+            s_stats.records++;
+            pos += len;
+        }
+        carry = avail - pos;
+        if (carry == sizeof(s_in)) carry = 0; // no newline in a whole buffer: not a record
+        memmove(s_in, s_in + pos, carry);
+    }
+    // a trailing partial line is a record cut by power loss: not sent
+    if (send_chunk(client) != 0 || esp_http_client_write(client, "0\r\n\r\n", 5) != 5) goto out;
+
+    esp_http_client_fetch_headers(client);
+    int status = esp_http_client_get_status_code(client);
+    if (status == 200) {
+        ret = 0;
+    } else {
+        ESP_LOGW(TAG, "%s: HTTP %d", relpath, status);
+    }
+out:
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    fclose(f);
+    return ret;
+}
+
+// Indexes of the entries of reldir matching fmt and ending in suffix: sscanf
+// stops at the number, so "seg-00007.idx" would match "seg-%05u.json" too
+static int collect_indexes(const char *reldir, const char *fmt, const char *suffix, unsigned *out, int max)
+{
+    DIR *d = usb_opendir(reldir);
+    if (!d) return 0;
+    int n = 0;
+    size_t slen = strlen(suffix);
+    struct dirent *e;
+    while (n < max && (e = readdir(d)) != NULL) {
+        unsigned idx;
+        size_t len = strlen(e->d_name);
+        if (sscanf(e->d_name, fmt, &idx) == 1 && len >= slen && strcmp(e->d_name + len - slen, suffix) == 0) {
+            out[n++] = idx;
+        }
+    }
+    closedir(d);
+    return n;
+}
+
+// The lowest UPLOAD_MAX_BATCH sessions after `after` whose clock is known,
+// ascending. Every directory entry is looked at: sessions that never synced
+// are skipped without taking a slot, so they cannot hide later ones. held
+// counts them.
+static int collect_sessions(unsigned after, unsigned *out, int64_t *offsets, uint32_t *held)
+{
+    DIR *d = usb_opendir(UPLOAD_BASE_DIR);
+    if (!d) return 0;
+    int n = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        unsigned session;
+        char extra;
+        if (sscanf(e->d_name, "s%05u%c", &session, &extra) != 1 || session <= after) continue;
+        int64_t offset_ms;
+        if (!log_clock_offset(session, &offset_ms)) {
+            if (held) (*held)++;
+            continue;
+        }
+        if (n == UPLOAD_MAX_BATCH && session > out[n - 1]) continue;
+        int i = n < UPLOAD_MAX_BATCH ? n++ : n - 1;   // full: the highest one drops out
+        for (; i > 0 && out[i - 1] > session; i--) {
+            out[i] = out[i - 1];
+            offsets[i] = offsets[i - 1];
+        }
+        out[i] = session;
+        offsets[i] = offset_ms;
+    }
+    closedir(d);
+    return n;
+}
+
+// Bytes in the closed segments of one session
+static uint32_t session_backlog(unsigned session)
+{
+    uint32_t total = 0;
+    char dir[32];
+    snprintf(dir, sizeof(dir), "%s/s%05u", UPLOAD_BASE_DIR, session);
+    unsigned segs[UPLOAD_MAX_BATCH];
+    int nseg = collect_indexes(dir, "seg-%05u.json", ".json", segs, UPLOAD_MAX_BATCH);
+    for (int k = 0; k < nseg; k++) {
+        char relpath[64];
+        snprintf(relpath, sizeof(relpath), "%s/seg-%05u.json", dir, segs[k]);
+        if (usb_log_is_current(relpath)) continue;
+        long end = usb_log_data_end(relpath);
+        if (end > 0) total += (uint32_t)end;
+    }
+    return total;
+}
+
+// Bytes in closed segments that can be sent (session clock known)
+static uint32_t backlog_bytes(void)
+{
+    uint32_t total = 0;
+    unsigned sessions[UPLOAD_MAX_BATCH];
+    int64_t offsets[UPLOAD_MAX_BATCH];
+    int ns;
+    for (unsigned after = 0; (ns = collect_sessions(after, sessions, offsets, NULL)) > 0; after = sessions[ns - 1]) {
+        for (int i = 0; i < ns; i++) total += session_backlog(sessions[i]);
+    }
+    return total;
+}
+
+// Upload the closed segments of one session; returns the segments uploaded,
+// -1 if an upload failed
+static int upload_session(unsigned session, int64_t offset_ms)
+{
+    int uploaded = 0;
+    char dir[32];
+    snprintf(dir, sizeof(dir), "%s/s%05u", UPLOAD_BASE_DIR, session);
+    unsigned segs[UPLOAD_MAX_BATCH];
+    int nseg = collect_indexes(dir, "seg-%05u.json", ".json", segs, UPLOAD_MAX_BATCH);
+    int left = 0;
+    for (int k = 0; k < nseg; k++) {
+        char relpath[64];
+        snprintf(relpath, sizeof(relpath), "%s/seg-%05u.json", dir, segs[k]);
+        if (usb_log_is_current(relpath)) {
+            left++;
+            continue;
+        }
+        if (upload_segment(relpath, offset_ms) != 0) {
+            s_stats.failures++;
+            return -1;
+        }
+        usb_remove(relpath);
+        snprintf(relpath, sizeof(relpath), "%s/seg-%05u.idx", dir, segs[k]);
+        usb_remove(relpath); // its time index
+        snprintf(relpath, sizeof(relpath), "%s/seg-%05u.end", dir, segs[k]);
+        if (usb_file_exists(relpath)) usb_remove(relpath); // end marker of a never-closed segment
+        s_stats.segments++;
+        uploaded++;
+        ESP_LOGI(TAG, "uploaded %s", relpath);
+    }
+    if (left == 0 && nseg < UPLOAD_MAX_BATCH && session != log_clock_session()) {
+        usb_remove(dir);
+    }
+    return uploaded;
+}
+
+// One pass over all sessions, oldest first; returns the segments uploaded,
+// -1 at the first failed upload: the network is probably gone, the rest waits.
+static int upload_pass(void)
+{
+    int uploaded = 0;
+    unsigned sessions[UPLOAD_MAX_BATCH];
+    int64_t offsets[UPLOAD_MAX_BATCH];
+    int ns;
+    for (unsigned after = 0; (ns = collect_sessions(after, sessions, offsets, after ? NULL : &s_stats.held_back)) > 0;
+         after = sessions[ns - 1]) {
+        for (int i = 0; i < ns; i++) {
+            int n = upload_session(sessions[i], offsets[i]);
+            if (n < 0) return -1;
+            uploaded += n;
+        }
+    }
+    return uploaded;
+}
+
+static bool clock_synced(void)
+{
+    int64_t offset_ms;
+    return log_clock_offset(log_clock_session(), &offset_ms);
+}
+
+// Radio on, upload until nothing is left, radio off. Returns false if the
+// session should be retried later (no network, upload or NTP failed).
+static bool drain(void)
+{
+    s_stats.wifi_sessions++;
+    if (!wifi_session_begin()) return false;
+    // the offset of this boot is only known after NTP: give it a moment
+    for (int waited = 0; !clock_synced() && waited < UPLOAD_SYNC_WAIT_MS; waited += 500) {
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+    radio_coex_upload_active(true);
+    int n;
+    while ((n = upload_pass()) > 0) {
+        // a pass takes at most UPLOAD_MAX_BATCH entries per directory
+    }
+    radio_coex_upload_active(false);
+    bool synced = clock_synced();
+    wifi_session_end();
+    return n == 0 && synced;
+}
+
+static void network_upload_task(void *arg)
+{
+    (void)arg;
+    uint32_t reported = 0;
+    int64_t backlog_since = 0;          // when unsent data was first seen, 0 if none
+    int64_t retry_at = 0;
+    uint32_t retry_ms = UPLOAD_PERIOD_MS;
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(UPLOAD_PERIOD_MS));
+        if (!usb_storage_wait_mounted(0)) continue;
+
+        int64_t now = log_clock_now_ms();
+        s_stats.backlog_bytes = backlog_bytes();
+        if (s_stats.backlog_bytes == 0) {
+            backlog_since = 0;
+        } else if (backlog_since == 0) {
+            backlog_since = now;
+        }
+        bool need_sync = !clock_synced();
+        bool due = s_stats.backlog_bytes >= UPLOAD_BACKLOG_BYTES ||
+                   (backlog_since && now - backlog_since >= UPLOAD_BACKLOG_AGE_MS) || need_sync;
+        if (!due || now < retry_at) continue;
+
+        ESP_LOGI(TAG, "backlog %" PRIu32 " bytes%s: Wi-Fi on", s_stats.backlog_bytes,
+                 need_sync ? ", clock not synced" : "");
+        if (drain()) {
+            retry_ms = UPLOAD_PERIOD_MS;
+            retry_at = 0;
+            backlog_since = 0;
+        } else {
+            retry_at = log_clock_now_ms() + retry_ms;
+            ESP_LOGW(TAG, "drain incomplete, next try in %" PRIu32 " s", retry_ms / 1000);
+            retry_ms = retry_ms * 2 < UPLOAD_RETRY_MAX_MS ? retry_ms * 2 : UPLOAD_RETRY_MAX_MS;
+        }
+        if (s_stats.segments != reported) {
+            reported = s_stats.segments;
+            radio_coex_log_stats();
+        }
+    }
+}
+
+esp_err_t network_upload_start(void)
+{
+    BaseType_t ok = APP_TASK_CREATE(s_upload_task, network_upload_task, "upload", NULL, tskIDLE_PRIORITY + 1, NULL);
+    return ok == pdPASS ? ESP_OK : ESP_FAIL;
+}
+
+void network_upload_get_stats(network_upload_stats_t *out)
+{
+    if (out) *out = s_stats;
+}
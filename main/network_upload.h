@@ -0,0 +1,44 @@
+#ifndef NETWORK_UPLOAD_H
+#define NETWORK_UPLOAD_H
+
+#include <stdint.h>
+#include <esp_err.h>
+
+#define UPLOAD_URL              "http://192.168.1.100:1880/api/telemetria"  // Node-RED endpoint
+#define UPLOAD_BASE_DIR         "logs"      // session directories written by the data logger
+#define UPLOAD_PERIOD_MS        60000       // check the backlog this often
+#define UPLOAD_BACKLOG_BYTES    (256 * 1024)        // switch Wi-Fi on once this much is waiting...
+#define UPLOAD_BACKLOG_AGE_MS   (30 * 60 * 1000)    // ...or the oldest unsent data is this old
+#define UPLOAD_RETRY_MAX_MS     (30 * 60 * 1000)    // failed sessions back off up to this
+#define UPLOAD_SYNC_WAIT_MS     10000       // wait for NTP after joining if this boot never synced
+#define UPLOAD_CHUNK_SIZE       4096        // bytes read from the stick per HTTP chunk
+#define UPLOAD_MAX_BATCH        16          // segments collected per directory scan
+#define UPLOAD_TIMEOUT_MS       10000
+
+typedef struct {
+    uint32_t segments;      // segments confirmed by the server and deleted
+    uint32_t bytes;         // payload bytes sent
+    uint32_t records;
+    uint32_t held_back;     // session scans skipped: that boot never synced NTP
+    uint32_t failures;
+    uint32_t wifi_sessions; // radio switched on for a drain
+    uint32_t backlog_bytes; // closed segments waiting, at the last check
+} network_upload_stats_t;
+
+/**
+ * Start the uploader task. It owns the Wi-Fi duty cycle: the radio stays off
+ * until the closed segments on the stick reach UPLOAD_BACKLOG_BYTES, the
+ * oldest of them reaches UPLOAD_BACKLOG_AGE_MS, or this boot still needs an
+ * NTP sync. Then it joins a network, drains the backlog and switches the
+ * radio off again.
+ *
+ * Every closed segment is streamed to UPLOAD_URL as NDJSON (HTTP chunked
+ * POST), adding the session's clock offset (log_clock.h) to each "ts" on the
+ * way, and deleted once the server answers 200. Chunks are paced by
+ * radio_coex.h so they go out between OBD requests.
+ */
+esp_err_t network_upload_start(void);
+
+void network_upload_get_stats(network_upload_stats_t *out);
+
+#endif // NETWORK_UPLOAD_H
@@ -5,206 +5,104 @@
 #include <stdlib.h>
 #include "esp_log.h"
 #include "esp_err.h"
-#include "esp_bt.h"
-#include "esp_bt_main.h"
-#include "esp_bt_device.h"
-#include "esp_spp_api.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "obd_transport.h"
+#include "obd_channels.h"
+#include "obd_plan.h"
+#include "obd_reply.h"
+#include "obd_vehicle.h"
+#include "data_logger.h"
+#include "app_alloc.h"
+#include "heap_guard.h"
+#include "dlog.h"
+#include "trace.h"
+#include "log_clock.h"
+#include "vehicle_state.h"
+#include "radio_coex.h"
 
 static const char *TAG = "obd_bt";
 
-static bool s_connected = false;
-static uint32_t s_spp_handle = 0;
-static QueueHandle_t s_rx_queue = NULL; // queue of char* (allocated packets)
+static const obd_transport_t *s_link = NULL;   // selected with OBD_TRANSPORT
+static char s_tx_buf[OBD_CMD_MAX_LEN + 2];      // command + CR, reused for every write
 
-// SPP callback: handle basic events and data reception
-static void esp_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
-{
-    switch (event) {
-    case ESP_SPP_INIT_EVT:
-        ESP_LOGI(TAG, "ESP_SPP_INIT_EVT");
-        break;
-    case ESP_SPP_START_EVT:
-        ESP_LOGI(TAG, "ESP_SPP_START_EVT");
-        break;
-    case ESP_SPP_OPEN_EVT:
-        ESP_LOGI(TAG, "ESP_SPP_OPEN_EVT handle=%u", param->open.handle);
-        s_spp_handle = param->open.handle;
-        s_connected = true;
-        break;
-    case ESP_SPP_CLOSE_EVT:
-        ESP_LOGI(TAG, "ESP_SPP_CLOSE_EVT");
-        s_connected = false;
-        s_spp_handle = 0;
-        break;
-    case ESP_SPP_DATA_IND_EVT:
-    {
-        ESP_LOGI(TAG, "ESP_SPP_DATA_IND_EVT len=%d", param->data_ind.len);
-        // copy data into heap buffer and push pointer to queue
-        size_t len = param->data_ind.len;
-        char *pkt = pvPortMalloc(len + 1);
-        if (pkt) {
-            memcpy(pkt, param->data_ind.data, len);
-            pkt[len] = '\0';
-            if (s_rx_queue) {
-                if (xQueueSend(s_rx_queue, &pkt, 0) != pdTRUE) {
-                    // queue full, drop
-                    ESP_LOGW(TAG, "RX queue full, dropping packet");
-                    vPortFree(pkt);
-                }
-            } else {
-                vPortFree(pkt);
-            }
-        } else {
-            ESP_LOGW(TAG, "failed to allocate RX packet");
-        }
-    }
-        break;
-    case ESP_SPP_CONG_EVT:
-        ESP_LOGI(TAG, "ESP_SPP_CONG_EVT");
-        break;
-    default:
-        ESP_LOGD(TAG, "SPP event %d", event);
-        break;
-    }
-}
-
-esp_err_t obd_bt_init(void)
-{
-    esp_err_t ret;
-
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
-    ret = esp_bt_controller_init(&bt_cfg);
-    if (ret) {
-        ESP_LOGE(TAG, "bt controller init failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-
-    ret = esp_bt_controller_enable(ESP_BT_MODE_CLASSIC_BT);
-    if (ret) {
-        ESP_LOGE(TAG, "bt controller enable failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-
-    ret = esp_bluedroid_init();
-    if (ret) {
-        ESP_LOGE(TAG, "bluedroid init failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-
-    ret = esp_bluedroid_enable();
-    if (ret) {
-        ESP_LOGE(TAG, "bluedroid enable failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
+APP_TASK_STORAGE(s_poll_task, 4096);
 
-    ret = esp_spp_register_callback(esp_spp_cb);
-    if (ret) {
-        ESP_LOGE(TAG, "esp_spp_register_callback failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-
-    // old version
-    // ret = esp_spp_init(ESP_SPP_MODE_CB);
-    esp_spp_cfg_t bt_spp_cfg = {
-        .mode = ESP_SPP_MODE_CB,
-        .enable_l2cap_ertm = true,
-        .tx_buffer_size = 0, 
-    };
-    ret = esp_spp_enhanced_init(&bt_spp_cfg);
-    if (ret) {
-        ESP_LOGE(TAG, "esp_spp_init failed: %s", esp_err_to_name(ret));
-        return ret;
-    }
-
-    // Create RX queue for incoming SPP data (queue holds pointers to malloc'd packets)
-    if (!s_rx_queue) {
-        s_rx_queue = xQueueCreate(16, sizeof(char*));
-        if (!s_rx_queue) {
-            ESP_LOGW(TAG, "failed to create RX queue");
-        }
-    }
-
-    ESP_LOGI(TAG, "Bluetooth (SPP) initialized");
-    return ESP_OK;
-}
+static obd_conn_stats_t s_conn_stats = { .last_ttfs_ms = -1 };
 
-// Convert MAC string "AA:BB:CC:DD:EE:FF" to array of 6 bytes in reverse order for esp (BD_ADDR)
-static bool mac_str_to_bda(const char *mac, uint8_t bda[6])
+esp_err_t obd_bt_init(void)
 {
-    if (!mac) return false;
-    int vals[6];
-    if (sscanf(mac, "%x:%x:%x:%x:%x:%x", &vals[0], &vals[1], &vals[2], &vals[3], &vals[4], &vals[5]) == 6) {
-        for (int i = 0; i < 6; i++) bda[i] = (uint8_t)vals[i];
-        return true;
-    }
-    return false;
+    s_link = obd_transport_default();
+    ESP_LOGI(TAG, "OBD transport: %s", s_link->name);
+    return s_link->init();
 }
 
 int obd_bt_connect(const char *mac_str)
 {
-    if (!mac_str) return -1;
-    if (s_connected) return 0; // already connected
+    if (!mac_str || !s_link) return -1;
+    if (s_link->is_open()) return 0; // already connected
 
-    uint8_t remote_bda[6];
-    if (!mac_str_to_bda(mac_str, remote_bda)) {
-        ESP_LOGE(TAG, "invalid mac string");
-        return -1;
-    }
-
-    // Use default security and client role, SCN is typically 1 for ELM327
-    esp_err_t err = esp_spp_connect(ESP_SPP_SEC_NONE, ESP_SPP_ROLE_MASTER, 1, remote_bda);
+    esp_err_t err = s_link->open(mac_str, OBD_CONNECT_TIMEOUT_MS);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_spp_connect failed: %s", esp_err_to_name(err));
+        ESP_LOGW(TAG, "%s open to %s failed: %s", s_link->name, mac_str, esp_err_to_name(err));
         return -1;
     }
-    ESP_LOGI(TAG, "Initiated SPP connect to %s", mac_str);
+    ESP_LOGI(TAG, "%s link to %s open", s_link->name, mac_str);
     return 0;
 }
 
-int obd_send_cmd_and_read(const char *cmd, char *out, size_t out_sz, int timeout_ms)
+int obd_write_cmd(const char *cmd)
 {
-    if (!cmd || !out || out_sz == 0) return -1;
-    if (!s_connected || s_spp_handle == 0) return -1;
+    if (!cmd) return -1;
+    if (!s_link || !s_link->is_open()) return -1;
 
     // Send command with CR
     size_t cmd_len = strlen(cmd);
-    char *sendbuf = pvPortMalloc(cmd_len + 2);
-    if (!sendbuf) return -1;
-    memcpy(sendbuf, cmd, cmd_len);
-    sendbuf[cmd_len] = '\r';
-    sendbuf[cmd_len+1] = '\0';
-
-    esp_err_t err = esp_spp_write(s_spp_handle, cmd_len + 1, (uint8_t *)sendbuf);
-    vPortFree(sendbuf);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "esp_spp_write failed: %s", esp_err_to_name(err));
-        return -1;
+    if (cmd_len > OBD_CMD_MAX_LEN) return -1;
+    memcpy(s_tx_buf, cmd, cmd_len);
+    s_tx_buf[cmd_len] = '\r';
+    s_tx_buf[cmd_len+1] = '\0';
+
+    int64_t t_write = TRACE_BEGIN();
+    int w = s_link->write((const uint8_t *)s_tx_buf, cmd_len + 1);
+    TRACE_END(LINK_WRITE, t_write);
+    return w <= 0 ? -1 : 0;
+}
+
+int obd_send_cmd_and_read(const char *cmd, char *out, size_t out_sz, int timeout_ms)
+{
+    if (!cmd || !out || out_sz == 0) return -1;
+
+    obd_transport_rx_flush(); // drop a late reply to a previous, timed out command
+    if (obd_write_cmd(cmd) != 0) {
+        // a command the transport could not send (congestion, no credit) is a
+        // lost sample, not a lost link: only report an error once it is down
+        out[0] = '\0';
+        return obd_bt_is_connected() ? 0 : -1;
     }
 
-    // Collect incoming packets from queue until we see '>' prompt or timeout
+    // Collect incoming bytes from the stream until we see '>' prompt or timeout
     int remaining_ms = timeout_ms;
     size_t total = 0;
-    char *pkt = NULL;
     TickType_t start_tick = xTaskGetTickCount();
+    int64_t t_wait = TRACE_BEGIN();
     while (remaining_ms > 0 && total < out_sz - 1) {
         TickType_t wait_ticks = pdMS_TO_TICKS(remaining_ms);
         if (wait_ticks == 0) wait_ticks = 1;
-        if (s_rx_queue == NULL) break;
-        if (xQueueReceive(s_rx_queue, &pkt, wait_ticks) == pdTRUE) {
-            if (!pkt) continue;
-            // copy packet into output buffer
-            for (size_t i = 0; pkt[i] != '\0' && total < out_sz - 1; i++) {
-                char c = pkt[i];
-                out[total++] = c;
-                if (c == '>') break;
+        size_t n = obd_transport_rx_read((uint8_t *)out + total, out_sz - 1 - total, wait_ticks);
+        if (n > 0) {
+            if (total == 0) {
+                TRACE_END(WAIT_FIRST, t_wait);
+                t_wait = TRACE_BEGIN();
+            }
+            char *prompt = memchr(out + total, '>', n);
+            if (prompt) {
+                total = (size_t)(prompt - out) + 1;
+                TRACE_END(WAIT_PROMPT, t_wait);
+                break;
             }
-            vPortFree(pkt);
-            pkt = NULL;
-            // if last character written was '>' stop
-            if (total > 0 && out[total-1] == '>') break;
+            total += n;
         }
         // recompute remaining time
         TickType_t now = xTaskGetTickCount();
@@ -228,37 +126,336 @@ int obd_send_cmd_and_read(const char *cmd, char *out, size_t out_sz, int timeout
 
 void obd_bt_disconnect(void)
 {
-    if (s_connected && s_spp_handle) {
-        esp_spp_disconnect(s_spp_handle);
-    }
+    if (s_link) s_link->close();
 }
 
 bool obd_bt_is_connected(void)
 {
-    return s_connected;
+    return s_link && s_link->is_open();
+}
+
+static const struct {
+    uint16_t can11;
+    uint8_t addr;
+} s_ecus[OBD_ECU_COUNT] = {
+#define OBD_ECU_ADDR(id, can11, addr) { can11, addr },
+    OBD_ECU_LIST(OBD_ECU_ADDR)
+#undef OBD_ECU_ADDR
+};
+
+static obd_proto_t s_proto = OBD_PROTO_NONE;   // header format of the replies, set by adapter_setup
+static uint32_t s_ecu_ids[OBD_REPLY_MAX_MSGS];  // senders seen this session
+static obd_vehicle_t s_vehicle;                 // VIN and supported PIDs of the connected car
+static bool s_discovered = false;               // s_vehicle filled since adapter_setup
+static uint8_t s_fails[OBD_CH_MAX];             // polls in a row the ECUs ignored the channel
+
+static bool ecu_is(obd_ecu_t ecu, uint32_t id)
+{
+    switch (s_proto) {
+    case OBD_PROTO_CAN11: return id == s_ecus[ecu].can11;
+    case OBD_PROTO_CAN29: return id == (0x18DAF100u | s_ecus[ecu].addr);
+    case OBD_PROTO_LEGACY: return id == s_ecus[ecu].addr;
+    default: return false;
+    }
+}
+
+static void note_ecu(uint32_t id)
+{
+    for (int i = 0; i < s_conn_stats.ecus; i++) {
+        if (s_ecu_ids[i] == id) return;
+    }
+    if (s_conn_stats.ecus == OBD_REPLY_MAX_MSGS) return;
+    s_ecu_ids[s_conn_stats.ecus++] = id;
+    ESP_LOGI(TAG, "ECU %lX answering", (unsigned long)id);
+}
+
+// Route the mode 01 answers of every ECU in the reply to the channels of
+// the request: a channel takes the value of its own ECU (obd_channels.h), or
+// of the first one that answered its PID. Returns the channels decoded.
+static uint32_t decode_reply(const char *reply, uint32_t batch, obd_record_t *rec)
+{
+    const obd_plan_t *plan = obd_plan_active();
+    static obd_msg_t msgs[OBD_REPLY_MAX_MSGS];
+    int n = obd_reply_parse(reply, s_proto, msgs, OBD_REPLY_MAX_MSGS);
+    uint32_t got = 0, own = 0;
+    for (int m = 0; m < n; m++) {
+        const obd_msg_t *msg = &msgs[m];
+        if (msg->len < 1 || msg->data[0] != 0x41) continue;
+        note_ecu(msg->id);
+        int i = 1;
+        while (i < msg->len) {
+            uint8_t pid = msg->data[i++];
+            int bytes = -1;
+            for (int ch = 0; ch < OBD_CH_MAX && bytes < 0; ch++) {
+                if ((batch & (1u << ch)) && plan->pid[ch] == pid) bytes = plan->bytes[ch];
+            }
+            // a PID we did not ask for: its length is unknown, so is the rest
+            if (bytes < 0 || i + bytes > msg->len) break;
+            uint8_t d[4] = {0};     // channels on one PID may read different lengths of it
+            memcpy(d, msg->data + i, (size_t)(bytes < 4 ? bytes : 4));
+            for (int ch = 0; ch < OBD_CH_MAX; ch++) {
+                uint32_t bit = 1u << ch;
+                if (!(batch & bit) || plan->pid[ch] != pid || (own & bit)) continue;
+                bool mine = ecu_is((obd_ecu_t)plan->ecu[ch], msg->id);
+                if ((got & bit) && !mine) continue;
+                rec->v[ch] = obd_plan_decode(plan, ch, d);
+                got |= bit;
+                if (mine) own |= bit;
+            }
+            i += bytes;
+        }
+    }
+    rec->valid |= got;
+    return got;
+}
+
+void obd_bt_get_conn_stats(obd_conn_stats_t *out)
+{
+    if (out) *out = s_conn_stats;
+}
+
+// ATRV is answered by the adapter itself, ECU or not: a reply proves the link
+static bool adapter_alive(void)
+{
+    char reply[32];
+    return obd_send_cmd_and_read("ATRV", reply, sizeof(reply), OBD_PROBE_TIMEOUT_MS) > 0 &&
+           strchr(reply, 'V') != NULL;
+}
+
+// Open the link and wait until the adapter answers; replaces a fixed settle delay
+static bool connect_and_probe(const char *mac)
+{
+    if (obd_bt_connect(mac) != 0) return false;
+    for (int i = 0; i < OBD_READY_PROBES; i++) {
+        if (adapter_alive()) return true;
+        if (!obd_bt_is_connected()) return false;
+    }
+    ESP_LOGW(TAG, "link open but adapter not answering");
+    obd_bt_disconnect();
+    return false;
+}
+
+// Echo off and headers on, so every reply line starts with its sender. The
+// header format depends on the protocol, known once an ECU has answered
+// (detect_protocol); adapters refusing ATH1 get single PID requests.
+static void adapter_setup(void)
+{
+    char reply[32];
+    obd_send_cmd_and_read("ATE0", reply, sizeof(reply), OBD_PROBE_TIMEOUT_MS);
+    bool headers = obd_send_cmd_and_read("ATH1", reply, sizeof(reply), OBD_PROBE_TIMEOUT_MS) > 0 &&
+                   strstr(reply, "OK") != NULL;
+    s_proto = headers ? OBD_PROTO_UNKNOWN : OBD_PROTO_NONE;
+    s_conn_stats.ecus = 0;
+    s_conn_stats.skipped = 0;
+    s_discovered = false;
+    memset(s_fails, 0, sizeof(s_fails));
+    if (!headers) ESP_LOGW(TAG, "adapter refused ATH1, one ECU per reply");
+}
+
+static void detect_protocol(void)
+{
+    char reply[16];
+    if (obd_send_cmd_and_read("ATDPN", reply, sizeof(reply), OBD_PROBE_TIMEOUT_MS) <= 0) return;
+    reply[strcspn(reply, "\r\n")] = '\0';
+    s_proto = obd_proto_from_dpn(reply);
+    if (s_proto != OBD_PROTO_UNKNOWN) {
+        ESP_LOGI(TAG, "protocol %s, %s", reply, obd_proto_is_can(s_proto) ? "multi-PID requests" : "one PID per request");
+    }
+}
+
+// Send a request and split the reply; the first answer also settles the protocol
+static int request(const char *cmd, char *reply, size_t reply_sz, int timeout_ms, obd_msg_t *msgs)
+{
+    int r = obd_send_cmd_and_read(cmd, reply, reply_sz, timeout_ms);
+    if (r < 0) return -1;
+    if (s_proto == OBD_PROTO_UNKNOWN && r > 0) detect_protocol();
+    return obd_reply_parse(reply, s_proto, msgs, OBD_REPLY_MAX_MSGS);
+}
+
+// VIN from mode 09 PID 02: one ISO-TP message on CAN, five numbered
+// 4 byte messages before it. Leaves "" if no ECU reports one.
+static int read_vin(char *vin, char *reply, size_t reply_sz, obd_msg_t *msgs)
+{
+    int n = request("0902", reply, reply_sz, OBD_VIN_TIMEOUT_MS, msgs);
+    if (n < 0) return -1;
+    char buf[OBD_MSG_MAX];
+    int len = 0;
+    for (int m = 0; m < n; m++) {
+        // first sender only, skipping the count / sequence byte
+        if (msgs[m].id != msgs[0].id || msgs[m].len < 4 || msgs[m].data[0] != 0x49 || msgs[m].data[1] != 0x02) continue;
+        for (int i = 3; i < msgs[m].len && len < (int)sizeof(buf); i++) {
+            char c = (char)msgs[m].data[i];
+            if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z')) buf[len++] = c;  // drops the 00 padding
+        }
+    }
+    vin[0] = '\0';
+    if (len >= OBD_VIN_LEN) {
+        memcpy(vin, buf + len - OBD_VIN_LEN, OBD_VIN_LEN);
+        vin[OBD_VIN_LEN] = '\0';
+    }
+    return 0;
+}
+
+// Supported PID bitmaps, union over the ECUs. On CAN several ranges go in
+// one request (a range nobody has is simply left out of the answers); the
+// other protocols ask one range at a time while the last bit says there is
+// a next one. Returns 1 if an ECU answered, 0 if none did, -1 on link error.
+static int read_pid_bitmaps(uint32_t *pids, char *reply, size_t reply_sz, obd_msg_t *msgs)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    memset(pids, 0, OBD_PID_WORDS * sizeof(pids[0]));
+    bool answered = false;
+    int w = 0;
+    while (w < OBD_PID_WORDS && (w == 0 || (pids[w - 1] & 1))) {
+        char cmd[2 + 2 * OBD_MULTI_PID_MAX + 1] = "01";
+        int max = obd_proto_is_can(s_proto) ? OBD_MULTI_PID_MAX : 1;
+        int k = 0;
+        for (; k < max && w + k < OBD_PID_WORDS; k++) {
+            cmd[2 + 2 * k] = hex[(w + k) * 0x20 >> 4];
+            cmd[3 + 2 * k] = '0';
+        }
+        cmd[2 + 2 * k] = '\0';
+        w += k;
+        int n = request(cmd, reply, reply_sz, 3000, msgs);
+        if (n < 0) return -1;
+        for (int m = 0; m < n; m++) {
+            const obd_msg_t *msg = &msgs[m];
+            if (msg->len < 1 || msg->data[0] != 0x41) continue;
+            for (int i = 1; i + 5 <= msg->len && (msg->data[i] & 0x1F) == 0; i += 5) {
+                const uint8_t *d = msg->data + i + 1;
+                pids[msg->data[i] / 0x20] |= (uint32_t)d[0] << 24 | (uint32_t)d[1] << 16 | (uint32_t)d[2] << 8 | d[3];
+                answered = true;
+            }
+        }
+        if (!answered) return 0;
+    }
+    return 1;
+}
+
+// Channels of the active plan whose PID the car does not have; a fresh
+// start for the miss counts
+static void skip_unsupported(void)
+{
+    const obd_plan_t *plan = obd_plan_active();
+    s_conn_stats.skipped = 0;
+    memset(s_fails, 0, sizeof(s_fails));
+    if (!s_discovered) return;     // discover_vehicle calls again
+    for (int ch = 0; ch < OBD_CH_MAX; ch++) {
+        if ((plan->active & (1u << ch)) && !obd_vehicle_has_pid(&s_vehicle, plan->pid[ch])) {
+            s_conn_stats.skipped |= 1u << ch;
+        }
+    }
 }
 
-// Minimal parser for RPM from payload like: "41 0C AA BB"
-static int parse_pid_rpm(const char *payload)
+// Which car is this and which PIDs does it have: VIN first, bitmaps only if
+// the car is not cached. Channels whose PID no ECU has are not polled.
+// Returns 1 once known, 0 if the ECUs are silent, -1 on link error.
+static int discover_vehicle(void)
 {
-    if (!payload) return -1;
-    int a = 0, b = 0;
-    // find substring starting with "41 0C" (response for 010C)
-    const char *p = strstr(payload, "41 0C");
-    if (!p) p = strstr(payload, "410C");
-    if (!p) return -1;
-    if (sscanf(p, "41 0C %x %x", &a, &b) == 2 || sscanf(p, "410C %x %x", &a, &b) == 2) {
-        return ((a << 8) | b) / 4;
+    static char reply[512];
+    static obd_msg_t msgs[OBD_REPLY_MAX_MSGS];
+    obd_vehicle_t v = {0};
+    if (read_vin(v.vin, reply, sizeof(reply), msgs) < 0) return -1;
+    // runs inside the polling cycle after every reconnect: nvs_open allocates
+    heap_guard_exempt_begin();
+    bool cached = obd_vehicle_load(&v);
+    heap_guard_exempt_end();
+    if (!cached) {
+        int r = read_pid_bitmaps(v.pids, reply, sizeof(reply), msgs);
+        if (r <= 0) return r;
+    }
+    if (v.seen != log_clock_session()) {   // cache miss, or mark as recently seen
+        heap_guard_exempt_begin();
+        obd_vehicle_save(&v);
+        heap_guard_exempt_end();
+    }
+    s_vehicle = v;
+    s_discovered = true;
+    skip_unsupported();
+    ESP_LOGI(TAG, "vehicle %s, channels not supported: 0x%lx", s_vehicle.vin[0] ? s_vehicle.vin : "(no VIN)",
+             (unsigned long)s_conn_stats.skipped);
+    return 1;
+}
+
+// A channel the ECUs keep ignoring while answering others is dropped until
+// the next connect: every request for it would cost an adapter timeout
+static void count_misses(uint32_t asked, uint32_t valid)
+{
+    if (!valid) return; // silent ECUs say nothing about single PIDs
+    for (int ch = 0; ch < OBD_CH_MAX; ch++) {
+        uint32_t bit = 1u << ch;
+        if (!(asked & bit)) continue;
+        if (valid & bit) {
+            s_fails[ch] = 0;
+        } else if (++s_fails[ch] == OBD_PID_MAX_FAILS) {
+            s_conn_stats.skipped |= bit;
+            ESP_LOGW(TAG, "PID %02X not answered %d times, no longer polled", obd_plan_active()->pid[ch],
+                     OBD_PID_MAX_FAILS);
+        }
     }
-    return -1;
 }
 
-// Polling task: connects (if needed), sends 010C every interval_ms and logs RPM
+// Exponential backoff with jitter: the delay is drawn from [b/2, b] so a
+// fleet of restarts (or a flapping adapter) does not retry in lockstep
+static uint32_t backoff_next(uint32_t *backoff_ms)
+{
+    static uint32_t seed;
+    if (seed == 0) seed = (uint32_t)esp_timer_get_time() | 1;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    uint32_t b = *backoff_ms;
+    uint32_t delay = b / 2 + seed % (b / 2 + 1);
+    *backoff_ms = b >= OBD_BACKOFF_MAX_MS / 2 ? OBD_BACKOFF_MAX_MS : b * 2;
+    return delay;
+}
+
+// Engine off for a while: ELM327 low power. The adapter sleeps until it sees
+// a character on its serial side (adapter_wake)
+static bool adapter_park(void)
+{
+    static bool s_no_lp = false;    // clones answering "?" to ATLP
+    if (s_no_lp) return false;
+    char reply[32];
+    bool ok = obd_send_cmd_and_read("ATLP", reply, sizeof(reply), OBD_PROBE_TIMEOUT_MS) > 0 &&
+              strstr(reply, "OK") != NULL;
+    s_no_lp = !ok;
+    ESP_LOGI(TAG, "%s", ok ? "adapter parked in low power" : "adapter has no low power mode");
+    return ok;
+}
+
+static bool adapter_wake(void)
+{
+    obd_write_cmd("");
+    vTaskDelay(pdMS_TO_TICKS(OBD_LP_WAKE_MS));
+    for (int i = 0; i < OBD_READY_PROBES; i++) {
+        if (adapter_alive()) return true;
+        if (!obd_bt_is_connected()) return false;
+    }
+    return false;
+}
+
+// Polling task: connects (if needed), polls each channel at the period its
+// rate class has in the current vehicle state (vehicle_state.h, scaled by
+// interval_ms / 1000) and submits what passes the storage filter to the
+// data logger. On CAN the channels due together share one multi-PID request
+// and each answering ECU's reply is routed per channel. With the engine off long enough the adapter is parked in
+// low power between slow polls.
+//
+// A cycle that decodes nothing is either a silent ECU (ignition off: the
+// adapter still answers ATRV) or a dead link. The first keeps the link and
+// polls slowly, the second reconnects with backoff. Time to first sample is
+// measured from the start of the session (boot, link loss) or, while the ECU
+// was silent, from the last silent poll, so after ignition it is the real
+// wake-up latency within OBD_ECU_SILENT_POLL_MS.
 typedef struct {
     char mac[32];
     int interval_ms;
 } polling_args_t;
 
+static polling_args_t s_poll_args;
+
 static void obd_polling_task(void *arg)
 {
     polling_args_t *pa = (polling_args_t*)arg;
@@ -266,52 +463,203 @@ static void obd_polling_task(void *arg)
     strncpy(mac, pa->mac, sizeof(mac)-1);
     mac[sizeof(mac)-1] = '\0';
     int interval = pa->interval_ms > 0 ? pa->interval_ms : 1000;
-    vPortFree(pa);
+
+    heap_guard_watch_task(NULL);
+
+    uint32_t backoff = OBD_BACKOFF_MIN_MS;
+    int64_t t_session = esp_timer_get_time();   // time-to-first-sample origin
+    bool first_pending = true;
+    int dead_probes = 0;
+    bool parked = false;
+    int64_t next_due[OBD_CH_MAX] = {0};         // log_clock_now_ms() when each channel is polled next
+    int64_t planned = 0;                        // when this task meant to wake up, for the jitter report
 
     while (1) {
         if (!obd_bt_is_connected()) {
             ESP_LOGI(TAG, "Not connected, attempting connect to %s", mac);
-            if (obd_bt_connect(mac) != 0) {
-                ESP_LOGW(TAG, "connect failed, retry in 2s");
-                vTaskDelay(pdMS_TO_TICKS(2000));
+            int64_t t_connect = esp_timer_get_time();
+            if (!connect_and_probe(mac)) {
+                s_conn_stats.connect_failures++;
+                uint32_t delay = backoff_next(&backoff);
+                ESP_LOGW(TAG, "connect failed, retry in %u ms", (unsigned)delay);
+                vTaskDelay(pdMS_TO_TICKS(delay));
+                continue;
+            }
+            backoff = OBD_BACKOFF_MIN_MS;
+            dead_probes = 0;
+            parked = false;
+            s_conn_stats.connects++;
+            s_conn_stats.last_connect_ms = (uint32_t)((esp_timer_get_time() - t_connect) / 1000);
+            ESP_LOGI(TAG, "adapter ready in %u ms", (unsigned)s_conn_stats.last_connect_ms);
+            adapter_setup();
+        }
+        if (parked) {
+            parked = false;
+            if (!adapter_wake()) {
+                ESP_LOGW(TAG, "adapter did not wake up, reconnecting");
+                s_conn_stats.link_losses++;
+                obd_bt_disconnect();
                 continue;
             }
-            // give some time for ELM to be ready
-            vTaskDelay(pdMS_TO_TICKS(500));
         }
 
+        static const char hex[] = "0123456789ABCDEF";
         char reply[512];
-        int r = obd_send_cmd_and_read("010C", reply, sizeof(reply), 3000);
-        if (r < 0) {
-            ESP_LOGW(TAG, "read error or not connected, disconnecting and retrying");
-            obd_bt_disconnect();
-            vTaskDelay(pdMS_TO_TICKS(1000));
+        char cmd[2 + 2 * OBD_MULTI_PID_MAX + 1];
+        obd_record_t rec = { .ts = log_clock_now_ms() };
+        bool link_error = false;
+        int polled = 0;
+        int64_t tick = log_clock_now_ms();
+        uint32_t asked = 0;
+        heap_guard_sample_begin();
+
+        // a reloaded manifest takes effect between two cycles
+        if (obd_plan_adopt()) skip_unsupported();
+        const obd_plan_t *plan = obd_plan_active();
+
+        if (!s_discovered && !s_conn_stats.ecu_silent) {
+            polled++;
+            radio_coex_obd_begin(planned && tick > planned ? (uint32_t)(tick - planned) : 0);
+            int d = discover_vehicle();
+            link_error = d < 0;
+            s_discovered = d > 0;
+        }
+        int max_pids = obd_proto_is_can(s_proto) ? OBD_MULTI_PID_MAX : 1;
+
+        // due channels go out in requests of up to max_pids PIDs ("010C0D11"),
+        // answered at once by every ECU that has them
+        int ch = link_error ? OBD_CH_MAX : 0;
+        while (ch < OBD_CH_MAX) {
+            // while the ECU is silent one request is enough to notice it waking up
+            if (s_conn_stats.ecu_silent && polled > 0 && !rec.valid) break;
+            uint32_t batch = 0;
+            int npids = 0;
+            for (; ch < OBD_CH_MAX; ch++) {
+                if (!(plan->active & (1u << ch))) continue;
+                uint32_t period = vehicle_state_period_ms(ch) * (uint32_t)interval / 1000;
+                if (period == 0 || tick < next_due[ch] || (s_conn_stats.skipped & (1u << ch))) continue;
+                uint8_t pid = plan->pid[ch];
+                int k = 0;  // channels sharing a PID share its slot in the request
+                while (k < npids && !(cmd[2 + 2 * k] == hex[pid >> 4] && cmd[3 + 2 * k] == hex[pid & 0xF])) k++;
+                if (k == npids) {
+                    if (npids == max_pids) break;
+                    cmd[2 + 2 * k] = hex[pid >> 4];
+                    cmd[3 + 2 * k] = hex[pid & 0xF];
+                    npids++;
+                }
+                next_due[ch] = tick + period;
+                batch |= 1u << ch;
+            }
+            if (!batch) break;
+            asked |= batch;
+            cmd[0] = '0';
+            cmd[1] = '1';
+            cmd[2 + 2 * npids] = '\0';
+
+            if (polled++ == 0) radio_coex_obd_begin(planned && tick > planned ? (uint32_t)(tick - planned) : 0);
+            int r = obd_send_cmd_and_read(cmd, reply, sizeof(reply), 3000);
+            if (r < 0) {
+                link_error = true;
+                break;
+            }
+            if (s_proto == OBD_PROTO_UNKNOWN && r > 0) detect_protocol();
+            int64_t t_decode = TRACE_BEGIN();
+            uint32_t missing = batch & ~decode_reply(reply, batch, &rec);
+            for (int m = 0; m < OBD_CH_MAX; m++) {
+                if (missing & (1u << m)) DLOG(PARSE_FAIL, plan->pid[m], r);
+            }
+            TRACE_END(DECODE, t_decode);
+        }
+        if (link_error) {
+            radio_coex_obd_end(0, 0);
+            ESP_LOGW(TAG, "link closed, reconnecting");
+            s_conn_stats.link_losses++;
+            t_session = esp_timer_get_time();
+            first_pending = true;
             continue;
         }
 
-        int rpm = parse_pid_rpm(reply);
-        if (rpm >= 0) {
-            ESP_LOGI(TAG, "RPM: %d (raw reply: %s)", rpm, reply);
-        } else {
-            ESP_LOGW(TAG, "Failed to parse RPM, reply: %s", reply);
+        count_misses(asked, rec.valid);
+
+        if (polled > 0) {
+            vehicle_state_t prev = vehicle_state_get();
+            if (vehicle_state_update(&rec) != prev) {
+                // pull in channels whose period just got shorter
+                for (int ch = 0; ch < OBD_CH_MAX; ch++) {
+                    if (!(plan->active & (1u << ch))) continue;
+                    uint32_t period = vehicle_state_period_ms(ch) * (uint32_t)interval / 1000;
+                    if (period && next_due[ch] > tick + period) next_due[ch] = tick + period;
+                }
+            }
+        }
+        if (rec.valid & (1u << OBD_CH_RPM)) {
+            DLOG(RPM_SAMPLE, rec.v[OBD_CH_RPM]);
+        }
+        obd_record_t out = rec;
+        if (out.valid && vehicle_state_filter(&out)) {
+            int64_t t_enqueue = TRACE_BEGIN();
+            data_logger_submit(&out);
+            TRACE_END(ENQUEUE, t_enqueue);
+        }
+        heap_guard_sample_end();
+
+        if (polled > 0 && rec.valid) {
+            dead_probes = 0;
+            s_conn_stats.ecu_silent = false;
+            if (first_pending) {
+                first_pending = false;
+                s_conn_stats.last_ttfs_ms = (int32_t)((esp_timer_get_time() - t_session) / 1000);
+                ESP_LOGI(TAG, "time to first sample: %d ms", (int)s_conn_stats.last_ttfs_ms);
+            }
+        } else if (polled > 0 && adapter_alive()) {
+            dead_probes = 0;
+            if (!s_conn_stats.ecu_silent) ESP_LOGI(TAG, "adapter up, ECU silent");
+            s_conn_stats.ecu_silent = true;
+            s_conn_stats.last_ttfs_ms = -1;
+            t_session = esp_timer_get_time();
+            first_pending = true;
+        } else if (polled > 0 && ++dead_probes >= OBD_DEAD_PROBES) {
+            radio_coex_obd_end(0, 0);
+            ESP_LOGW(TAG, "adapter not answering, reconnecting");
+            s_conn_stats.link_losses++;
+            obd_bt_disconnect();
+            t_session = esp_timer_get_time();
+            first_pending = true;
+            continue;
         }
 
-        vTaskDelay(pdMS_TO_TICKS(interval));
+        // engine off for long enough: let the adapter sleep between slow polls
+        if (vehicle_state_get() == VEHICLE_OFF && vehicle_state_age_ms() >= VS_LP_AFTER_MS) {
+            parked = adapter_park();
+        }
+        // skipped channels are never polled, so their next_due stays in the past
+        uint32_t polling = plan->active & ~s_conn_stats.skipped;
+        int64_t wake = INT64_MAX;
+        for (int ch = 0; ch < OBD_CH_MAX; ch++) {
+            if ((polling & (1u << ch)) && vehicle_state_period_ms(ch) && next_due[ch] < wake) wake = next_due[ch];
+        }
+        if (wake == INT64_MAX) wake = tick + interval;   // nothing left to poll: still block between cycles
+        int64_t now = log_clock_now_ms();
+        int64_t sleep_ms = wake - now;
+        if (parked && sleep_ms < VS_LP_POLL_MS) sleep_ms = VS_LP_POLL_MS;
+        if (s_conn_stats.ecu_silent && sleep_ms < OBD_ECU_SILENT_POLL_MS) sleep_ms = OBD_ECU_SILENT_POLL_MS;
+        planned = now + (sleep_ms > 0 ? sleep_ms : 0);
+        // the radio is free for Wi-Fi until then
+        if (polled > 0) radio_coex_obd_end(polled, planned);
+        if (sleep_ms > 0) vTaskDelay(pdMS_TO_TICKS(sleep_ms));
     }
 }
 
 esp_err_t obd_start_polling(const char *mac_str, int interval_ms)
 {
     if (!mac_str) return ESP_ERR_INVALID_ARG;
-    polling_args_t *pa = pvPortMalloc(sizeof(polling_args_t));
-    if (!pa) return ESP_ERR_NO_MEM;
+    polling_args_t *pa = &s_poll_args;
     strncpy(pa->mac, mac_str, sizeof(pa->mac)-1);
     pa->mac[sizeof(pa->mac)-1] = '\0';
     pa->interval_ms = interval_ms;
 
-    BaseType_t ok = xTaskCreate(obd_polling_task, "obd_poll", 4096, pa, tskIDLE_PRIORITY+4, NULL);
+    BaseType_t ok = APP_TASK_CREATE(s_poll_task, obd_polling_task, "obd_poll", pa, tskIDLE_PRIORITY+4, NULL);
     if (ok != pdPASS) {
-        vPortFree(pa);
         return ESP_FAIL;
     }
     return ESP_OK;
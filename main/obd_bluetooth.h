@@ -2,14 +2,33 @@
 #define OBD_BLUETOOTH_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <esp_err.h>
 
 #define MAC_ADDRESS_OBD  "AA:BB:CC:DD:EE:FF" // Replace with your OBD-II device MAC address
 
-// Initialize Bluetooth stack for Classic SPP
+#define OBD_CMD_MAX_LEN         32      // longest command accepted by obd_send_cmd_and_read
+#define OBD_CONNECT_TIMEOUT_MS  10000   // link open (connect + service setup) timeout
+#define OBD_BACKOFF_MIN_MS      250     // first reconnect delay, doubled per failure
+#define OBD_BACKOFF_MAX_MS      30000
+#define OBD_PROBE_TIMEOUT_MS    300     // ATRV reply timeout when checking the adapter
+#define OBD_READY_PROBES        5       // ATRV attempts after open before giving up on the link
+#define OBD_DEAD_PROBES         3       // failed ATRV checks in a row before reconnecting
+#define OBD_ECU_SILENT_POLL_MS  2000    // poll interval while the ECU does not answer
+#define OBD_LP_WAKE_MS          1000    // settle time after waking the adapter from ATLP
+#define OBD_MULTI_PID_MAX       6       // PIDs per mode 01 request on CAN (ELM327 limit)
+#define OBD_PID_MAX_FAILS       5       // unanswered polls in a row (ECU otherwise answering) before a channel is dropped
+#define OBD_VIN_TIMEOUT_MS      3000    // mode 09 VIN request, several frames
+
+// ELM327 layer on top of the OBD transport (obd_transport.h). The obd_bt_*
+// names are kept from the SPP-only version; the link is whatever OBD_TRANSPORT selects.
+
+// Initialize the selected transport (Bluetooth stack, UART driver, ...)
 esp_err_t obd_bt_init(void);
 
-// Connect to ELM327 device by MAC address string "AA:BB:CC:DD:EE:FF".
+// Open the link to the adapter (MAC address string "AA:BB:CC:DD:EE:FF" for
+// radio transports) and wait until it can carry data.
 // Returns 0 on success, negative on error.
 int obd_bt_connect(const char *mac_str);
 
@@ -17,13 +36,32 @@ int obd_bt_connect(const char *mac_str);
 // timeout_ms: total timeout to wait for response. Returns number of bytes read or -1 on error.
 int obd_send_cmd_and_read(const char *cmd, char *out, size_t out_sz, int timeout_ms);
 
+// Send command (without trailing CR) and return without waiting for the reply.
+// Returns 0 on success, -1 on error.
+int obd_write_cmd(const char *cmd);
+
 // Disconnect current connection
 void obd_bt_disconnect(void);
 
 // Returns true if connected
 bool obd_bt_is_connected(void);
 
-// Start polling task: connect to given MAC and poll specified PID every interval_ms milliseconds.
+typedef struct {
+    uint32_t connects;          // successful connects (link open and adapter answering)
+    uint32_t connect_failures;
+    uint32_t link_losses;       // sessions ended by a closed link or a dead adapter
+    uint32_t last_connect_ms;   // duration of the last successful connect
+    int32_t  last_ttfs_ms;      // time to first sample of the last session, -1 while pending
+    bool     ecu_silent;        // adapter answers but the ECU does not (ignition off)
+    uint8_t  ecus;              // ECUs seen answering since the adapter was set up
+    uint32_t skipped;           // channels not polled: PID not supported by the car, or never answered
+} obd_conn_stats_t;
+
+// Snapshot of the connection manager counters
+void obd_bt_get_conn_stats(obd_conn_stats_t *out);
+
+// Start polling task: connect to given MAC and poll the channel table. Periods
+// follow the vehicle state (vehicle_state.h); interval_ms scales them (1000 = as listed).
 esp_err_t obd_start_polling(const char *mac_str, int interval_ms);
 
 
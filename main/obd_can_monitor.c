@@ -0,0 +1,147 @@
+#include "obd_can_monitor.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "obd_bluetooth.h"
+#include "obd_transport.h"
+#include "can_frame.h"
+#include "data_logger.h"
+#include "log_clock.h"
+#include "app_alloc.h"
+
+static const char *TAG = "obd_monitor";
+
+typedef struct {
+    char mac[32];
+    int interval_ms;
+} monitor_args_t;
+
+static monitor_args_t s_monitor_args;
+static obd_monitor_stats_t s_stats;
+static obd_record_t s_latest;       // latest value per channel, valid = updated this period
+
+APP_TASK_STORAGE(s_monitor_task, 4096);
+
+// Program the hardware filter so the adapter forwards only frames we decode
+static void setup_filter(char *reply, size_t reply_sz)
+{
+    char cmd[OBD_CMD_MAX_LEN];
+    const can_signal_t *signals = can_signals();
+    uint32_t first = signals[0].id;
+    uint32_t diff = 0;
+    for (int i = 1; i < can_signal_count(); i++) diff |= signals[i].id ^ first;
+
+    if (diff == 0) {
+        snprintf(cmd, sizeof(cmd), "ATCRA%0*X", CAN_FRAME_ID_HEX_LEN, (unsigned)first);
+        obd_send_cmd_and_read(cmd, reply, reply_sz, 1000);
+        return;
+    }
+    // pass every ID that agrees with the first one on the bits all table IDs share
+    uint32_t id_mask = CAN_FRAME_ID_HEX_LEN == 3 ? 0x7FF : 0x1FFFFFFF;
+    snprintf(cmd, sizeof(cmd), "ATCF%0*X", CAN_FRAME_ID_HEX_LEN, (unsigned)(first & ~diff & id_mask));
+    obd_send_cmd_and_read(cmd, reply, reply_sz, 1000);
+    snprintf(cmd, sizeof(cmd), "ATCM%0*X", CAN_FRAME_ID_HEX_LEN, (unsigned)(~diff & id_mask));
+    obd_send_cmd_and_read(cmd, reply, reply_sz, 1000);
+}
+
+// Configure the adapter for raw monitoring; returns the command that starts it
+static const char *setup_adapter(void)
+{
+    static const char *const init_cmds[] = {
+        "ATE0",     // no echo
+        "ATL0",     // no linefeeds
+        "ATS0",     // no spaces: ~30% fewer bytes per frame
+        "ATH1",     // headers on: we need the CAN ID
+        "ATCAF0",   // raw data bytes, no ISO-TP formatting
+        "ATAL",     // allow long messages
+    };
+    char reply[64];
+    obd_send_cmd_and_read("ATWS", reply, sizeof(reply), 3000);
+    for (size_t i = 0; i < sizeof(init_cmds) / sizeof(init_cmds[0]); i++) {
+        obd_send_cmd_and_read(init_cmds[i], reply, sizeof(reply), 1000);
+    }
+    setup_filter(reply, sizeof(reply));
+
+    // STN chips answer STI and have a larger monitor buffer (STMA)
+    int r = obd_send_cmd_and_read("STI", reply, sizeof(reply), 1000);
+    bool stn = r > 0 && strstr(reply, "STN") != NULL;
+    ESP_LOGI(TAG, "adapter %s, monitoring with %s", stn ? "STN" : "ELM327", stn ? "STMA" : "ATMA");
+    return stn ? "STMA" : "ATMA";
+}
+
+static void obd_monitor_task(void *arg)
+{
+    monitor_args_t *ma = (monitor_args_t *)arg;
+    int interval = ma->interval_ms > 0 ? ma->interval_ms : 1000;
+    static can_frame_parser_t parser;
+    can_frame_init(&parser, can_signals(), can_signal_count(), &s_latest, &s_stats);
+    uint8_t buf[256];
+
+    while (1) {
+        if (!obd_bt_is_connected()) {
+            ESP_LOGI(TAG, "Not connected, attempting connect to %s", ma->mac);
+            if (obd_bt_connect(ma->mac) != 0) {
+                vTaskDelay(pdMS_TO_TICKS(2000));
+                continue;
+            }
+        }
+
+        const char *start_cmd = setup_adapter();
+        can_frame_reset(&parser);
+        obd_transport_rx_flush();
+        obd_write_cmd(start_cmd);
+
+        TickType_t last_submit = xTaskGetTickCount();
+        TickType_t last_stats = last_submit;
+        uint32_t frames_at_stats = s_stats.frames;
+
+        while (obd_bt_is_connected()) {
+            size_t n = obd_transport_rx_read(buf, sizeof(buf), pdMS_TO_TICKS(100));
+            if (n > 0 && can_frame_feed(&parser, buf, n)) {
+                s_stats.restarts++;
+                obd_write_cmd(start_cmd);
+            }
+
+            TickType_t now = xTaskGetTickCount();
+            if ((now - last_submit) >= pdMS_TO_TICKS(interval)) {
+                if (s_latest.valid) {
+                    s_latest.ts = log_clock_now_ms();
+                    data_logger_submit(&s_latest);
+                    s_latest.valid = 0;
+                }
+                last_submit = now;
+            }
+            if ((now - last_stats) >= pdMS_TO_TICKS(OBD_MONITOR_STATS_MS)) {
+                uint32_t fps = (s_stats.frames - frames_at_stats) * 1000 / OBD_MONITOR_STATS_MS;
+                ESP_LOGI(TAG, "%u frames/s, decoded %u, overruns %u, errors %u, restarts %u",
+                         (unsigned)fps, (unsigned)s_stats.decoded, (unsigned)s_stats.overruns,
+                         (unsigned)s_stats.errors, (unsigned)s_stats.restarts);
+                frames_at_stats = s_stats.frames;
+                last_stats = now;
+            }
+        }
+        ESP_LOGW(TAG, "link lost while monitoring, reconnecting");
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+esp_err_t obd_start_monitor(const char *mac_str, int interval_ms)
+{
+    if (!mac_str) return ESP_ERR_INVALID_ARG;
+    monitor_args_t *ma = &s_monitor_args;
+    strncpy(ma->mac, mac_str, sizeof(ma->mac) - 1);
+    ma->mac[sizeof(ma->mac) - 1] = '\0';
+    ma->interval_ms = interval_ms;
+
+    BaseType_t ok = APP_TASK_CREATE(s_monitor_task, obd_monitor_task, "obd_monitor", ma, tskIDLE_PRIORITY + 4, NULL);
+    return ok == pdPASS ? ESP_OK : ESP_FAIL;
+}
+
+void obd_monitor_get_stats(obd_monitor_stats_t *out)
+{
+    if (out) *out = s_stats;
+}
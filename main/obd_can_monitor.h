@@ -0,0 +1,21 @@
+#ifndef OBD_CAN_MONITOR_H
+#define OBD_CAN_MONITOR_H
+
+#include <stdint.h>
+#include <esp_err.h>
+#include "can_frame.h"
+
+#define OBD_MONITOR_STATS_MS    10000   // frame rate / overrun summary period
+
+/**
+ * Start passive CAN monitoring: connect to the adapter, program the hardware
+ * filter (ATCF/ATCM) from the IDs in can_signals.h and put it in ATMA (or
+ * STMA on STN chips). Broadcast frames are parsed incrementally from the RX
+ * stream; the latest decoded values are submitted as one record every
+ * interval_ms. Alternative to obd_start_polling().
+ */
+esp_err_t obd_start_monitor(const char *mac_str, int interval_ms);
+
+void obd_monitor_get_stats(obd_monitor_stats_t *out);
+
+#endif // OBD_CAN_MONITOR_H
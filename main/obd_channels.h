@@ -0,0 +1,68 @@
+#ifndef OBD_CHANNELS_H
+#define OBD_CHANNELS_H
+
+#include <stdint.h>
+
+/*
+ * Built-in channel table, expanded with X-macros into the enum and the
+ * default decode plan (obd_plan.h), which a manifest can replace at run time.
+ *
+ * X(id, key, pid, bytes, decimals, formula, rate, deadband, ecu)
+ *   id        enum suffix (OBD_CH_<id>)
+ *   key       JSON key written to the log
+ *   pid       mode 01 PID polled for the channel
+ *   bytes     data bytes in the reply (A, B, ...)
+ *   decimals  fixed-point decimals: stored value = real value * 10^decimals
+ *   formula   integer expression of A and B giving the stored value
+ *   rate      polling class, FAST/MEDIUM/SLOW (periods per vehicle state in vehicle_state.h)
+ *   deadband  in steady states a change smaller than this (stored units) is not logged
+ *   ecu       module the value is taken from when several answer (OBD_ECU_LIST)
+ */
+#define OBD_CHANNEL_LIST(X) \
+    X(RPM,      "rpm",      0x0C, 2, 0, ((A << 8) | B) / 4,    FAST,   50,  ENGINE) \
+    X(SPEED,    "speed",    0x0D, 1, 0, A,                     FAST,   2,   ENGINE) \
+    X(COOLANT,  "coolant",  0x05, 1, 0, A - 40,                SLOW,   1,   ENGINE) \
+    X(THROTTLE, "throttle", 0x11, 1, 1, (A * 1000) / 255,      FAST,   20,  ENGINE) \
+    X(MAF,      "maf",      0x10, 2, 2, (A << 8) | B,          MEDIUM, 100, ENGINE)
+
+/*
+ * ECUs a channel can be routed to. A functional (broadcast) request is
+ * answered by every module supporting the PID; a channel takes the value of
+ * its own ECU, or of the first one that answered if that ECU is absent.
+ *
+ * X(id, can11, addr)
+ *   can11  response CAN ID with 11-bit addressing (ISO 15765-4)
+ *   addr   source address on 29-bit CAN (18DAF1xx) and the older protocols
+ */
+#define OBD_ECU_LIST(X) \
+    X(ENGINE, 0x7E8, 0x10) \
+    X(TRANS,  0x7E9, 0x18)
+
+typedef enum {
+#define OBD_ECU_ENUM(id, can11, addr) OBD_ECU_##id,
+    OBD_ECU_LIST(OBD_ECU_ENUM)
+#undef OBD_ECU_ENUM
+    OBD_ECU_COUNT
+} obd_ecu_t;
+
+typedef enum {
+#define OBD_CH_ENUM(id, key, pid, bytes, decimals, formula, rate, deadband, ecu) OBD_CH_##id,
+    OBD_CHANNEL_LIST(OBD_CH_ENUM)
+#undef OBD_CH_ENUM
+    OBD_CH_COUNT
+} obd_channel_t;
+
+/* Channel slots: the table above, then channels added by a manifest (obd_plan.h) */
+#define OBD_CH_MAX      16
+#define OBD_CH_KEY_MAX  16      // JSON key, including the terminator
+
+_Static_assert(OBD_CH_COUNT <= OBD_CH_MAX && OBD_CH_MAX <= 32, "valid is a 32-bit mask");
+
+/* One sample of all channels; bit n of valid is set when v[n] holds a value */
+typedef struct {
+    int64_t ts;         // milliseconds since boot (log_clock_now_ms), epoch added at upload
+    uint32_t valid;
+    int32_t v[OBD_CH_MAX];
+} obd_record_t;
+
+#endif // OBD_CHANNELS_H
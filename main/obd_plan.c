@@ -0,0 +1,562 @@
+#include "obd_plan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "usb_storage.h"
+#include "vehicle_state.h"
+
+static const char *TAG = "obd_plan";
+
+/* Formula bytecode: push operands, combine the top two, OP_END returns the top */
+enum {
+    OP_END,
+    OP_A, OP_B, OP_C, OP_D,     // reply byte
+    OP_K8,                      // signed 8-bit constant follows
+    OP_K32,                     // 32-bit constant follows, little endian
+    OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_AND, OP_OR, OP_SHL, OP_SHR,
+    OP_NEG,
+};
+
+static const char *const s_rate_names[VS_RATE_COUNT] = { "FAST", "MEDIUM", "SLOW" };
+
+static const char *const s_ecu_names[OBD_ECU_COUNT] = {
+#define PLAN_ECU_NAME(id, can11, addr) #id,
+    OBD_ECU_LIST(PLAN_ECU_NAME)
+#undef PLAN_ECU_NAME
+};
+
+static obd_slot_t s_slots[OBD_CH_MAX];
+static volatile int s_slot_count = 0;
+
+// Two plans: the polling task reads the active one, a reload compiles into
+// the other and leaves it pending until the polling task adopts it
+static obd_plan_t s_plans[2];
+static obd_plan_t s_scratch;                   // a manifest is compiled here first: a bad one changes nothing
+static int s_active = 0;
+static int s_pending = -1;
+static portMUX_TYPE s_swap_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_load_mutex = NULL;  // one compile at a time (storage task, HTTP)
+static StaticSemaphore_t s_load_mutex_buf;
+static uint32_t s_text_hash = 0;               // manifest in use, 0 = built-in table
+
+static char s_text[OBD_PLAN_TEXT_MAX];         // manifest being loaded
+static bool s_file_seen = false;
+static long s_file_size = 0;
+static int64_t s_file_mtime = 0;
+
+/* ---------------- formula compiler ---------------- */
+
+typedef struct {
+    const char *p;
+    uint8_t *ops;
+    int n;
+    int depth;
+    int max_depth;
+    int max_byte;           // highest reply byte referenced, -1 if none
+    int nest;               // open ( and unary -: bounds the recursion, the compiler runs on small stacks
+    const char *err;
+} cc_t;
+
+static void cc_skip(cc_t *c)
+{
+    while (*c->p == ' ' || *c->p == '\t') c->p++;
+}
+
+static void cc_emit(cc_t *c, uint8_t op, int push)
+{
+    if (c->n >= OBD_PLAN_OPS_MAX) {
+        c->err = "formulas too long";
+        return;
+    }
+    c->ops[c->n++] = op;
+    c->depth += push;
+    if (c->depth > c->max_depth) c->max_depth = c->depth;
+}
+
+static void cc_or(cc_t *c);
+
+// Enter a ( or unary -; false (and the error set) past OBD_PLAN_NEST_MAX
+static bool cc_nest(cc_t *c)
+{
+    if (++c->nest <= OBD_PLAN_NEST_MAX) return true;
+    c->err = "formula too deeply nested";
+    return false;
+}
+
+static void cc_primary(cc_t *c)
+{
+    if (c->err) return;
+    cc_skip(c);
+    char ch = *c->p;
+    if (ch >= 'A' && ch <= 'D') {
+        c->p++;
+        if (ch - 'A' > c->max_byte) c->max_byte = ch - 'A';
+        cc_emit(c, (uint8_t)(OP_A + (ch - 'A')), 1);
+    } else if (ch >= '0' && ch <= '9') {
+        // decimal, or hex with 0x: base 0 would read "040" as octal
+        bool hex = ch == '0' && (c->p[1] == 'x' || c->p[1] == 'X');
+        char *end;
+        long long k = strtoll(c->p, &end, hex ? 16 : 10);
+        c->p = end;
+        if (k < INT32_MIN || k > INT32_MAX) {
+            c->err = "constant out of range";
+        } else if (k >= -128 && k <= 127) {
+            cc_emit(c, OP_K8, 1);
+            cc_emit(c, (uint8_t)(int8_t)k, 0);
+        } else {
+            cc_emit(c, OP_K32, 1);
+            for (int i = 0; i < 4; i++) cc_emit(c, (uint8_t)((uint32_t)k >> (8 * i)), 0);
+        }
+    } else if (ch == '(') {
+        c->p++;
+        if (!cc_nest(c)) return;
+        cc_or(c);
+        c->nest--;
+        cc_skip(c);
+        if (*c->p == ')') c->p++;
+        else if (!c->err) c->err = "missing )";
+    } else if (!c->err) {
+        c->err = "expected A-D, a number or (";
+    }
+}
+
+static void cc_unary(cc_t *c)
+{
+    if (c->err) return;
+    cc_skip(c);
+    if (*c->p == '-') {
+        c->p++;
+        if (!cc_nest(c)) return;
+        cc_unary(c);
+        c->nest--;
+        cc_emit(c, OP_NEG, 0);
+    } else {
+        cc_primary(c);
+    }
+}
+
+// One precedence level: operand (op operand)*
+static void cc_binary(cc_t *c, void (*operand)(cc_t *), const char *const *toks, const uint8_t *ops, int count)
+{
+    operand(c);
+    while (!c->err) {
+        cc_skip(c);
+        int k = 0;
+        while (k < count && strncmp(c->p, toks[k], strlen(toks[k])) != 0) k++;
+        if (k == count) return;
+        c->p += strlen(toks[k]);
+        operand(c);
+        cc_emit(c, ops[k], -1);
+    }
+}
+
+static void cc_mul(cc_t *c)
+{
+    static const char *const t[] = { "*", "/" };
+    static const uint8_t o[] = { OP_MUL, OP_DIV };
+    cc_binary(c, cc_unary, t, o, 2);
+}
+
+static void cc_add(cc_t *c)
+{
+    static const char *const t[] = { "+", "-" };
+    static const uint8_t o[] = { OP_ADD, OP_SUB };
+    cc_binary(c, cc_mul, t, o, 2);
+}
+
+static void cc_shift(cc_t *c)
+{
+    static const char *const t[] = { "<<", ">>" };
+    static const uint8_t o[] = { OP_SHL, OP_SHR };
+    cc_binary(c, cc_add, t, o, 2);
+}
+
+static void cc_and(cc_t *c)
+{
+    static const char *const t[] = { "&" };
+    static const uint8_t o[] = { OP_AND };
+    cc_binary(c, cc_shift, t, o, 1);
+}
+
+static void cc_or(cc_t *c)
+{
+    static const char *const t[] = { "|" };
+    static const uint8_t o[] = { OP_OR };
+    cc_binary(c, cc_and, t, o, 1);
+}
+
+// Compile formula for a reply of bytes bytes at plan->ops[plan->ops_len]
+static const char *compile_formula(obd_plan_t *plan, int slot, const char *formula, int bytes)
+{
+    cc_t c = { .p = formula, .ops = plan->ops, .n = plan->ops_len, .max_byte = -1 };
+    cc_or(&c);
+    cc_skip(&c);
+    if (!c.err && *c.p != '\0') c.err = "unexpected character in formula";
+    cc_emit(&c, OP_END, 0);
+    if (c.err) return c.err;
+    if (c.max_depth > OBD_PLAN_STACK) return "formula too deeply nested";
+    if (c.max_byte >= bytes) return "formula uses more bytes than the reply has";
+    plan->code[slot] = plan->ops_len;
+    plan->ops_len = (uint16_t)c.n;
+    return NULL;
+}
+
+/* ---------------- evaluation ---------------- */
+
+static int32_t run(const uint8_t *op, const uint8_t *d)
+{
+    int32_t st[OBD_PLAN_STACK];
+    int sp = 0;
+    for (;;) {
+        uint8_t o = *op++;
+        switch (o) {
+        case OP_A: case OP_B: case OP_C: case OP_D:
+            st[sp++] = d[o - OP_A];
+            break;
+        case OP_K8:
+            st[sp++] = (int8_t)*op++;
+            break;
+        case OP_K32:
+            st[sp++] = (int32_t)((uint32_t)op[0] | (uint32_t)op[1] << 8 | (uint32_t)op[2] << 16 | (uint32_t)op[3] << 24);
+            op += 4;
+            break;
+        case OP_NEG:
+            st[sp - 1] = (int32_t)(0u - (uint32_t)st[sp - 1]);
+            break;
+        case OP_END:
+            return sp ? st[0] : 0;
+        default: {
+            int32_t b = st[--sp], a = st[sp - 1], r;
+            switch (o) {
+            case OP_ADD: r = (int32_t)((uint32_t)a + (uint32_t)b); break;
+            case OP_SUB: r = (int32_t)((uint32_t)a - (uint32_t)b); break;
+            case OP_MUL: r = (int32_t)((uint32_t)a * (uint32_t)b); break;
+            case OP_DIV: r = b == 0 ? 0 : b == -1 ? (int32_t)(0u - (uint32_t)a) : a / b; break;
+            case OP_AND: r = a & b; break;
+            case OP_OR:  r = a | b; break;
+            case OP_SHL: r = (int32_t)((uint32_t)a << (b & 31)); break;
+            default:     r = a >> (b & 31); break;
+            }
+            st[sp - 1] = r;
+            break;
+        }
+        }
+    }
+}
+
+// The channel table's own formulas, compiled as C
+static int32_t decode_builtin(int ch, const uint8_t *d)
+{
+    const int32_t A = d[0], B = d[1];
+    (void)A; (void)B;
+    switch (ch) {
+#define PLAN_DECODE(id, key, pid, bytes, decimals, formula, rate, deadband, ecu) case OBD_CH_##id: return (formula);
+    OBD_CHANNEL_LIST(PLAN_DECODE)
+#undef PLAN_DECODE
+    default: return 0;
+    }
+}
+
+int32_t obd_plan_decode(const obd_plan_t *p, int slot, const uint8_t *d)
+{
+    uint16_t pc = p->code[slot];
+    return pc == OBD_PLAN_NATIVE ? decode_builtin(slot, d) : run(p->ops + pc, d);
+}
+
+/* ---------------- slots ---------------- */
+
+static int slot_find(const char *key, int decimals)
+{
+    for (int i = 0; i < s_slot_count; i++) {
+        if (s_slots[i].decimals == decimals && strcmp(s_slots[i].key, key) == 0) return i;
+    }
+    return -1;
+}
+
+// Readers only look at slots flagged in a record, so filling the entry
+// before counting it is enough
+static int slot_add(const char *key, int decimals)
+{
+    obd_slot_t *s = &s_slots[s_slot_count];
+    strncpy(s->key, key, sizeof(s->key) - 1);
+    s->frag_len = (uint8_t)snprintf(s->frag, sizeof(s->frag), ", \"%s\":", key);
+    s->decimals = (uint8_t)decimals;
+    return s_slot_count++;
+}
+
+const obd_slot_t *obd_slots(void)
+{
+    return s_slots;
+}
+
+int obd_slot_count(void)
+{
+    return s_slot_count;
+}
+
+/* ---------------- plans ---------------- */
+
+static void plan_builtin(obd_plan_t *p)
+{
+    static const struct {
+        uint8_t pid, bytes, rate, ecu;
+        int32_t deadband;
+    } table[OBD_CH_COUNT] = {
+#define PLAN_ROW(id, key, pid, bytes, decimals, formula, rate, deadband, ecu) \
+        { pid, bytes, VS_RATE_##rate, OBD_ECU_##ecu, deadband },
+        OBD_CHANNEL_LIST(PLAN_ROW)
+#undef PLAN_ROW
+    };
+    memset(p, 0, sizeof(*p));
+    for (int ch = 0; ch < OBD_CH_COUNT; ch++) {
+        p->pid[ch] = table[ch].pid;
+        p->bytes[ch] = table[ch].bytes;
+        p->rate[ch] = table[ch].rate;
+        p->ecu[ch] = table[ch].ecu;
+        p->deadband[ch] = table[ch].deadband;
+        p->code[ch] = OBD_PLAN_NATIVE;
+        p->active |= 1u << ch;
+    }
+}
+
+static int name_index(const char *name, const char *const *names, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// One manifest line into p; slots for new keys are only reserved in *added
+// (given out once the whole manifest compiled)
+static const char *compile_line(obd_plan_t *p, char *line, char added[][OBD_CH_KEY_MAX], uint8_t *added_dec,
+                                int *nadded)
+{
+    char key[OBD_CH_KEY_MAX + 1], rate[8], ecu[8];
+    unsigned pid;
+    int bytes, decimals, used = 0;
+    long deadband;
+    if (sscanf(line, "%16s %x %d %d %7s %ld %7s %n", key, &pid, &bytes, &decimals, rate, &deadband, ecu, &used) != 7 ||
+        used == 0) {
+        return "expected: key pid bytes decimals rate deadband ecu formula";
+    }
+    if (strlen(key) >= OBD_CH_KEY_MAX || strspn(key, "abcdefghijklmnopqrstuvwxyz0123456789_") != strlen(key)) {
+        return "key: lowercase letters, digits and _, up to 15";
+    }
+    if (pid == 0 || pid > 0xFF) return "pid: 01 to FF";
+    if (bytes < 1 || bytes > 4) return "bytes: 1 to 4";
+    if (decimals < 0 || decimals > 9) return "decimals: 0 to 9";
+    if (deadband < 0 || deadband > INT32_MAX) return "deadband: not negative";
+    int r = name_index(rate, s_rate_names, VS_RATE_COUNT);
+    if (r < 0) return "rate: FAST, MEDIUM or SLOW";
+    int e = name_index(ecu, s_ecu_names, OBD_ECU_COUNT);
+    if (e < 0) return "unknown ecu";
+
+    int slot = slot_find(key, decimals);
+    if (slot < 0) {
+        for (int i = 0; i < *nadded && slot < 0; i++) {
+            if (strcmp(added[i], key) == 0 && added_dec[i] == decimals) slot = s_slot_count + i;
+        }
+    }
+    if (slot < 0) {
+        if (s_slot_count + *nadded >= OBD_CH_MAX) return "no free channel slot (reboot to reuse dropped ones)";
+        slot = s_slot_count + *nadded;
+        strcpy(added[*nadded], key);
+        added_dec[*nadded] = (uint8_t)decimals;
+        (*nadded)++;
+    }
+    for (int i = 0; i < OBD_CH_MAX; i++) {
+        if (!(p->active & (1u << i))) continue;
+        const char *other = i < s_slot_count ? s_slots[i].key : added[i - s_slot_count];
+        if (strcmp(other, key) == 0) return "channel listed twice";
+    }
+
+    p->pid[slot] = (uint8_t)pid;
+    p->bytes[slot] = (uint8_t)bytes;
+    p->rate[slot] = (uint8_t)r;
+    p->ecu[slot] = (uint8_t)e;
+    p->deadband[slot] = (int32_t)deadband;
+    p->active |= 1u << slot;
+    return compile_formula(p, slot, line + used, bytes);
+}
+
+static void publish(int idx)
+{
+    portENTER_CRITICAL(&s_swap_lock);
+    s_pending = idx;
+    portEXIT_CRITICAL(&s_swap_lock);
+}
+
+// The plan that is neither in use nor about to be: safe to write
+static obd_plan_t *plan_spare(int *idx)
+{
+    portENTER_CRITICAL(&s_swap_lock);
+    s_pending = -1;     // a plan not adopted yet is replaced by this one
+    *idx = 1 - s_active;
+    portEXIT_CRITICAL(&s_swap_lock);
+    return &s_plans[*idx];
+}
+
+static uint32_t text_hash(const char *text, size_t len)
+{
+    uint32_t h = 2166136261u;   // FNV-1a
+    for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)text[i]) * 16777619u;
+    return h ? h : 1;
+}
+
+static void nvs_store(const char *text, size_t len)
+{
+    nvs_handle_t h;
+    if (nvs_open(OBD_PLAN_NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
+    esp_err_t err = len ? nvs_set_blob(h, "manifest", text, len) : nvs_erase_key(h, "manifest");
+    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) nvs_commit(h);
+    nvs_close(h);
+}
+
+static int load_locked(char *text, size_t len, bool save, char *err, size_t err_sz)
+{
+    uint32_t hash = len ? text_hash(text, len) : 0;
+    obd_plan_t *p = &s_scratch;
+    int n = 0;
+    if (hash == s_text_hash) {
+        // unchanged (in use, or waiting for the polling task): nothing to compile
+        portENTER_CRITICAL(&s_swap_lock);
+        p = &s_plans[s_pending >= 0 ? s_pending : s_active];
+        portEXIT_CRITICAL(&s_swap_lock);
+        for (uint32_t a = p->active; a; a &= a - 1) n++;
+        return n;
+    }
+
+    if (len == 0) {
+        plan_builtin(p);
+        n = OBD_CH_COUNT;
+    } else {
+        memset(p, 0, sizeof(*p));
+        char added[OBD_CH_MAX][OBD_CH_KEY_MAX];
+        uint8_t added_dec[OBD_CH_MAX];
+        int nadded = 0;
+        int lineno = 0;
+        text[len] = '\0';
+        for (char *line = text; line; ) {
+            char *next = strchr(line, '\n');
+            if (next) *next++ = '\0';
+            lineno++;
+            line[strcspn(line, "\r#")] = '\0';
+            if (line[strspn(line, " \t")] != '\0') {
+                const char *why = compile_line(p, line, added, added_dec, &nadded);
+                if (why) {
+                    snprintf(err, err_sz, "line %d: %s", lineno, why);
+                    return -1;
+                }
+                n++;
+            }
+            line = next;
+        }
+        if (n == 0) {
+            snprintf(err, err_sz, "no channels");
+            return -1;
+        }
+        for (int i = 0; i < nadded; i++) slot_add(added[i], added_dec[i]);
+    }
+    int idx;
+    memcpy(plan_spare(&idx), p, sizeof(*p));
+    publish(idx);
+    s_text_hash = hash;
+    if (save) nvs_store(text, len);
+    ESP_LOGI(TAG, "%s: %d channels, %u bytes of formulas", len ? "manifest" : "built-in table", n,
+             (unsigned)p->ops_len);
+    return n;
+}
+
+int obd_plan_load(const char *text, size_t len, char *err, size_t err_sz)
+{
+    if (!s_load_mutex || len >= sizeof(s_text)) {
+        snprintf(err, err_sz, "manifest too long");
+        return -1;
+    }
+    xSemaphoreTake(s_load_mutex, portMAX_DELAY);
+    memcpy(s_text, text, len);
+    int n = load_locked(s_text, len, true, err, err_sz);
+    xSemaphoreGive(s_load_mutex);
+    return n;
+}
+
+esp_err_t obd_plan_init(void)
+{
+    if (s_load_mutex) return ESP_OK;
+    s_load_mutex = xSemaphoreCreateMutexStatic(&s_load_mutex_buf);
+    static const struct {
+        const char *key;
+        uint8_t decimals;
+    } keys[OBD_CH_COUNT] = {
+#define PLAN_KEY(id, key, pid, bytes, decimals, formula, rate, deadband, ecu) { key, decimals },
+        OBD_CHANNEL_LIST(PLAN_KEY)
+#undef PLAN_KEY
+    };
+    for (int ch = 0; ch < OBD_CH_COUNT; ch++) slot_add(keys[ch].key, keys[ch].decimals);
+    plan_builtin(&s_plans[0]);
+    s_active = 0;
+
+    nvs_handle_t h;
+    size_t len = sizeof(s_text) - 1;
+    if (nvs_open(OBD_PLAN_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return ESP_OK;
+    esp_err_t err = nvs_get_blob(h, "manifest", s_text, &len);
+    nvs_close(h);
+    if (err != ESP_OK) return ESP_OK;   // no manifest saved: built-in table
+
+    char why[64];
+    xSemaphoreTake(s_load_mutex, portMAX_DELAY);
+    if (load_locked(s_text, len, false, why, sizeof(why)) < 0) ESP_LOGW(TAG, "saved manifest: %s", why);
+    xSemaphoreGive(s_load_mutex);
+    return ESP_OK;
+}
+
+const obd_plan_t *obd_plan_active(void)
+{
+    return &s_plans[s_active];
+}
+
+bool obd_plan_adopt(void)
+{
+    bool changed = false;
+    portENTER_CRITICAL(&s_swap_lock);
+    if (s_pending >= 0) {
+        s_active = s_pending;
+        s_pending = -1;
+        changed = true;
+    }
+    portEXIT_CRITICAL(&s_swap_lock);
+    return changed;
+}
+
+void obd_plan_check_file(void)
+{
+    long size;
+    int64_t mtime;
+    if (!usb_file_stat(OBD_PLAN_FILE, &size, &mtime)) {
+        s_file_seen = false;    // removed: keep the plan, reload if it comes back
+        return;
+    }
+    if (s_file_seen && size == s_file_size && mtime == s_file_mtime) return;
+    s_file_seen = true;
+    s_file_size = size;
+    s_file_mtime = mtime;
+    if (!s_load_mutex || size <= 0 || size >= (long)sizeof(s_text)) {
+        ESP_LOGW(TAG, "%s: empty or longer than %d bytes, ignored", OBD_PLAN_FILE, OBD_PLAN_TEXT_MAX - 1);
+        return;
+    }
+
+    FILE *f = usb_fopen(OBD_PLAN_FILE, "r");
+    if (!f) return;
+    xSemaphoreTake(s_load_mutex, portMAX_DELAY);
+    size_t len = fread(s_text, 1, sizeof(s_text) - 1, f);
+    fclose(f);
+    char why[64];
+    if (load_locked(s_text, len, true, why, sizeof(why)) < 0) ESP_LOGW(TAG, "%s %s", OBD_PLAN_FILE, why);
+    xSemaphoreGive(s_load_mutex);
+}
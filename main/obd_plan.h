@@ -0,0 +1,92 @@
+#ifndef OBD_PLAN_H
+#define OBD_PLAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "obd_channels.h"
+
+/*
+ * Channel set in use. The table in obd_channels.h is the default; a
+ * manifest (OBD_PLAN_FILE on the stick, or its copy in NVS) replaces it at
+ * run time, without reflashing or rebooting. A manifest is compiled once
+ * into a decode plan: per-channel arrays (PID, reply bytes, rate, deadband,
+ * ECU) and the formulas as a short stack bytecode, so a sample costs a few
+ * table lookups and a handful of integer ops. Channels of the built-in
+ * table keep their C formula unless the manifest gives them a new one.
+ *
+ * Manifest: one channel per line, blank lines and '#' comments ignored.
+ *
+ *   # key     pid bytes decimals rate   deadband ecu    formula
+ *   rpm       0C  2     0        FAST   50       ENGINE ((A << 8) | B) / 4
+ *   oil_temp  5C  1     0        SLOW   1        ENGINE A - 40
+ *
+ *   pid       mode 01 PID, hex
+ *   rate      FAST / MEDIUM / SLOW (vehicle_state.h)
+ *   ecu       ENGINE / TRANS (OBD_ECU_LIST)
+ *   formula   integer expression of the reply bytes A B C D: + - * / & | << >>,
+ *             parentheses, decimal or 0x constants; the rest of the line
+ *
+ * Channel slots (the index into obd_record_t.v) are given out by key and
+ * decimals and never reused during a boot: the built-in channels own slots
+ * 0 .. OBD_CH_COUNT-1, so OBD_CH_RPM and friends stay valid, and a record
+ * queued before a reload is still written with the right key. rpm and speed
+ * drive the vehicle state; a manifest without them keeps the car "off".
+ */
+#define OBD_PLAN_FILE           "obd_channels.txt"  // on the stick, relative to the mount point
+#define OBD_PLAN_NVS_NAMESPACE  "obd_plan"
+#define OBD_PLAN_TEXT_MAX       2048    // longest manifest
+#define OBD_PLAN_OPS_MAX        256     // bytecode of all formulas
+#define OBD_PLAN_STACK          8       // formula evaluation depth
+#define OBD_PLAN_NEST_MAX       16      // parentheses and unary minus inside each other (compiler recursion)
+#define OBD_PLAN_NATIVE         0xFFFF  // code[]: the built-in C formula
+
+typedef struct {
+    uint32_t active;                // slots polled in this plan
+    uint8_t pid[OBD_CH_MAX];
+    uint8_t bytes[OBD_CH_MAX];
+    uint8_t rate[OBD_CH_MAX];       // vs_rate_t
+    uint8_t ecu[OBD_CH_MAX];        // obd_ecu_t
+    int32_t deadband[OBD_CH_MAX];
+    uint16_t code[OBD_CH_MAX];      // formula offset in ops[], or OBD_PLAN_NATIVE
+    uint16_t ops_len;
+    uint8_t ops[OBD_PLAN_OPS_MAX];
+} obd_plan_t;
+
+typedef struct {
+    char key[OBD_CH_KEY_MAX];
+    char frag[OBD_CH_KEY_MAX + 5];  // ", \"key\":" as written to the log
+    uint8_t frag_len;
+    uint8_t decimals;
+} obd_slot_t;
+
+/** Built-in plan, then the manifest saved in NVS if any. NVS must be initialized. */
+esp_err_t obd_plan_init(void);
+
+/** Plan the polling task is using. */
+const obd_plan_t *obd_plan_active(void);
+
+/** Polling task, once per cycle: switch to a newly loaded plan. Returns true if it changed. */
+bool obd_plan_adopt(void);
+
+/** Decode one channel from its reply bytes (d[0..3], unused ones zero). */
+int32_t obd_plan_decode(const obd_plan_t *p, int slot, const uint8_t *d);
+
+/**
+ * Compile a manifest and hand it to the polling task; saved to NVS so it
+ * survives without the stick. An empty manifest restores the built-in table.
+ * Returns the channels in the new plan, or -1 with the reason in err.
+ */
+int obd_plan_load(const char *text, size_t len, char *err, size_t err_sz);
+
+/** Storage task: load OBD_PLAN_FILE if it appeared or changed since the last call. */
+void obd_plan_check_file(void);
+
+/** Slot table, OBD_CH_MAX entries; a slot flagged in a record is always filled in. */
+const obd_slot_t *obd_slots(void);
+
+/** Slots given out so far. */
+int obd_slot_count(void);
+
+#endif // OBD_PLAN_H
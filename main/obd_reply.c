@@ -0,0 +1,148 @@
+#include "obd_reply.h"
+
+#include <string.h>
+
+typedef struct {
+    uint16_t left;      // ISO-TP bytes still to come, 0 once complete
+    uint8_t seq;        // expected consecutive frame index
+    bool broken;        // a frame was missed: dropped at the end
+} rx_state_t;
+
+static int hex_val(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+obd_proto_t obd_proto_from_dpn(const char *reply)
+{
+    const char *p = reply;
+    while (p && (*p == ' ' || *p == '\r' || *p == '\n')) p++;
+    if (!p || !*p) return OBD_PROTO_UNKNOWN;
+    if (p[0] == 'A' && hex_val(p[1]) >= 0) p++; // "A" prefix: chosen by automatic search
+    switch (p[0]) {
+    case '1': case '2': case '3': case '4': case '5':
+        return OBD_PROTO_LEGACY;
+    case '6': case '8': case 'B': case 'C':    // B, C: user CAN, assumed 11-bit
+        return OBD_PROTO_CAN11;
+    case '7': case '9':
+        return OBD_PROTO_CAN29;
+    default:                                    // 0 (searching) or J1939
+        return OBD_PROTO_UNKNOWN;
+    }
+}
+
+// Hex digits of one line: the first id_digits go into *id, the rest are
+// data bytes. Spaces are ignored, so ATS0 and ATS1 both work. Returns the
+// data bytes, -1 for anything that is not a frame (adapter messages).
+static int line_bytes(const char *p, const char *end, int id_digits, uint32_t *id, uint8_t *out, int max)
+{
+    int digits = 0;
+    *id = 0;
+    for (; p < end; p++) {
+        if (*p == ' ') continue;
+        int v = hex_val(*p);
+        if (v < 0) return -1;
+        if (digits < id_digits) {
+            *id = (*id << 4) | (uint32_t)v;
+        } else {
+            int k = (digits - id_digits) / 2;
+            if (k >= max) return -1;
+            if ((digits - id_digits) & 1) out[k] = (uint8_t)((out[k] << 4) | v);
+            else out[k] = (uint8_t)v;
+        }
+        digits++;
+    }
+    if (digits < id_digits || ((digits - id_digits) & 1)) return -1;
+    return (digits - id_digits) / 2;
+}
+
+// One CAN frame with PCI byte (ATCAF1 shows it when headers are on)
+static int can_frame(uint32_t id, const uint8_t *b, int len, obd_msg_t *out, rx_state_t *st, int n, int max)
+{
+    switch (b[0] >> 4) {
+    case 0: {   // single frame
+        int l = b[0] & 0x0F;
+        if (l == 0 || l > len - 1 || n == max) return n;
+        out[n].id = id;
+        out[n].len = (uint16_t)l;
+        memcpy(out[n].data, b + 1, (size_t)l);
+        st[n] = (rx_state_t){ 0 };
+        return n + 1;
+    }
+    case 1: {   // first frame: 12-bit length, 6 data bytes
+        int total = ((b[0] & 0x0F) << 8) | b[1];
+        if (len != 8 || total < 8 || total > OBD_MSG_MAX || n == max) return n;
+        out[n].id = id;
+        out[n].len = 6;
+        memcpy(out[n].data, b + 2, 6);
+        st[n] = (rx_state_t){ .left = (uint16_t)(total - 6), .seq = 1 };
+        return n + 1;
+    }
+    case 2: {   // consecutive frame of the message this sender has open
+        for (int i = 0; i < n; i++) {
+            if (out[i].id != id || st[i].left == 0 || st[i].broken) continue;
+            if ((b[0] & 0x0F) != st[i].seq) {
+                st[i].broken = true;
+                return n;
+            }
+            int take = len - 1 < st[i].left ? len - 1 : st[i].left;
+            memcpy(out[i].data + out[i].len, b + 1, (size_t)take);
+            out[i].len += (uint16_t)take;
+            st[i].left -= (uint16_t)take;
+            st[i].seq = (st[i].seq + 1) & 0x0F;
+            return n;
+        }
+        return n;
+    }
+    default:    // flow control: not expected from an ECU
+        return n;
+    }
+}
+
+int obd_reply_parse(const char *reply, obd_proto_t proto, obd_msg_t *out, int max)
+{
+    static const int8_t s_id_digits[] = {
+        [OBD_PROTO_UNKNOWN] = -1,
+        [OBD_PROTO_NONE] = 0,
+        [OBD_PROTO_CAN11] = 3,
+        [OBD_PROTO_CAN29] = 8,
+        [OBD_PROTO_LEGACY] = 6,
+    };
+    if (!reply || !out || s_id_digits[proto] < 0) return 0;
+    if (max > OBD_REPLY_MAX_MSGS) max = OBD_REPLY_MAX_MSGS;
+
+    rx_state_t st[OBD_REPLY_MAX_MSGS];
+    int n = 0;
+    const char *line = reply;
+    while (*line) {
+        const char *end = line + strcspn(line, "\r\n");
+        uint32_t id;
+        uint8_t b[OBD_MSG_MAX];
+        int len = line_bytes(line, end, s_id_digits[proto], &id, b, sizeof(b));
+        line = *end ? end + 1 : end;
+        if (len <= 0) continue;
+
+        if (obd_proto_is_can(proto)) {
+            n = can_frame(id, b, len, out, st, n, max);
+        } else if (n < max) {
+            // one line per message; before CAN the last byte is the checksum
+            if (proto == OBD_PROTO_LEGACY && --len == 0) continue;
+            out[n].id = proto == OBD_PROTO_LEGACY ? (id & 0xFF) : 0;
+            out[n].len = (uint16_t)len;
+            memcpy(out[n].data, b, (size_t)len);
+            st[n] = (rx_state_t){ 0 };
+            n++;
+        }
+    }
+
+    int done = 0;
+    for (int i = 0; i < n; i++) {
+        if (st[i].left || st[i].broken) continue;
+        if (done != i) out[done] = out[i];
+        done++;
+    }
+    return done;
+}
@@ -0,0 +1,50 @@
+#ifndef OBD_REPLY_H
+#define OBD_REPLY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * ELM327 replies with headers on (ATH1): every line is one frame, prefixed
+ * with the sender's CAN ID, or with the 3 byte header on the pre-CAN
+ * protocols. A functional request can be answered by several ECUs at once,
+ * and on CAN an answer longer than 7 bytes is split into an ISO-TP first
+ * frame and consecutive frames, possibly interleaved with other ECUs' frames.
+ * obd_reply_parse() sorts the frames by sender and reassembles each message.
+ */
+
+typedef enum {
+    OBD_PROTO_UNKNOWN,  // headers on, protocol not known yet (ATSP0 still searching)
+    OBD_PROTO_NONE,     // headers off: each line is one message, sender unknown (id 0)
+    OBD_PROTO_CAN11,    // ISO 15765-4, 11-bit IDs (7E8...)
+    OBD_PROTO_CAN29,    // ISO 15765-4, 29-bit IDs (18DAF1xx)
+    OBD_PROTO_LEGACY,   // J1850 / ISO 9141 / KWP: 3 byte header, checksum at the end
+} obd_proto_t;
+
+#define OBD_MSG_MAX         64  // longest message kept (mode 01 with 6 PIDs, VIN)
+#define OBD_REPLY_MAX_MSGS  8   // messages per reply, one per answering ECU
+
+typedef struct {
+    uint32_t id;                // CAN ID, or the header's source address before CAN
+    uint16_t len;
+    uint8_t data[OBD_MSG_MAX];  // service byte first (0x41 ...)
+} obd_msg_t;
+
+/** Protocol from an ATDPN reply ("A6", "7", ...); OBD_PROTO_UNKNOWN while searching. */
+obd_proto_t obd_proto_from_dpn(const char *reply);
+
+/** True for the ISO 15765-4 (CAN) protocols, the only ones accepting several PIDs per request. */
+static inline bool obd_proto_is_can(obd_proto_t proto)
+{
+    return proto == OBD_PROTO_CAN11 || proto == OBD_PROTO_CAN29;
+}
+
+/**
+ * Split a reply (obd_send_cmd_and_read) into complete messages, in the order
+ * their first frame arrived. Adapter text (NO DATA, SEARCHING...) and
+ * messages with missing or out of order frames are dropped.
+ * Returns the number of messages written to out.
+ */
+int obd_reply_parse(const char *reply, obd_proto_t proto, obd_msg_t *out, int max);
+
+#endif // OBD_REPLY_H
@@ -0,0 +1,94 @@
+#include "obd_transport.h"
+
+#include "sdkconfig.h"
+#include "freertos/stream_buffer.h"
+#include "app_alloc.h"
+#include "dlog.h"
+
+static StreamBufferHandle_t s_rx_stream = NULL;
+static obd_transport_stats_t s_stats;
+
+APP_STREAM_STORAGE(s_rx, OBD_TRANSPORT_RX_SIZE);
+
+const obd_transport_t *obd_transport_default(void)
+{
+#if OBD_TRANSPORT == OBD_TRANSPORT_SPP
+    return &obd_transport_spp;
+#elif OBD_TRANSPORT == OBD_TRANSPORT_BLE
+    return &obd_transport_ble;
+#elif OBD_TRANSPORT == OBD_TRANSPORT_UART
+    return &obd_transport_uart;
+#else
+    return &obd_transport_loopback;
+#endif
+}
+
+esp_err_t obd_transport_rx_init(void)
+{
+    if (!s_rx_stream) {
+        s_rx_stream = APP_STREAM_CREATE(s_rx, OBD_TRANSPORT_RX_SIZE, 1);
+        if (!s_rx_stream) return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// Called from the backend's receive path (Bluetooth callback or driver task)
+void obd_transport_rx_push(const uint8_t *data, size_t len)
+{
+    if (!s_rx_stream || !data || len == 0) return;
+    // runs in the stack's context: defer logging, never format here
+    DLOG(RX_DATA, len);
+    size_t sent = xStreamBufferSend(s_rx_stream, data, len, 0);
+    s_stats.rx_packets++;
+    s_stats.rx_bytes += sent;
+    if (sent < len) {
+        s_stats.rx_dropped += len - sent;
+        DLOG(RX_OVERFLOW, len - sent);
+    }
+}
+
+size_t obd_transport_rx_read(uint8_t *buf, size_t len, TickType_t wait)
+{
+    if (!s_rx_stream) return 0;
+    return xStreamBufferReceive(s_rx_stream, buf, len, wait);
+}
+
+// Drop stale bytes (e.g. a late reply after a timeout). Reader side only.
+void obd_transport_rx_flush(void)
+{
+    if (!s_rx_stream) return;
+    uint8_t scratch[64];
+    while (xStreamBufferReceive(s_rx_stream, scratch, sizeof(scratch), 0) > 0) {
+    }
+}
+
+void obd_transport_get_stats(obd_transport_stats_t *out)
+{
+    if (out) *out = s_stats;
+}
+
+void obd_transport_count_tx(size_t len, bool ok)
+{
+    if (ok) {
+        s_stats.tx_writes++;
+        s_stats.tx_bytes += len;
+    } else {
+        s_stats.tx_errors++;
+    }
+}
+
+void obd_transport_count_cong_wait(void)
+{
+    s_stats.tx_cong_waits++;
+}
+
+void obd_transport_count_resend(void)
+{
+    s_stats.tx_resends++;
+}
+
+void obd_transport_count_open(bool opened)
+{
+    if (opened) s_stats.opens++;
+    else s_stats.closes++;
+}
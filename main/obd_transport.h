@@ -0,0 +1,87 @@
+#ifndef OBD_TRANSPORT_H
+#define OBD_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Byte-stream link to the OBD adapter. The ELM327 layer (obd_bluetooth.c)
+ * only talks to this interface; backends:
+ *   spp       Bluetooth Classic SPP (Bluedroid), original ESP32 only
+ *   ble       BLE GATT client (notify RX, write-without-response TX)
+ *   uart      wired STN/ELM chip on a UART
+ *   loopback  in-process ELM327 emulator, for the Linux host target
+ *
+ * Received bytes from every backend end up in one shared stream buffer
+ * (obd_transport_rx_push / obd_transport_rx_read), so readers never see
+ * packet boundaries and no per-packet allocation is needed.
+ */
+
+typedef struct {
+    uint32_t tx_bytes;
+    uint32_t tx_writes;
+    uint32_t tx_errors;
+    uint32_t tx_cong_waits; // writes that had to wait for the link to decongest
+    uint32_t tx_resends;    // writes re-issued after a failed completion
+    uint32_t rx_bytes;
+    uint32_t rx_packets;
+    uint32_t rx_dropped;    // bytes lost because the RX stream was full
+    uint32_t opens;
+    uint32_t closes;
+} obd_transport_stats_t;
+
+typedef struct {
+    const char *name;
+    esp_err_t (*init)(void);
+    // Connect and block until the link can carry data. addr is the adapter
+    // MAC ("AA:BB:CC:DD:EE:FF") for radio backends, ignored otherwise.
+    esp_err_t (*open)(const char *addr, int timeout_ms);
+    // Send len bytes; returns bytes accepted, 0 if the link is up but could
+    // not take them now (congested), or -1 if the link is down
+    int (*write)(const uint8_t *data, size_t len);
+    void (*close)(void);
+    bool (*is_open)(void);
+} obd_transport_t;
+
+#define OBD_TRANSPORT_SPP       1
+#define OBD_TRANSPORT_BLE       2
+#define OBD_TRANSPORT_UART      3
+#define OBD_TRANSPORT_LOOPBACK  4
+
+#ifndef OBD_TRANSPORT
+#if CONFIG_IDF_TARGET_LINUX
+#define OBD_TRANSPORT OBD_TRANSPORT_LOOPBACK
+#elif CONFIG_BT_CLASSIC_ENABLED
+#define OBD_TRANSPORT OBD_TRANSPORT_SPP
+#else
+#define OBD_TRANSPORT OBD_TRANSPORT_BLE     // ESP32-S3: BLE radio only
+#endif
+#endif
+
+#define OBD_TRANSPORT_RX_SIZE   2048        // bytes buffered between the link and the reader
+
+extern const obd_transport_t obd_transport_spp;
+extern const obd_transport_t obd_transport_ble;
+extern const obd_transport_t obd_transport_uart;
+extern const obd_transport_t obd_transport_loopback;
+
+/** Backend selected at build time with OBD_TRANSPORT. */
+const obd_transport_t *obd_transport_default(void);
+
+/* Shared RX stream, used by backends (push) and the ELM327 layer (read) */
+esp_err_t obd_transport_rx_init(void);
+void obd_transport_rx_push(const uint8_t *data, size_t len);
+size_t obd_transport_rx_read(uint8_t *buf, size_t len, TickType_t wait);
+void obd_transport_rx_flush(void);
+
+/* Statistics, updated by the backends */
+void obd_transport_get_stats(obd_transport_stats_t *out);
+void obd_transport_count_tx(size_t len, bool ok);
+void obd_transport_count_cong_wait(void);
+void obd_transport_count_resend(void);
+void obd_transport_count_open(bool opened);
+
+#endif // OBD_TRANSPORT_H
@@ -0,0 +1,327 @@
+#include "obd_transport.h"
+
+#include "sdkconfig.h"
+
+#if CONFIG_BT_BLE_ENABLED && CONFIG_BT_BLUEDROID_ENABLED
+
+#include <string.h>
+#include <stdio.h>
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gattc_api.h"
+#include "esp_gatt_defs.h"
+#include "esp_gatt_common_api.h"
+#include "freertos/event_groups.h"
+#include "heap_guard.h"
+
+/*
+ * BLE GATT client for ELM327-compatible BLE adapters. The adapter exposes a
+ * serial service with a notify characteristic (adapter -> us) and a write
+ * characteristic (us -> adapter); some clones use a single characteristic
+ * for both. Throughput settings:
+ *   - MTU negotiated up to OBD_BLE_MTU so a full reply fits one notification
+ *   - writes without response, split at MTU - 3
+ *   - connection interval requested at 7.5-15 ms right after connecting
+ */
+
+static const char *TAG = "obd_ble";
+
+#define OBD_BLE_SERVICE_UUID    0xFFF0
+#define OBD_BLE_NOTIFY_UUID     0xFFF1
+#define OBD_BLE_WRITE_UUID      0xFFF2
+#define OBD_BLE_MTU             247
+#define OBD_BLE_CONN_ITVL_MIN   6       // x 1.25 ms
+#define OBD_BLE_CONN_ITVL_MAX   12      // x 1.25 ms
+#define OBD_BLE_SUPERVISION_TO  400     // x 10 ms
+
+#define BLE_APP_ID          0
+#define BLE_REG_BIT         BIT0
+#define BLE_READY_BIT       BIT1
+#define BLE_FAIL_BIT        BIT2
+
+static EventGroupHandle_t s_ble_events = NULL;
+static StaticEventGroup_t s_ble_events_buf;
+
+static esp_gatt_if_t s_gattc_if = ESP_GATT_IF_NONE;
+static uint16_t s_conn_id = 0;
+static esp_bd_addr_t s_remote_bda;
+static bool s_connected = false;    // GATT link up
+static bool s_ready = false;        // notifications enabled, write handle known
+static uint16_t s_mtu = 23;
+static uint16_t s_svc_start = 0, s_svc_end = 0;
+static uint16_t s_notify_handle = 0, s_write_handle = 0;
+
+static bool mac_str_to_bda(const char *mac, uint8_t bda[6])
+{
+    if (!mac) return false;
+    int vals[6];
+    if (sscanf(mac, "%x:%x:%x:%x:%x:%x", &vals[0], &vals[1], &vals[2], &vals[3], &vals[4], &vals[5]) == 6) {
+        for (int i = 0; i < 6; i++) bda[i] = (uint8_t)vals[i];
+        return true;
+    }
+    return false;
+}
+
+static uint16_t find_char(uint16_t uuid16)
+{
+    esp_bt_uuid_t uuid = { .len = ESP_UUID_LEN_16, .uuid.uuid16 = uuid16 };
+    esp_gattc_char_elem_t elem;
+    uint16_t count = 1;
+    esp_gatt_status_t st = esp_ble_gattc_get_char_by_uuid(s_gattc_if, s_conn_id, s_svc_start, s_svc_end,
+                                                          uuid, &elem, &count);
+    return (st == ESP_GATT_OK && count > 0) ? elem.char_handle : 0;
+}
+
+static void enable_notifications(void)
+{
+    esp_bt_uuid_t cccd_uuid = { .len = ESP_UUID_LEN_16, .uuid.uuid16 = ESP_GATT_UUID_CHAR_CLIENT_CONFIG };
+    esp_gattc_descr_elem_t descr;
+    uint16_t count = 1;
+    esp_gatt_status_t st = esp_ble_gattc_get_descr_by_char_handle(s_gattc_if, s_conn_id, s_notify_handle,
+                                                                  cccd_uuid, &descr, &count);
+    if (st != ESP_GATT_OK || count == 0) {
+        ESP_LOGE(TAG, "CCCD not found on notify characteristic");
+        xEventGroupSetBits(s_ble_events, BLE_FAIL_BIT);
+        return;
+    }
+    uint8_t enable[2] = { 0x01, 0x00 };
+    esp_ble_gattc_write_char_descr(s_gattc_if, s_conn_id, descr.handle, sizeof(enable), enable,
+                                   ESP_GATT_WRITE_TYPE_RSP, ESP_GATT_AUTH_REQ_NONE);
+}
+
+static void gattc_cb(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param)
+{
+    switch (event) {
+    case ESP_GATTC_REG_EVT:
+        s_gattc_if = gattc_if;
+        xEventGroupSetBits(s_ble_events, BLE_REG_BIT);
+        break;
+    case ESP_GATTC_CONNECT_EVT: {
+        s_conn_id = param->connect.conn_id;
+        s_connected = true;
+        memcpy(s_remote_bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+        esp_ble_conn_update_params_t conn_params = {
+            .min_int = OBD_BLE_CONN_ITVL_MIN,
+            .max_int = OBD_BLE_CONN_ITVL_MAX,
+            .latency = 0,
+            .timeout = OBD_BLE_SUPERVISION_TO,
+        };
+        memcpy(conn_params.bda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+        esp_ble_gap_update_conn_params(&conn_params);
+        esp_ble_gattc_send_mtu_req(gattc_if, s_conn_id);
+        break;
+    }
+    case ESP_GATTC_OPEN_EVT:
+        if (param->open.status != ESP_GATT_OK) {
+            ESP_LOGW(TAG, "open failed, status %d", param->open.status);
+            xEventGroupSetBits(s_ble_events, BLE_FAIL_BIT);
+        }
+        break;
+    case ESP_GATTC_CFG_MTU_EVT:
+        if (param->cfg_mtu.status == ESP_GATT_OK) {
+            s_mtu = param->cfg_mtu.mtu;
+        }
+        ESP_LOGI(TAG, "MTU %u", s_mtu);
+        s_svc_start = s_svc_end = 0;
+        esp_ble_gattc_search_service(gattc_if, param->cfg_mtu.conn_id, NULL);
+        break;
+    case ESP_GATTC_SEARCH_RES_EVT:
+        if (param->search_res.srvc_id.uuid.len == ESP_UUID_LEN_16 &&
+            param->search_res.srvc_id.uuid.uuid.uuid16 == OBD_BLE_SERVICE_UUID) {
+            s_svc_start = param->search_res.start_handle;
+            s_svc_end = param->search_res.end_handle;
+        }
+        break;
+    case ESP_GATTC_SEARCH_CMPL_EVT:
+        if (s_svc_start == 0) {
+            ESP_LOGE(TAG, "service 0x%04X not found", OBD_BLE_SERVICE_UUID);
+            xEventGroupSetBits(s_ble_events, BLE_FAIL_BIT);
+            break;
+        }
+        s_notify_handle = find_char(OBD_BLE_NOTIFY_UUID);
+        s_write_handle = find_char(OBD_BLE_WRITE_UUID);
+        if (s_write_handle == 0) s_write_handle = s_notify_handle; // single-characteristic adapters
+        if (s_notify_handle == 0) {
+            ESP_LOGE(TAG, "notify characteristic 0x%04X not found", OBD_BLE_NOTIFY_UUID);
+            xEventGroupSetBits(s_ble_events, BLE_FAIL_BIT);
+            break;
+        }
+        esp_ble_gattc_register_for_notify(gattc_if, s_remote_bda, s_notify_handle);
+        break;
+    case ESP_GATTC_REG_FOR_NOTIFY_EVT:
+        if (param->reg_for_notify.status != ESP_GATT_OK) {
+            xEventGroupSetBits(s_ble_events, BLE_FAIL_BIT);
+            break;
+        }
+        enable_notifications();
+        break;
+    case ESP_GATTC_WRITE_DESCR_EVT:
+        if (param->write.status != ESP_GATT_OK) {
+            ESP_LOGE(TAG, "enabling notifications failed, status %d", param->write.status);
+            xEventGroupSetBits(s_ble_events, BLE_FAIL_BIT);
+            break;
+        }
+        s_ready = true;
+        obd_transport_count_open(true);
+        xEventGroupSetBits(s_ble_events, BLE_READY_BIT);
+        break;
+    case ESP_GATTC_NOTIFY_EVT:
+        if (param->notify.handle == s_notify_handle) {
+            obd_transport_rx_push(param->notify.value, param->notify.value_len);
+        }
+        break;
+    case ESP_GATTC_DISCONNECT_EVT:
+        ESP_LOGI(TAG, "disconnected, reason 0x%x", param->disconnect.reason);
+        if (s_ready) obd_transport_count_open(false);
+        s_connected = false;
+        s_ready = false;
+        s_mtu = 23;
+        xEventGroupSetBits(s_ble_events, BLE_FAIL_BIT);
+        break;
+    default:
+        ESP_LOGD(TAG, "GATTC event %d", event);
+        break;
+    }
+}
+
+static void gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    if (event == ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT) {
+        ESP_LOGI(TAG, "conn interval %u x 1.25 ms, latency %u",
+                 param->update_conn_params.conn_int, param->update_conn_params.latency);
+    }
+}
+
+static esp_err_t ble_init(void)
+{
+    esp_err_t ret;
+
+    if (!s_ble_events) {
+        s_ble_events = xEventGroupCreateStatic(&s_ble_events_buf);
+    }
+    ret = obd_transport_rx_init();
+    if (ret) return ret;
+
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    ret = esp_bt_controller_init(&bt_cfg);
+    if (ret) {
+        ESP_LOGE(TAG, "bt controller init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+    if (ret) {
+        ESP_LOGE(TAG, "bt controller enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_init();
+    if (ret) {
+        ESP_LOGE(TAG, "bluedroid init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_enable();
+    if (ret) {
+        ESP_LOGE(TAG, "bluedroid enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_ble_gap_register_callback(gap_cb);
+    if (ret) {
+        ESP_LOGE(TAG, "gap register failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_ble_gattc_register_callback(gattc_cb);
+    if (ret) {
+        ESP_LOGE(TAG, "gattc register failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_ble_gattc_app_register(BLE_APP_ID);
+    if (ret) {
+        ESP_LOGE(TAG, "gattc app register failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_ble_gatt_set_local_mtu(OBD_BLE_MTU);
+    if (ret) {
+        ESP_LOGW(TAG, "set local MTU failed: %s", esp_err_to_name(ret));
+    }
+
+    xEventGroupWaitBits(s_ble_events, BLE_REG_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(1000));
+    ESP_LOGI(TAG, "Bluetooth (BLE GATT client) initialized");
+    return ESP_OK;
+}
+
+static esp_err_t ble_open(const char *addr, int timeout_ms)
+{
+    if (s_ready) return ESP_OK;
+    if (s_gattc_if == ESP_GATT_IF_NONE) return ESP_ERR_INVALID_STATE;
+
+    esp_bd_addr_t bda;
+    if (!mac_str_to_bda(addr, bda)) {
+        ESP_LOGE(TAG, "invalid mac string");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xEventGroupClearBits(s_ble_events, BLE_READY_BIT | BLE_FAIL_BIT);
+    esp_err_t err = esp_ble_gattc_open(s_gattc_if, bda, BLE_ADDR_TYPE_PUBLIC, true);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "gattc open failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    EventBits_t bits = xEventGroupWaitBits(s_ble_events, BLE_READY_BIT | BLE_FAIL_BIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(timeout_ms));
+    if (bits & BLE_READY_BIT) return ESP_OK;
+    if (s_connected) esp_ble_gattc_close(s_gattc_if, s_conn_id);
+    return (bits & BLE_FAIL_BIT) ? ESP_FAIL : ESP_ERR_TIMEOUT;
+}
+
+static int ble_write(const uint8_t *data, size_t len)
+{
+    if (!s_ready) return -1;
+    size_t chunk_max = s_mtu - 3;
+    size_t off = 0;
+    while (off < len) {
+        size_t n = len - off < chunk_max ? len - off : chunk_max;
+        // Bluedroid deep-copies the payload on this task; that copy is not ours
+        heap_guard_exempt_begin();
+        esp_err_t err = esp_ble_gattc_write_char(s_gattc_if, s_conn_id, s_write_handle, n, (uint8_t *)data + off,
+                                                 ESP_GATT_WRITE_TYPE_NO_RSP, ESP_GATT_AUTH_REQ_NONE);
+        heap_guard_exempt_end();
+        obd_transport_count_tx(n, err == ESP_OK);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "write failed: %s", esp_err_to_name(err));
+            return -1;
+        }
+        off += n;
+    }
+    return (int)len;
+}
+
+static void ble_close(void)
+{
+    if (s_connected) {
+        esp_ble_gattc_close(s_gattc_if, s_conn_id);
+    }
+}
+
+static bool ble_is_open(void)
+{
+    return s_ready;
+}
+
+const obd_transport_t obd_transport_ble = {
+    .name = "ble",
+    .init = ble_init,
+    .open = ble_open,
+    .write = ble_write,
+    .close = ble_close,
+    .is_open = ble_is_open,
+};
+
+#endif // CONFIG_BT_BLE_ENABLED && CONFIG_BT_BLUEDROID_ENABLED
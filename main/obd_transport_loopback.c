@@ -0,0 +1,207 @@
+#include "obd_transport.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+
+/*
+ * In-process ELM327 stand-in. Commands written to the link are answered
+ * immediately through the shared RX stream, so the ELM327 layer, decoder and
+ * storage pipeline run unchanged on the Linux host target. Replies follow the
+ * adapter defaults used by the firmware (echo off, spaces on, "\r\r>" prompt).
+ * Two ECUs sit on an emulated 11-bit CAN bus (engine 7E8, gearbox 7E9), so
+ * with ATH1 a multi-PID request gets a multi-frame answer and a second sender.
+ */
+
+static const char *TAG = "obd_loopback";
+
+#define LOOPBACK_VIN    "ZFA31200000123456"
+
+static bool s_open = false;
+static char s_cmd[64];
+static size_t s_cmd_len = 0;
+static uint32_t s_tick = 0;     // advances per request, drives the synthetic signals
+static bool s_headers = false;  // ATH1
+
+static void reply(const char *text)
+{
+    obd_transport_rx_push((const uint8_t *)text, strlen(text));
+}
+
+// Data bytes of one PID as the engine ECU answers it, -1 if unsupported
+static int engine_pid(uint8_t pid, uint32_t t, uint8_t *d)
+{
+    switch (pid) {
+    case 0x00: d[0] = 0x08; d[1] = 0x19; d[2] = 0x80; d[3] = 0x00; return 4;  // supported: 05 0C 0D 10 11
+    case 0x05: d[0] = (uint8_t)(40 + 60 + (t / 8 < 30 ? t / 8 : 30)); return 1; // coolant warming up to 90 C
+    case 0x0C: {                                                               // rpm: 800..3800 sawtooth
+        uint32_t rpm4 = (800 + (t * 37) % 3000) * 4;
+        d[0] = (uint8_t)(rpm4 >> 8); d[1] = (uint8_t)(rpm4 & 0xFF);
+        return 2;
+    }
+    case 0x0D: d[0] = (uint8_t)((t * 3) % 130); return 1;                      // speed km/h
+    case 0x10: d[0] = 0x01; d[1] = (uint8_t)(t & 0xFF); return 2;              // MAF
+    case 0x11: d[0] = (uint8_t)((t * 5) % 256); return 1;                      // throttle
+    default: return -1;
+    }
+}
+
+// The gearbox answers the speed PID too (its own, rounder reading), so a
+// headers-on reply carries two senders like on a real CAN car
+static int trans_pid(uint8_t pid, uint32_t t, uint8_t *d)
+{
+    if (pid == 0x00) {
+        d[0] = 0x00; d[1] = 0x08; d[2] = 0x00; d[3] = 0x00;            // supported: 0D
+        return 4;
+    }
+    if (pid != 0x0D) return -1;
+    d[0] = (uint8_t)(((t * 3) % 130) / 10 * 10);
+    return 1;
+}
+
+static void reply_bytes(char *buf, size_t sz, const uint8_t *b, int n)
+{
+    size_t len = strlen(buf);
+    for (int i = 0; i < n && len + 4 < sz; i++) len += (size_t)snprintf(buf + len, sz - len, "%02X ", b[i]);
+    snprintf(buf + len, sz - len, "\r");
+}
+
+// One ECU's answer: with headers on, ISO-TP frames with the CAN ID in front
+// (single frame, or first frame + consecutive frames past 7 bytes); with
+// headers off the bare message on one line
+static void reply_message(uint16_t id, const uint8_t *msg, int len)
+{
+    char buf[48];
+    if (!s_headers) {
+        buf[0] = '\0';
+        reply_bytes(buf, sizeof(buf), msg, len);
+        reply(buf);
+        return;
+    }
+    if (len <= 7) {
+        snprintf(buf, sizeof(buf), "%03X %02X ", id, len);
+        reply_bytes(buf, sizeof(buf), msg, len);
+        reply(buf);
+        return;
+    }
+    snprintf(buf, sizeof(buf), "%03X 1%X %02X ", id, len >> 8, len & 0xFF);
+    reply_bytes(buf, sizeof(buf), msg, 6);
+    reply(buf);
+    uint8_t seq = 1;
+    for (int off = 6; off < len; off += 7, seq = (seq + 1) & 0x0F) {
+        snprintf(buf, sizeof(buf), "%03X 2%X ", id, seq);
+        reply_bytes(buf, sizeof(buf), msg + off, len - off < 7 ? len - off : 7);
+        reply(buf);
+    }
+}
+
+// Mode 01 with up to 6 PIDs ("010C0D11"): every ECU answers the PIDs it has
+static void answer_mode01(const char *pids)
+{
+    static int (*const ecus[])(uint8_t, uint32_t, uint8_t *) = { engine_pid, trans_pid };
+    static const uint16_t ids[] = { 0x7E8, 0x7E9 };
+    uint32_t t = s_tick++;
+    bool any = false;
+    for (size_t e = 0; e < sizeof(ecus) / sizeof(ecus[0]); e++) {
+        uint8_t msg[32] = { 0x41 };
+        int len = 1;
+        unsigned pid;
+        for (const char *p = pids; p[0] && p[1] && sscanf(p, "%2x", &pid) == 1; p += 2) {
+            uint8_t d[4];
+            int n = ecus[e]((uint8_t)pid, t, d);
+            if (n < 0 || len + 1 + n > (int)sizeof(msg)) continue;
+            msg[len++] = (uint8_t)pid;
+            memcpy(msg + len, d, (size_t)n);
+            len += n;
+        }
+        if (len == 1) continue;
+        reply_message(ids[e], msg, len);
+        any = true;
+    }
+    reply(any ? "\r>" : "NO DATA\r\r>");
+}
+
+// Mode 09 PID 02, from the engine ECU only: count byte + 17 characters
+static void answer_vin(void)
+{
+    uint8_t msg[3 + 17] = { 0x49, 0x02, 0x01 };
+    memcpy(msg + 3, LOOPBACK_VIN, 17);
+    reply_message(0x7E8, msg, sizeof(msg));
+    reply("\r>");
+}
+
+static void answer(const char *cmd)
+{
+    unsigned pid;
+    if (strcmp(cmd, "ATZ") == 0 || strcmp(cmd, "ATWS") == 0) {
+        s_headers = false;
+        reply("\r\rELM327 v1.5\r\r>");
+    } else if (strcmp(cmd, "ATRV") == 0) {
+        reply("12.6V\r\r>");
+    } else if (strcmp(cmd, "ATDPN") == 0) {
+        reply("A6\r\r>");    // auto, ISO 15765-4 CAN 11-bit 500 kbaud
+    } else if (strncmp(cmd, "AT", 2) == 0) {
+        if (strcmp(cmd, "ATH1") == 0 || strcmp(cmd, "ATH0") == 0) s_headers = cmd[3] == '1';
+        reply("OK\r\r>");
+    } else if (strncmp(cmd, "01", 2) == 0 && strlen(cmd) >= 4 && strlen(cmd) <= 14 && !(strlen(cmd) & 1) &&
+               sscanf(cmd, "01%2x", &pid) == 1) {
+        answer_mode01(cmd + 2);
+    } else if (strcmp(cmd, "0902") == 0) {
+        answer_vin();
+    } else {
+        reply("?\r\r>");
+    }
+}
+
+static esp_err_t loopback_init(void)
+{
+    return obd_transport_rx_init();
+}
+
+static esp_err_t loopback_open(const char *addr, int timeout_ms)
+{
+    (void)timeout_ms;
+    ESP_LOGI(TAG, "loopback link open (addr %s ignored)", addr ? addr : "-");
+    s_open = true;
+    s_cmd_len = 0;
+    s_headers = false;
+    obd_transport_count_open(true);
+    return ESP_OK;
+}
+
+static int loopback_write(const uint8_t *data, size_t len)
+{
+    if (!s_open) return -1;
+    for (size_t i = 0; i < len; i++) {
+        char c = (char)data[i];
+        if (c == '\r') {
+            s_cmd[s_cmd_len] = '\0';
+            answer(s_cmd);
+            s_cmd_len = 0;
+        } else if (c != ' ' && s_cmd_len < sizeof(s_cmd) - 1) {
+            s_cmd[s_cmd_len++] = (c >= 'a' && c <= 'z') ? (char)(c - 32) : c;
+        }
+    }
+    obd_transport_count_tx(len, true);
+    return (int)len;
+}
+
+static void loopback_close(void)
+{
+    if (s_open) obd_transport_count_open(false);
+    s_open = false;
+}
+
+static bool loopback_is_open(void)
+{
+    return s_open;
+}
+
+const obd_transport_t obd_transport_loopback = {
+    .name = "loopback",
+    .init = loopback_init,
+    .open = loopback_open,
+    .write = loopback_write,
+    .close = loopback_close,
+    .is_open = loopback_is_open,
+};
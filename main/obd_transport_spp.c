@@ -0,0 +1,424 @@
+#include "obd_transport.h"
+
+#include "sdkconfig.h"
+
+#if CONFIG_BT_CLASSIC_ENABLED && CONFIG_BT_SPP_ENABLED
+
+#include <string.h>
+#include <stdio.h>
+#include "esp_log.h"
+#include "esp_bt.h"
+#include "esp_bt_main.h"
+#include "esp_bt_device.h"
+#include "esp_spp_api.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "heap_guard.h"
+#include "dlog.h"
+
+static const char *TAG = "obd_spp";
+
+#define OBD_SPP_TX_SLOTS        4       // commands in flight before writers block
+#define OBD_SPP_TX_SLOT_SIZE    64
+#define OBD_SPP_TX_WAIT_MS      2000    // max wait for a credit / decongestion per write
+
+#define SPP_OPEN_BIT    BIT0
+#define SPP_CLOSE_BIT   BIT1
+#define SPP_UNCONG_BIT  BIT2
+#define SPP_DISC_BIT    BIT3
+
+#define OBD_SPP_DISCOVERY_TIMEOUT_MS  5000
+#define OBD_SPP_DEFAULT_SCN           1     // what most ELM327 clones advertise
+
+static bool s_connected = false;
+static uint32_t s_spp_handle = 0;
+static EventGroupHandle_t s_spp_events = NULL;
+static StaticEventGroup_t s_spp_events_buf;
+
+// SPP channel found by SDP for s_scn_bda; 0 = unknown, discover on next open
+static uint8_t s_scn = 0;
+static uint8_t s_scn_bda[6];
+static uint8_t s_disc_scn = 0;
+
+/*
+ * TX path. Commands are copied into preallocated slots that stay owned until
+ * ESP_SPP_WRITE_EVT confirms them; completions arrive in order, so the slots
+ * form a ring and [tail, head) is unconfirmed. Free slots are TX credits.
+ * Writers block on a credit and on SPP_UNCONG_BIT, which follows the
+ * congestion flag of ESP_SPP_CONG_EVT / ESP_SPP_WRITE_EVT.
+ *
+ * Writes issued while RFCOMM is congested complete with a failure. They are
+ * contiguous from tail, so once every issued write has completed and the
+ * link is decongested the whole unconfirmed range is re-issued in order.
+ * Congestion therefore costs latency, never a reconnect. A slot is never
+ * taken back once head has moved past it: a write Bluedroid refused (never
+ * queued, so the writes before it still complete normally) stays in the ring
+ * and goes out with the next re-issue, and slots filled while one is pending
+ * or running are appended to it, so the wire order is the ring order.
+ */
+typedef struct {
+    uint8_t data[OBD_SPP_TX_SLOT_SIZE];
+    uint16_t len;
+} spp_tx_slot_t;
+
+static spp_tx_slot_t s_tx_slots[OBD_SPP_TX_SLOTS];
+static uint32_t s_tx_head = 0;      // next slot to fill
+static uint32_t s_tx_tail = 0;      // oldest unconfirmed slot
+static uint32_t s_tx_inflight = 0;  // issued writes without a completion yet
+static bool s_tx_resend = false;    // [tail, head) must be re-issued
+static bool s_tx_broken = false;    // a write failed in flight: completions no longer match slots
+static bool s_tx_reissuing = false; // spp_tx_resend is writing the ring out
+static bool s_tx_congested = false;
+static portMUX_TYPE s_tx_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_tx_credits = NULL;
+static StaticSemaphore_t s_tx_credits_buf;
+
+static void spp_set_congested(bool cong)
+{
+    s_tx_congested = cong;
+    if (cong) xEventGroupClearBits(s_spp_events, SPP_UNCONG_BIT);
+    else xEventGroupSetBits(s_spp_events, SPP_UNCONG_BIT);
+}
+
+// Re-issue every unconfirmed slot (Bluetooth callback or writer context)
+static void spp_tx_resend(void)
+{
+    portENTER_CRITICAL(&s_tx_lock);
+    bool go = s_tx_resend && !s_tx_reissuing && s_tx_inflight == 0 && !s_tx_congested;
+    uint32_t i = s_tx_tail, to = s_tx_head;
+    if (go) {
+        s_tx_resend = false;
+        s_tx_broken = false;
+        s_tx_reissuing = true;
+        s_tx_inflight = to - i;
+    }
+    portEXIT_CRITICAL(&s_tx_lock);
+    if (!go) return;
+
+    for (;;) {
+        for (; i != to; i++) {
+            spp_tx_slot_t *slot = &s_tx_slots[i % OBD_SPP_TX_SLOTS];
+            obd_transport_count_resend();
+            if (esp_spp_write(s_spp_handle, slot->len, slot->data) != ESP_OK) {
+                // not queued: no completion will come for this one or the rest
+                portENTER_CRITICAL(&s_tx_lock);
+                s_tx_inflight -= to - i;
+                s_tx_resend = true;
+                s_tx_reissuing = false;
+                portEXIT_CRITICAL(&s_tx_lock);
+                return;
+            }
+        }
+        // slots filled meanwhile were held back for this re-issue: send them too
+        portENTER_CRITICAL(&s_tx_lock);
+        uint32_t head = s_tx_head;
+        if (head == to) s_tx_reissuing = false;
+        else s_tx_inflight += head - to;
+        portEXIT_CRITICAL(&s_tx_lock);
+        if (head == to) return;
+        to = head;
+    }
+}
+
+static void spp_on_write_done(esp_spp_status_t status, int len, bool cong)
+{
+    spp_set_congested(cong);
+
+    portENTER_CRITICAL(&s_tx_lock);
+    if (s_tx_inflight > 0) s_tx_inflight--;
+    bool confirmed = false;
+    uint16_t slot_len = 0;
+    if (s_tx_tail != s_tx_head) {
+        spp_tx_slot_t *slot = &s_tx_slots[s_tx_tail % OBD_SPP_TX_SLOTS];
+        if (status == ESP_SPP_SUCCESS && !s_tx_broken && len >= slot->len) {
+            slot_len = slot->len;
+            s_tx_tail++;
+            confirmed = true;
+        } else if (status == ESP_SPP_SUCCESS && !s_tx_broken && len > 0) {
+            // partial write: keep the remainder in the slot
+            memmove(slot->data, slot->data + len, slot->len - len);
+            slot->len -= len;
+            s_tx_resend = s_tx_broken = true;
+        } else if (status != ESP_SPP_SUCCESS) {
+            s_tx_resend = s_tx_broken = true;
+        }
+    }
+    portEXIT_CRITICAL(&s_tx_lock);
+
+    if (confirmed) {
+        obd_transport_count_tx(slot_len, true);
+        xSemaphoreGive(s_tx_credits);
+    } else if (status != ESP_SPP_SUCCESS) {
+        obd_transport_count_tx(0, false);
+    }
+    spp_tx_resend();
+}
+
+static void spp_tx_reset(void)
+{
+    portENTER_CRITICAL(&s_tx_lock);
+    s_tx_head = s_tx_tail = 0;
+    s_tx_inflight = 0;
+    s_tx_resend = false;
+    s_tx_broken = false;
+    s_tx_reissuing = false;
+    portEXIT_CRITICAL(&s_tx_lock);
+    while (uxSemaphoreGetCount(s_tx_credits) < OBD_SPP_TX_SLOTS) {
+        xSemaphoreGive(s_tx_credits);
+    }
+    spp_set_congested(false);
+}
+
+// SPP callback: handle basic events and data reception
+static void esp_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
+{
+    switch (event) {
+    case ESP_SPP_INIT_EVT:
+        ESP_LOGI(TAG, "ESP_SPP_INIT_EVT");
+        break;
+    case ESP_SPP_START_EVT:
+        ESP_LOGI(TAG, "ESP_SPP_START_EVT");
+        break;
+    case ESP_SPP_DISCOVERY_COMP_EVT:
+        s_disc_scn = (param->disc_comp.status == ESP_SPP_SUCCESS && param->disc_comp.scn_num > 0)
+                     ? param->disc_comp.scn[0] : 0;
+        xEventGroupSetBits(s_spp_events, SPP_DISC_BIT);
+        break;
+    case ESP_SPP_OPEN_EVT:
+        if (param->open.status != ESP_SPP_SUCCESS) {
+            ESP_LOGW(TAG, "ESP_SPP_OPEN_EVT status=%d", param->open.status);
+            xEventGroupSetBits(s_spp_events, SPP_CLOSE_BIT);
+            break;
+        }
+        ESP_LOGI(TAG, "ESP_SPP_OPEN_EVT handle=%u", (unsigned)param->open.handle);
+        s_spp_handle = param->open.handle;
+        spp_tx_reset();
+        s_connected = true;
+        obd_transport_count_open(true);
+        xEventGroupSetBits(s_spp_events, SPP_OPEN_BIT);
+        break;
+    case ESP_SPP_CLOSE_EVT:
+        ESP_LOGI(TAG, "ESP_SPP_CLOSE_EVT");
+        if (s_connected) obd_transport_count_open(false);   // also sent for connects that never opened
+        s_connected = false;
+        s_spp_handle = 0;
+        spp_tx_reset(); // wake writers blocked on credits or congestion
+        xEventGroupSetBits(s_spp_events, SPP_CLOSE_BIT);
+        break;
+    case ESP_SPP_DATA_IND_EVT:
+        obd_transport_rx_push(param->data_ind.data, param->data_ind.len);
+        break;
+    case ESP_SPP_CONG_EVT:
+        DLOG(SPP_CONG, param->cong.cong);
+        spp_set_congested(param->cong.cong);
+        spp_tx_resend();
+        break;
+    case ESP_SPP_WRITE_EVT:
+        spp_on_write_done(param->write.status, param->write.len, param->write.cong);
+        break;
+    default:
+        ESP_LOGD(TAG, "SPP event %d", event);
+        break;
+    }
+}
+
+static esp_err_t spp_init(void)
+{
+    esp_err_t ret;
+
+    if (!s_spp_events) {
+        s_spp_events = xEventGroupCreateStatic(&s_spp_events_buf);
+        s_tx_credits = xSemaphoreCreateCountingStatic(OBD_SPP_TX_SLOTS, OBD_SPP_TX_SLOTS, &s_tx_credits_buf);
+        xEventGroupSetBits(s_spp_events, SPP_UNCONG_BIT);
+    }
+    ret = obd_transport_rx_init();
+    if (ret) return ret;
+
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+    ret = esp_bt_controller_init(&bt_cfg);
+    if (ret) {
+        ESP_LOGE(TAG, "bt controller init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bt_controller_enable(ESP_BT_MODE_CLASSIC_BT);
+    if (ret) {
+        ESP_LOGE(TAG, "bt controller enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_init();
+    if (ret) {
+        ESP_LOGE(TAG, "bluedroid init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bluedroid_enable();
+    if (ret) {
+        ESP_LOGE(TAG, "bluedroid enable failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_spp_register_callback(esp_spp_cb);
+    if (ret) {
+        ESP_LOGE(TAG, "esp_spp_register_callback failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    esp_spp_cfg_t bt_spp_cfg = {
+        .mode = ESP_SPP_MODE_CB,
+        .enable_l2cap_ertm = true,
+        .tx_buffer_size = 0,
+    };
+    ret = esp_spp_enhanced_init(&bt_spp_cfg);
+    if (ret) {
+        ESP_LOGE(TAG, "esp_spp_init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Bluetooth (SPP) initialized");
+    return ESP_OK;
+}
+
+// Convert MAC string "AA:BB:CC:DD:EE:FF" to array of 6 bytes for esp (BD_ADDR)
+static bool mac_str_to_bda(const char *mac, uint8_t bda[6])
+{
+    if (!mac) return false;
+    int vals[6];
+    if (sscanf(mac, "%x:%x:%x:%x:%x:%x", &vals[0], &vals[1], &vals[2], &vals[3], &vals[4], &vals[5]) == 6) {
+        for (int i = 0; i < 6; i++) bda[i] = (uint8_t)vals[i];
+        return true;
+    }
+    return false;
+}
+
+// SDP lookup of the adapter's SPP channel, done once per adapter and cached:
+// it costs a baseband page of its own, so reconnects skip it
+static uint8_t spp_channel(const uint8_t bda[6], bool refresh)
+{
+    if (!refresh && s_scn != 0 && memcmp(s_scn_bda, bda, 6) == 0) return s_scn;
+
+    xEventGroupClearBits(s_spp_events, SPP_DISC_BIT);
+    s_disc_scn = 0;
+    if (esp_spp_start_discovery((uint8_t *)bda) == ESP_OK &&
+        (xEventGroupWaitBits(s_spp_events, SPP_DISC_BIT, pdFALSE, pdFALSE,
+                             pdMS_TO_TICKS(OBD_SPP_DISCOVERY_TIMEOUT_MS)) & SPP_DISC_BIT) &&
+        s_disc_scn != 0) {
+        s_scn = s_disc_scn;
+        memcpy(s_scn_bda, bda, 6);
+        ESP_LOGI(TAG, "SPP channel %u", s_scn);
+        return s_scn;
+    }
+    ESP_LOGW(TAG, "SPP discovery failed, trying channel %d", OBD_SPP_DEFAULT_SCN);
+    return OBD_SPP_DEFAULT_SCN;
+}
+
+static esp_err_t spp_open(const char *addr, int timeout_ms)
+{
+    if (s_connected) return ESP_OK;
+
+    uint8_t remote_bda[6];
+    if (!mac_str_to_bda(addr, remote_bda)) {
+        ESP_LOGE(TAG, "invalid mac string");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t scn = spp_channel(remote_bda, false);
+    xEventGroupClearBits(s_spp_events, SPP_OPEN_BIT | SPP_CLOSE_BIT);
+    esp_err_t err = esp_spp_connect(ESP_SPP_SEC_NONE, ESP_SPP_ROLE_MASTER, scn, remote_bda);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_spp_connect failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    EventBits_t bits = xEventGroupWaitBits(s_spp_events, SPP_OPEN_BIT | SPP_CLOSE_BIT, pdFALSE, pdFALSE,
+                                           pdMS_TO_TICKS(timeout_ms));
+    if (bits & SPP_OPEN_BIT) return ESP_OK;
+    if (bits & SPP_CLOSE_BIT) {
+        s_scn = 0; // refused: the channel may have moved, rediscover next time
+        return ESP_FAIL;
+    }
+    return ESP_ERR_TIMEOUT;
+}
+
+static int spp_write(const uint8_t *data, size_t len)
+{
+    if (len == 0 || len > OBD_SPP_TX_SLOT_SIZE) return -1;
+    if (!s_connected || s_spp_handle == 0) return -1;
+
+    // back-pressure: wait until RFCOMM accepts data and a slot is free
+    if (!(xEventGroupGetBits(s_spp_events) & SPP_UNCONG_BIT)) {
+        obd_transport_count_cong_wait();
+        xEventGroupWaitBits(s_spp_events, SPP_UNCONG_BIT | SPP_CLOSE_BIT, pdFALSE, pdFALSE,
+                            pdMS_TO_TICKS(OBD_SPP_TX_WAIT_MS));
+    }
+    if (xSemaphoreTake(s_tx_credits, pdMS_TO_TICKS(OBD_SPP_TX_WAIT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "no TX credit after %d ms", OBD_SPP_TX_WAIT_MS);
+        return s_connected ? 0 : -1;
+    }
+    if (!s_connected) {
+        xSemaphoreGive(s_tx_credits);
+        return -1;
+    }
+
+    spp_tx_slot_t *slot = &s_tx_slots[s_tx_head % OBD_SPP_TX_SLOTS];
+    memcpy(slot->data, data, len);
+    slot->len = (uint16_t)len;
+
+    // publishing the slot and deciding who sends it is one step: a re-issue
+    // snapshotting [tail, head) in between would leave it behind
+    portENTER_CRITICAL(&s_tx_lock);
+    bool hold = s_tx_resend || s_tx_reissuing;  // keep order behind a re-issue
+    s_tx_head++;
+    if (!hold) s_tx_inflight++;
+    portEXIT_CRITICAL(&s_tx_lock);
+    if (hold) {
+        // the slot joins [tail, head) and goes out with the re-issue
+        heap_guard_exempt_begin();
+        spp_tx_resend();
+        heap_guard_exempt_end();
+        return (int)len;
+    }
+
+    // Bluedroid deep-copies the payload on this task; that copy is not ours
+    heap_guard_exempt_begin();
+    esp_err_t err = esp_spp_write(s_spp_handle, (int)len, slot->data);
+    heap_guard_exempt_end();
+    if (err == ESP_OK) return (int)len;
+
+    // not queued, so no completion will come: the slot stays in the ring,
+    // keeps its credit and goes out with the re-issue like a held one
+    ESP_LOGW(TAG, "esp_spp_write failed: %s", esp_err_to_name(err));
+    obd_transport_count_tx(0, false);
+    portENTER_CRITICAL(&s_tx_lock);
+    s_tx_inflight--;
+    s_tx_resend = true;
+    portEXIT_CRITICAL(&s_tx_lock);
+    heap_guard_exempt_begin();
+    spp_tx_resend();
+    heap_guard_exempt_end();
+    return s_connected ? (int)len : -1;
+}
+
+static void spp_close(void)
+{
+    if (s_connected && s_spp_handle) {
+        esp_spp_disconnect(s_spp_handle);
+    }
+}
+
+static bool spp_is_open(void)
+{
+    return s_connected;
+}
+
+const obd_transport_t obd_transport_spp = {
+    .name = "spp",
+    .init = spp_init,
+    .open = spp_open,
+    .write = spp_write,
+    .close = spp_close,
+    .is_open = spp_is_open,
+};
+
+#endif // CONFIG_BT_CLASSIC_ENABLED && CONFIG_BT_SPP_ENABLED
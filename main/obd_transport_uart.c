@@ -0,0 +1,129 @@
+#include "obd_transport.h"
+
+#include "sdkconfig.h"
+
+#if !CONFIG_IDF_TARGET_LINUX
+
+#include "esp_log.h"
+#include "driver/uart.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "app_alloc.h"
+
+/*
+ * Wired STN11xx / ELM327 chip on a UART. The driver's event queue wakes the
+ * pump task as soon as bytes arrive (or on the RX timeout of a few symbol
+ * times), which moves them into the shared RX stream.
+ */
+
+static const char *TAG = "obd_uart";
+
+#define OBD_UART_NUM        UART_NUM_1
+#define OBD_UART_TX_PIN     17
+#define OBD_UART_RX_PIN     18
+#define OBD_UART_BAUD       38400       // ELM327 default; STN chips can be raised with STBR
+#define OBD_UART_RX_BUF     2048
+
+static QueueHandle_t s_uart_events = NULL;
+static bool s_installed = false;
+
+APP_TASK_STORAGE(s_uart_pump_task, 3072);
+
+static void uart_pump_task(void *arg)
+{
+    (void)arg;
+    uint8_t buf[128];
+    uart_event_t ev;
+    for (;;) {
+        if (xQueueReceive(s_uart_events, &ev, portMAX_DELAY) != pdTRUE) continue;
+        switch (ev.type) {
+        case UART_DATA: {
+            size_t avail = 0;
+            uart_get_buffered_data_len(OBD_UART_NUM, &avail);
+            while (avail > 0) {
+                int n = uart_read_bytes(OBD_UART_NUM, buf, avail < sizeof(buf) ? avail : sizeof(buf), 0);
+                if (n <= 0) break;
+                obd_transport_rx_push(buf, n);
+                avail -= n;
+            }
+            break;
+        }
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            ESP_LOGW(TAG, "UART RX overflow");
+            uart_flush_input(OBD_UART_NUM);
+            xQueueReset(s_uart_events);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static esp_err_t uart_init(void)
+{
+    if (s_installed) return ESP_OK;
+    esp_err_t ret = obd_transport_rx_init();
+    if (ret) return ret;
+
+    const uart_config_t cfg = {
+        .baud_rate = OBD_UART_BAUD,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    ret = uart_driver_install(OBD_UART_NUM, OBD_UART_RX_BUF, 0, 16, &s_uart_events, 0);
+    if (ret) {
+        ESP_LOGE(TAG, "uart driver install failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_ERROR_CHECK(uart_param_config(OBD_UART_NUM, &cfg));
+    ESP_ERROR_CHECK(uart_set_pin(OBD_UART_NUM, OBD_UART_TX_PIN, OBD_UART_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+
+    if (APP_TASK_CREATE(s_uart_pump_task, uart_pump_task, "obd_uart", NULL, tskIDLE_PRIORITY + 6, NULL) != pdPASS) {
+        return ESP_FAIL;
+    }
+    s_installed = true;
+    ESP_LOGI(TAG, "UART%d initialized at %d baud", OBD_UART_NUM, OBD_UART_BAUD);
+    return ESP_OK;
+}
+
+static esp_err_t uart_open(const char *addr, int timeout_ms)
+{
+    (void)addr;
+    (void)timeout_ms;
+    if (!s_installed) return ESP_ERR_INVALID_STATE;
+    obd_transport_count_open(true);
+    return ESP_OK;
+}
+
+static int uart_write(const uint8_t *data, size_t len)
+{
+    if (!s_installed) return -1;
+    int n = uart_write_bytes(OBD_UART_NUM, data, len);
+    obd_transport_count_tx(len, n == (int)len);
+    return n == (int)len ? n : -1;
+}
+
+static void uart_close(void)
+{
+    obd_transport_count_open(false);
+}
+
+static bool uart_is_open(void)
+{
+    return s_installed;
+}
+
+const obd_transport_t obd_transport_uart = {
+    .name = "uart",
+    .init = uart_init,
+    .open = uart_open,
+    .write = uart_write,
+    .close = uart_close,
+    .is_open = uart_is_open,
+};
+
+#endif // !CONFIG_IDF_TARGET_LINUX
@@ -0,0 +1,78 @@
+#include "obd_vehicle.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "log_clock.h"
+
+static const char *TAG = "obd_vehicle";
+
+bool obd_vehicle_has_pid(const obd_vehicle_t *v, uint8_t pid)
+{
+    if (pid == 0) return true;
+    unsigned n = (unsigned)(pid - 1);
+    return (v->pids[n / 32] >> (31 - n % 32)) & 1u;
+}
+
+// Slot holding vin, or -1; *free_slot gets the slot to use for a new car:
+// the first empty one, else the least recently seen
+static int find_slot(nvs_handle_t h, const char *vin, int *free_slot)
+{
+    uint32_t oldest = UINT32_MAX;
+    bool empty = false;
+    *free_slot = 0;
+    for (int i = 0; i < OBD_VEHICLE_SLOTS; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "car%d", i);
+        obd_vehicle_t e;
+        size_t len = sizeof(e);
+        if (nvs_get_blob(h, key, &e, &len) != ESP_OK || len != sizeof(e)) {
+            if (!empty) *free_slot = i;
+            empty = true;
+            continue;
+        }
+        if (strncmp(e.vin, vin, sizeof(e.vin)) == 0) return i;
+        if (!empty && e.seen < oldest) {
+            oldest = e.seen;
+            *free_slot = i;
+        }
+    }
+    return -1;
+}
+
+bool obd_vehicle_load(obd_vehicle_t *v)
+{
+    if (v->vin[0] == '\0') return false;
+    nvs_handle_t h;
+    if (nvs_open(OBD_VEHICLE_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return false;
+    int free_slot;
+    int i = find_slot(h, v->vin, &free_slot);
+    bool ok = false;
+    if (i >= 0) {
+        char key[8];
+        snprintf(key, sizeof(key), "car%d", i);
+        size_t len = sizeof(*v);
+        ok = nvs_get_blob(h, key, v, &len) == ESP_OK;
+    }
+    nvs_close(h);
+    if (ok) ESP_LOGI(TAG, "%s: supported PIDs from cache", v->vin);
+    return ok;
+}
+
+void obd_vehicle_save(obd_vehicle_t *v)
+{
+    if (v->vin[0] == '\0') return;
+    nvs_handle_t h;
+    if (nvs_open(OBD_VEHICLE_NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
+    int slot;
+    int i = find_slot(h, v->vin, &slot);
+    if (i >= 0) slot = i;
+    v->seen = log_clock_session();
+    char key[8];
+    snprintf(key, sizeof(key), "car%d", slot);
+    if (nvs_set_blob(h, key, v, sizeof(*v)) == ESP_OK && nvs_commit(h) == ESP_OK) {
+        ESP_LOGI(TAG, "%s: supported PIDs saved (slot %d)", v->vin, slot);
+    }
+    nvs_close(h);
+}
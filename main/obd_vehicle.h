@@ -0,0 +1,34 @@
+#ifndef OBD_VEHICLE_H
+#define OBD_VEHICLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Supported mode 01 PIDs per car. The ECUs publish them as 32-bit bitmaps
+ * (PID 00, 20, 40, ...: bit 31 = next PID, bit 0 = the next bitmap exists);
+ * the union over all answering ECUs is kept here, cached in NVS under the
+ * car's VIN (mode 09 PID 02) so a known car skips the bitmap requests.
+ * Cars without a VIN are discovered again on every connect.
+ */
+#define OBD_VEHICLE_NVS_NAMESPACE   "obd"
+#define OBD_VEHICLE_SLOTS           4       // cars remembered; the least recently seen is replaced
+#define OBD_PID_WORDS               8       // bitmaps 0100 ... 01E0
+#define OBD_VIN_LEN                 17
+
+typedef struct {
+    char vin[OBD_VIN_LEN + 1];      // "" if the car does not report one
+    uint32_t pids[OBD_PID_WORDS];   // pids[n] = reply to PID n * 0x20
+    uint32_t seen;                  // log_clock session it was last used in
+} obd_vehicle_t;
+
+/** True if some ECU of the car reported the PID (PID 00 always is). */
+bool obd_vehicle_has_pid(const obd_vehicle_t *v, uint8_t pid);
+
+/** Fill pids from the NVS entry of v->vin. Returns false if the car is not cached. */
+bool obd_vehicle_load(obd_vehicle_t *v);
+
+/** Store v under its VIN, replacing the least recently seen car if all slots are used. */
+void obd_vehicle_save(obd_vehicle_t *v);
+
+#endif // OBD_VEHICLE_H
@@ -0,0 +1,186 @@
+#include "radio_coex.h"
+
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_log.h"
+#include "log_clock.h"
+
+static const char *TAG = "coex";
+
+#define COEX_BURST_END_BIT  BIT0
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static EventGroupHandle_t s_events = NULL;     // created by the uploader, set by the polling task
+static StaticEventGroup_t s_events_buf;
+
+// OBD side
+static bool s_obd_busy = false;
+static int64_t s_burst_start = 0;
+static uint32_t s_burst_late = 0;
+static int64_t s_next_due = 0;          // 0: unknown (not polling)
+static int64_t s_last_end = 0;
+static uint32_t s_req16 = 0;            // request time without uploads, ms x16 (EWMA)
+static uint32_t s_jit_idle16 = 0;
+static uint32_t s_jit_up16 = 0;
+
+// upload side
+static bool s_uploading = false;
+static uint32_t s_rate = COEX_RATE_MIN_BPS * 4;
+static uint32_t s_tokens = 0;
+static int64_t s_bucket_ts = 0;
+static int64_t s_upload_start = 0;
+static uint32_t s_upload_bytes = 0;
+
+static radio_coex_stats_t s_stats;
+
+// 1/8 EWMA on ms x16
+static void ewma(uint32_t *v16, uint32_t sample_ms)
+{
+    int32_t d = (int32_t)(sample_ms * 16) - (int32_t)*v16;
+    *v16 = (uint32_t)((int32_t)*v16 + d / 8);
+}
+
+void radio_coex_obd_begin(uint32_t late_ms)
+{
+    int64_t now = log_clock_now_ms();
+    portENTER_CRITICAL(&s_lock);
+    s_obd_busy = true;
+    s_burst_start = now;
+    s_burst_late = late_ms;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void radio_coex_obd_end(int n, int64_t next_due_ms)
+{
+    int64_t now = log_clock_now_ms();
+    portENTER_CRITICAL(&s_lock);
+    bool was_busy = s_obd_busy;
+    s_obd_busy = false;
+    s_next_due = next_due_ms;
+    s_last_end = now;
+    if (was_busy && n > 0) {
+        uint32_t per_req = (uint32_t)(now - s_burst_start) / (uint32_t)n;
+        if (!s_uploading) {
+            if (s_req16 == 0) s_req16 = per_req * 16;
+            ewma(&s_req16, per_req);
+        }
+        uint32_t base = s_req16 / 16;
+        // the last sample of the burst is taken this much later than planned
+        uint32_t jitter = s_burst_late + (per_req > base ? (per_req - base) * (uint32_t)n : 0);
+        if (s_uploading) {
+            ewma(&s_jit_up16, jitter);
+            if (jitter > s_stats.jitter_max_ms) s_stats.jitter_max_ms = jitter > UINT16_MAX ? UINT16_MAX : (uint16_t)jitter;
+            if (jitter > COEX_JITTER_BUDGET_MS) {
+                s_rate = s_rate / 2 > COEX_RATE_MIN_BPS ? s_rate / 2 : COEX_RATE_MIN_BPS;
+                s_stats.rate_cuts++;
+            } else if (s_rate < COEX_RATE_MAX_BPS) {
+                s_rate = s_rate + COEX_RATE_STEP_BPS < COEX_RATE_MAX_BPS ? s_rate + COEX_RATE_STEP_BPS : COEX_RATE_MAX_BPS;
+            }
+        } else {
+            ewma(&s_jit_idle16, jitter);
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (s_events) xEventGroupSetBits(s_events, COEX_BURST_END_BIT);
+}
+
+void radio_coex_upload_active(bool active)
+{
+    if (!s_events) s_events = xEventGroupCreateStatic(&s_events_buf);
+    int64_t now = log_clock_now_ms();
+    portENTER_CRITICAL(&s_lock);
+    if (active && !s_uploading) {
+        s_upload_start = now;
+        s_upload_bytes = 0;
+        s_bucket_ts = now;
+        s_tokens = COEX_MIN_GRANT;
+    } else if (!active && s_uploading && now > s_upload_start) {
+        s_stats.upload_bps = (uint32_t)((int64_t)s_upload_bytes * 1000 / (now - s_upload_start));
+    }
+    s_uploading = active;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+size_t radio_coex_tx_grant(size_t want)
+{
+    if (want == 0) return 0;
+    const size_t min_grant = want < COEX_MIN_GRANT ? want : COEX_MIN_GRANT;
+    const int64_t t0 = log_clock_now_ms();
+
+    for (;;) {
+        // cleared before looking: a burst ending after this wakes the wait below
+        if (s_events) xEventGroupClearBits(s_events, COEX_BURST_END_BIT);
+        int64_t now = log_clock_now_ms();
+        bool wait_burst = false;
+        int64_t wait_ms = 0;
+
+        portENTER_CRITICAL(&s_lock);
+        uint64_t refill = (uint64_t)(now - s_bucket_ts) * s_rate / 1000;
+        s_tokens = (uint32_t)(s_tokens + refill > s_rate / 4 ? s_rate / 4 : s_tokens + refill); // bursts of 250 ms at most
+        s_bucket_ts = now;
+
+        size_t n = 0;
+        bool polling = s_next_due != 0 && now - s_last_end < COEX_STALE_MS;
+        if (!s_obd_busy) {
+            // bytes that go out at the cap before the guard ahead of the next burst
+            int64_t gap = s_next_due - now - COEX_GUARD_MS;
+            uint64_t fit = !polling ? want : gap > 0 ? (uint64_t)gap * s_rate / 1000 : 0;
+            n = want;
+            if (n > fit) n = (size_t)fit;
+            if (n > s_tokens) n = s_tokens;
+        }
+        if (n >= min_grant || now - t0 >= COEX_GRANT_WAIT_MS) {
+            if (n < min_grant) {
+                n = min_grant;
+                s_stats.forced++;
+            }
+            s_tokens = s_tokens > n ? s_tokens - (uint32_t)n : 0;
+            s_upload_bytes += (uint32_t)n;
+            s_stats.grants++;
+            s_stats.granted_bytes += (uint32_t)n;
+            if (now > t0) {
+                s_stats.gap_waits++;
+                s_stats.wait_ms += (uint32_t)(now - t0);
+            }
+            portEXIT_CRITICAL(&s_lock);
+            return n;
+        }
+        if (s_obd_busy || (polling && s_tokens >= min_grant)) {
+            wait_burst = true; // the gap is too short: go after the next burst
+        } else {
+            wait_ms = (int64_t)(min_grant - s_tokens) * 1000 / s_rate + 1;
+        }
+        portEXIT_CRITICAL(&s_lock);
+
+        int64_t left = COEX_GRANT_WAIT_MS - (now - t0);
+        if (wait_burst && s_events) {
+            xEventGroupWaitBits(s_events, COEX_BURST_END_BIT, pdTRUE, pdFALSE, pdMS_TO_TICKS(left));
+        } else {
+            if (wait_burst || wait_ms > left) wait_ms = left;
+            vTaskDelay(pdMS_TO_TICKS(wait_ms) ? pdMS_TO_TICKS(wait_ms) : 1);
+        }
+    }
+}
+
+void radio_coex_get_stats(radio_coex_stats_t *out)
+{
+    if (!out) return;
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    out->rate_bps = s_rate;
+    out->jitter_idle_ms = (uint16_t)(s_jit_idle16 / 16);
+    out->jitter_upload_ms = (uint16_t)(s_jit_up16 / 16);
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void radio_coex_log_stats(void)
+{
+    radio_coex_stats_t st;
+    radio_coex_get_stats(&st);
+    ESP_LOGI(TAG, "OBD jitter %u ms idle / %u ms uploading (max %u, budget %d); upload %" PRIu32 " B/s, cap %" PRIu32
+             " B/s, %" PRIu32 " cuts, %" PRIu32 " grants, %" PRIu32 " waited %" PRIu32 " ms, %" PRIu32 " forced",
+             st.jitter_idle_ms, st.jitter_upload_ms, st.jitter_max_ms, COEX_JITTER_BUDGET_MS, st.upload_bps,
+             st.rate_bps, st.rate_cuts, st.grants, st.gap_waits, st.wait_ms, st.forced);
+}
@@ -0,0 +1,62 @@
+#ifndef RADIO_COEX_H
+#define RADIO_COEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Airtime sharing between the OBD link (Bluetooth) and the uploader (Wi-Fi),
+ * which use the same 2.4 GHz radio. The polling task brackets every request
+ * burst and says when the next one is due; the uploader asks for a grant
+ * before each HTTP chunk and only gets bytes that fit in the gap before the
+ * next burst, at a rate capped by a token bucket.
+ *
+ * The cap follows the sampling jitter actually seen by the polling task
+ * (lateness of the burst plus request time above the no-upload baseline):
+ * over COEX_JITTER_BUDGET_MS it is halved, under it grows by a step (AIMD).
+ */
+#define COEX_JITTER_BUDGET_MS   20      // sampling jitter tolerated while uploading
+#define COEX_GUARD_MS           10      // kept free before the next OBD burst
+#define COEX_RATE_MIN_BPS       4096    // upload cap never goes below this
+#define COEX_RATE_MAX_BPS       131072
+#define COEX_RATE_STEP_BPS      4096    // additive increase per burst under budget
+#define COEX_MIN_GRANT          256     // smaller gaps are not worth a chunk
+#define COEX_GRANT_WAIT_MS      2000    // a chunk never waits longer than this for a gap
+#define COEX_STALE_MS           3000    // no burst for this long: OBD is not polling
+
+typedef struct {
+    uint32_t grants;
+    uint32_t granted_bytes;
+    uint32_t gap_waits;         // grants that had to wait for a burst to end or a gap to open
+    uint32_t forced;            // grants given after COEX_GRANT_WAIT_MS without a gap
+    uint32_t wait_ms;           // total time chunks waited
+    uint32_t rate_bps;          // current upload cap
+    uint32_t rate_cuts;
+    uint16_t jitter_idle_ms;    // sampling jitter (EWMA) with no upload running
+    uint16_t jitter_upload_ms;  // same while uploading
+    uint16_t jitter_max_ms;     // worst burst while uploading
+    uint32_t upload_bps;        // achieved by the last finished upload
+} radio_coex_stats_t;
+
+/** Polling task: a request burst starts now, late_ms after it was due. */
+void radio_coex_obd_begin(uint32_t late_ms);
+
+/** Polling task: the burst of n requests is over, the next one is due at next_due_ms (log_clock_now_ms). */
+void radio_coex_obd_end(int n, int64_t next_due_ms);
+
+/** Uploader: mark the start/end of an upload pass (jitter is attributed accordingly). */
+void radio_coex_upload_active(bool active);
+
+/**
+ * Uploader: block until some of want bytes may go on air and return how many
+ * (at least min(want, COEX_MIN_GRANT)).
+ */
+size_t radio_coex_tx_grant(size_t want);
+
+void radio_coex_get_stats(radio_coex_stats_t *out);
+
+/** Log the jitter with and without uploads, the cap and the achieved rate. */
+void radio_coex_log_stats(void);
+
+#endif // RADIO_COEX_H
@@ -0,0 +1,104 @@
+#include "record_json.h"
+
+#include <string.h>
+#include "obd_plan.h"
+
+static const uint32_t s_pow10[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static const char s_digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// Write v right-aligned in exactly width digits ending at end (zero padded)
+static void put_u32_fixed(char *end, uint32_t v, int width)
+{
+    while (width >= 2) {
+        const char *d = &s_digit_pairs[(v % 100) * 2];
+        v /= 100;
+        *--end = d[1];
+        *--end = d[0];
+        width -= 2;
+    }
+    if (width) *--end = (char)('0' + v % 10);
+}
+
+static int u32_digits(uint32_t v)
+{
+    int n = 1;
+    while (n < 10 && v >= s_pow10[n]) n++;
+    return n;
+}
+
+static char *put_u32(char *p, uint32_t v)
+{
+    int n = u32_digits(v);
+    put_u32_fixed(p + n, v, n);
+    return p + n;
+}
+
+static char *put_i64(char *p, int64_t v)
+{
+    uint64_t u = (uint64_t)v;
+    if (v < 0) {
+        *p++ = '-';
+        u = 0 - u;
+    }
+    if (u <= UINT32_MAX) return put_u32(p, (uint32_t)u);
+    // one 64-bit division, then 32-bit conversions
+    uint64_t hi = u / 100000000u;
+    uint32_t lo = (uint32_t)(u % 100000000u);
+    if (hi > UINT32_MAX) {
+        p = put_u32(p, (uint32_t)(hi / 100000000u));
+        put_u32_fixed(p + 8, (uint32_t)(hi % 100000000u), 8);
+        p += 8;
+    } else {
+        p = put_u32(p, (uint32_t)hi);
+    }
+    put_u32_fixed(p + 8, lo, 8);
+    return p + 8;
+}
+
+static char *put_fixed(char *p, int32_t v, int decimals)
+{
+    uint32_t u = (uint32_t)v;
+    if (v < 0) {
+        *p++ = '-';
+        u = 0 - u;
+    }
+    if (decimals == 0) return put_u32(p, u);
+    uint32_t scale = s_pow10[decimals];
+    p = put_u32(p, u / scale);
+    *p++ = '.';
+    put_u32_fixed(p + decimals, u % scale, decimals);
+    return p + decimals;
+}
+
+size_t obd_record_to_json(const obd_record_t *rec, char *buf, size_t buf_sz)
+{
+    if (!rec || !buf || buf_sz < OBD_RECORD_JSON_MAX) return 0;
+
+    char *p = buf;
+    memcpy(p, "{\"ts\":", 6);
+    p = put_i64(p + 6, rec->ts);
+
+    // key fragments precomputed when the slot was given out
+    const obd_slot_t *keys = obd_slots();
+    uint32_t valid = rec->valid;
+    for (int i = 0; i < OBD_CH_MAX && valid; i++, valid >>= 1) {
+        if (!(valid & 1)) continue;
+        memcpy(p, keys[i].frag, keys[i].frag_len);
+        p = put_fixed(p + keys[i].frag_len, rec->v[i], keys[i].decimals);
+    }
+    *p++ = '}';
+    return (size_t)(p - buf);
+}
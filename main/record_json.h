@@ -0,0 +1,19 @@
+#ifndef RECORD_JSON_H
+#define RECORD_JSON_H
+
+#include <stddef.h>
+#include "obd_channels.h"
+
+/* Upper bound of a serialized record: prefix, 20-digit ts, per slot the longest key fragment + 12 chars, "}" */
+#define OBD_RECORD_JSON_MAX ((sizeof("{\"ts\":") - 1) + 20 + OBD_CH_MAX * (OBD_CH_KEY_MAX + 4 + 12) + 2)
+
+/**
+ * Serialize a record as one JSON line, e.g. {"ts":1700000, "rpm":2500, "speed":85}.
+ * Only channels flagged in rec->valid are written, in slot order (obd_plan.h). Values are
+ * converted from fixed point with integer arithmetic only (no snprintf, no float).
+ * Returns the number of bytes written (not NUL-terminated), 0 if buf is smaller
+ * than OBD_RECORD_JSON_MAX.
+ */
+size_t obd_record_to_json(const obd_record_t *rec, char *buf, size_t buf_sz);
+
+#endif // RECORD_JSON_H
@@ -0,0 +1,109 @@
+#include "trace.h"
+
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+/*
+ * Timestamps come from the esp_timer (systimer) counter rather than CCOUNT:
+ * CCOUNT is per core, not synchronized between cores and wraps every ~18 s
+ * at 240 MHz, while our tasks are unpinned and a span may start on one core
+ * and end on the other. The systimer read is shared, 64-bit and sub-us cheap.
+ */
+
+typedef struct {
+    int64_t start_us;
+    uint32_t dur_us;
+    uint8_t id;
+    TaskHandle_t task;
+} trace_event_t;
+
+typedef struct {
+    trace_event_t ev[TRACE_RING_LEN];
+    uint32_t head;      // total events written, ring keeps the last TRACE_RING_LEN
+    uint32_t dumped;    // head at the last dump
+    portMUX_TYPE lock;
+} trace_ring_t;
+
+static trace_ring_t s_rings[portNUM_PROCESSORS] = {
+    [0 ... portNUM_PROCESSORS - 1] = { .lock = portMUX_INITIALIZER_UNLOCKED },
+};
+
+static const char *const s_names[TRACE_SPAN_COUNT] = {
+#define TRACE_NAME(id, name) name,
+    TRACE_SPAN_LIST(TRACE_NAME)
+#undef TRACE_NAME
+};
+
+int64_t trace_now(void)
+{
+    return esp_timer_get_time();
+}
+
+void trace_span(trace_span_t id, int64_t t0)
+{
+    int64_t now = esp_timer_get_time();
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    trace_ring_t *r = &s_rings[xPortGetCoreID()];
+
+    portENTER_CRITICAL_SAFE(&r->lock);
+    trace_event_t *e = &r->ev[r->head & (TRACE_RING_LEN - 1)];
+    e->start_us = t0;
+    e->dur_us = (uint32_t)(now - t0);
+    e->id = (uint8_t)id;
+    e->task = task;
+    r->head++;
+    portEXIT_CRITICAL_SAFE(&r->lock);
+}
+
+#define TRACE_MAX_NAMED_TASKS 16
+
+int trace_dump(FILE *out)
+{
+    if (!out) return -1;
+    int count = 0;
+    struct { TaskHandle_t task; int core; } named[TRACE_MAX_NAMED_TASKS];
+    int n_named = 0;
+
+    fputs("{\"traceEvents\":[\n", out);
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        trace_ring_t *r = &s_rings[core];
+
+        portENTER_CRITICAL(&r->lock);
+        uint32_t head = r->head;
+        uint32_t from = r->dumped;
+        r->dumped = head;
+        portEXIT_CRITICAL(&r->lock);
+        if (head - from > TRACE_RING_LEN) from = head - TRACE_RING_LEN;
+
+        for (uint32_t i = from; i != head; i++) {
+            // copy under the lock: the writer may lap us while we print
+            portENTER_CRITICAL(&r->lock);
+            bool overwritten = r->head - i > TRACE_RING_LEN;
+            trace_event_t e = r->ev[i & (TRACE_RING_LEN - 1)];
+            portEXIT_CRITICAL(&r->lock);
+            if (overwritten || e.id >= TRACE_SPAN_COUNT) continue;
+            // pid = core, tid = task: Perfetto shows one track per task per core
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%u,\"pid\":%d,\"tid\":%u}",
+                    count ? ",\n" : "", s_names[e.id], (long long)e.start_us, (unsigned)e.dur_us,
+                    core, (unsigned)(uintptr_t)e.task);
+            count++;
+
+            int k = 0;
+            while (k < n_named && (named[k].task != e.task || named[k].core != core)) k++;
+            if (k == n_named && n_named < TRACE_MAX_NAMED_TASKS) {
+                named[n_named].task = e.task;
+                named[n_named].core = core;
+                n_named++;
+            }
+        }
+    }
+    // thread name metadata (application tasks are never deleted)
+    for (int k = 0; k < n_named; k++) {
+        fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                named[k].core, (unsigned)(uintptr_t)named[k].task, pcTaskGetName(named[k].task));
+    }
+    fputs("\n]}\n", out);
+    return count;
+}
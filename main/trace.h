@@ -0,0 +1,61 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Timeline tracing of pipeline stages. A span is opened with TRACE_BEGIN()
+ * and closed with TRACE_END(id, t0); each closed span becomes one complete
+ * event in the ring of the core that closed it. trace_dump() writes the rings
+ * in Chrome trace JSON, which loads directly in Perfetto / chrome://tracing.
+ *
+ * X(id, name)
+ */
+#define TRACE_SPAN_LIST(X) \
+    X(LINK_WRITE,   "link_write") \
+    X(WAIT_FIRST,   "wait_first_byte") \
+    X(WAIT_PROMPT,  "wait_prompt") \
+    X(DECODE,       "decode") \
+    X(ENQUEUE,      "enqueue") \
+    X(SERIALIZE,    "serialize") \
+    X(USB_WRITE,    "usb_write") \
+    X(USB_FSYNC,    "usb_fsync") \
+    X(HTTP_CHUNK,   "http_chunk")
+
+typedef enum {
+#define TRACE_ENUM(id, name) TRACE_##id,
+    TRACE_SPAN_LIST(TRACE_ENUM)
+#undef TRACE_ENUM
+    TRACE_SPAN_COUNT
+} trace_span_t;
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+#define TRACE_RING_LEN          512     // events per core, power of two
+#define TRACE_DUMP_PERIOD_MS    60000   // data logger dumps the rings to the stick this often
+#define TRACE_DUMP_DIR          "trace" // on the stick: sNNNNN-MMMMM.json, session and dump number
+#define TRACE_DUMP_KEEP         64      // newest dumps kept, older ones are deleted
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN()           trace_now()
+#define TRACE_END(id, t0)       trace_span(TRACE_##id, (t0))
+#else
+#define TRACE_BEGIN()           ((int64_t)0)
+#define TRACE_END(id, t0)       ((void)(t0))
+#endif
+
+int64_t trace_now(void);
+
+/** Record a span that started at t0 (from TRACE_BEGIN) and ends now. */
+void trace_span(trace_span_t id, int64_t t0);
+
+/**
+ * Write all buffered events as Chrome trace JSON ({"traceEvents":[...]})
+ * and empty the rings. Returns the number of events written.
+ */
+int trace_dump(FILE *out);
+
+#endif // TRACE_H
@@ -8,19 +8,66 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <dirent.h>
 
+#include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "esp_log.h"
 #include "esp_err.h"
 #include "usb_storage.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "freertos/queue.h"
+#include "esp_intr_alloc.h"
 #include "usb/usb_host.h"
+#include "msc_host.h"
+#include "msc_host_vfs.h"
+#include "esp_idf_version.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+#include "esp_vfs_fat.h"
+#define SEG_CONTIGUOUS  1   // esp_vfs_fat_create_contiguous_file (f_expand) is available
+#endif
+#endif
+#include "app_alloc.h"
+#include "trace.h"
 
 static const char *TAG = "usb_storage";
 
 static char s_mount_point[128] = {0};
+static volatile uint32_t s_generation = 0;
+static bool s_prealloc_off = false;    // ftruncate refused to grow a file on this stick
 static SemaphoreHandle_t s_usb_mutex = NULL;
 
+APP_MUTEX_STORAGE(s_usb_mutex_buf);
+
+/* Directories already created on the stick, so mkdir_p is not repeated per write */
+static char s_dir_cache[USB_DIR_CACHE_SLOTS][256];
+static int s_dir_cache_next = 0;
+
+/* Current log segment. Logical end-of-data is block_off + stage_len. */
+typedef struct {
+    int fd;
+    int end_fd;         // seg-NNNNN.end: logical end as of the last flush
+    unsigned index;
+    char dir[192];
+    off_t block_off;    // aligned file offset of the staging block
+    off_t alloc_end;    // preallocated size of the file
+    size_t stage_len;   // valid bytes in the staging block
+    off_t next_index;   // logical offset from which the next record gets an index entry
+} usb_log_seg_t;
+
+static usb_log_seg_t s_seg = { .fd = -1, .end_fd = -1 };
+static uint8_t s_stage[USB_SEG_BLOCK_SIZE] __attribute__((aligned(4)));
+
+/* Index entries of the current segment not yet appended to its .idx file */
+typedef struct {
+    int64_t ts;
+    off_t off;
+} usb_index_entry_t;
+
+static usb_index_entry_t s_idx_pending[USB_INDEX_PENDING];
+static int s_idx_n = 0;
+
 static int mkdir_p(const char *path)
 {
     char tmp[256];
@@ -47,20 +94,50 @@ static int mkdir_p(const char *path)
     return 0;
 }
 
+// Ensure the parent directory of full_path exists. Must be called with s_usb_mutex held.
+static void ensure_parent_dir(const char *full_path)
+{
+    char dirbuf[256];
+    strncpy(dirbuf, full_path, sizeof(dirbuf) - 1);
+    dirbuf[sizeof(dirbuf) - 1] = '\0';
+    char *last = strrchr(dirbuf, '/');
+    if (!last) return;
+    *last = '\0';
+
+    for (int i = 0; i < USB_DIR_CACHE_SLOTS; i++) {
+        if (strcmp(s_dir_cache[i], dirbuf) == 0) return;
+    }
+    if (mkdir_p(dirbuf) != 0) {
+        ESP_LOGW(TAG, "failed to ensure dir %s", dirbuf);
+        return;
+    }
+    strncpy(s_dir_cache[s_dir_cache_next], dirbuf, sizeof(s_dir_cache[0]) - 1);
+    s_dir_cache_next = (s_dir_cache_next + 1) % USB_DIR_CACHE_SLOTS;
+}
+
 esp_err_t usb_storage_init(const char *mount_point)
 {
     if (!mount_point) return ESP_ERR_INVALID_ARG;
     if (!s_usb_mutex) {
-        s_usb_mutex = xSemaphoreCreateMutex();
+        s_usb_mutex = APP_MUTEX_CREATE(s_usb_mutex_buf);
         if (!s_usb_mutex) return ESP_ERR_NO_MEM;
     }
     strncpy(s_mount_point, mount_point, sizeof(s_mount_point) - 1);
+    s_generation++;
+    s_prealloc_off = false;
     ESP_LOGI(TAG, "initialized with mount point %s", s_mount_point);
     return ESP_OK;
 }
 
+uint32_t usb_storage_generation(void)
+{
+    return s_generation;
+}
+
 void usb_storage_deinit(void)
 {
+    usb_log_close();
+    memset(s_dir_cache, 0, sizeof(s_dir_cache));
     if (s_usb_mutex) {
         vSemaphoreDelete(s_usb_mutex);
         s_usb_mutex = NULL;
@@ -87,22 +164,14 @@ int usb_write_atomic(const char *relpath, const void *data, size_t len)
     build_full_path(full_path, sizeof(full_path), relpath);
     snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", full_path);
 
-    // Ensure parent dir exists
-    char dirbuf[256];
-    strncpy(dirbuf, full_path, sizeof(dirbuf));
-    char *last = strrchr(dirbuf, '/');
-    if (last) {
-        *last = '\0';
-        if (mkdir_p(dirbuf) != 0) {
-            ESP_LOGW(TAG, "failed to ensure dir %s", dirbuf);
-        }
-    }
-
     if (xSemaphoreTake(s_usb_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
         ESP_LOGE(TAG, "mutex take failed");
         return -1;
     }
 
+    // Ensure parent dir exists
+    ensure_parent_dir(full_path);
+
     int fd = open(tmp_path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
     if (fd < 0) {
         ESP_LOGE(TAG, "open tmp %s failed: %s", tmp_path, strerror(errno));
@@ -148,22 +217,14 @@ int usb_append_log(const char *relpath, const char *line)
     char full_path[256];
     build_full_path(full_path, sizeof(full_path), relpath);
 
-    // Ensure parent dir exists
-    char dirbuf[256];
-    strncpy(dirbuf, full_path, sizeof(dirbuf));
-    char *last = strrchr(dirbuf, '/');
-    if (last) {
-        *last = '\0';
-        if (mkdir_p(dirbuf) != 0) {
-            ESP_LOGW(TAG, "failed to ensure dir %s", dirbuf);
-        }
-    }
-
     if (xSemaphoreTake(s_usb_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
         ESP_LOGE(TAG, "mutex take failed");
         return -1;
     }
 
+    // Ensure parent dir exists
+    ensure_parent_dir(full_path);
+
     int fd = open(full_path, O_CREAT | O_WRONLY | O_APPEND, 0644);
     if (fd < 0) {
         ESP_LOGE(TAG, "open %s failed: %s", full_path, strerror(errno));
@@ -193,6 +254,411 @@ int usb_append_log(const char *relpath, const char *line)
     return 0;
 }
 
+/* ---- Cluster-aligned log segments ---- */
+
+static void seg_path(char *out, size_t out_sz, const char *reldir, unsigned index)
+{
+    char rel[224];
+    snprintf(rel, sizeof(rel), "%s/seg-%05u.json", reldir, index);
+    build_full_path(out, out_sz, rel);
+}
+
+static void seg_index_path(char *out, size_t out_sz, const char *reldir, unsigned index)
+{
+    char rel[224];
+    snprintf(rel, sizeof(rel), "%s/seg-%05u.idx", reldir, index);
+    build_full_path(out, out_sz, rel);
+}
+
+// seg-NNNNN.end next to a segment path ending in .json
+static void seg_end_path(char *out, size_t out_sz, const char *seg_full_path)
+{
+    size_t n = strlen(seg_full_path);
+    if (n > 5 && strcmp(seg_full_path + n - 5, ".json") == 0) n -= 5;
+    snprintf(out, out_sz, "%.*s.end", (int)n, seg_full_path);
+}
+
+// Append the pending index entries to the segment's .idx. Called with
+// s_usb_mutex held. On failure the entries are dropped: the index is sparse
+// and rebuildable, the data is what matters.
+static void seg_index_write_locked(void)
+{
+    if (s_idx_n == 0 || s_seg.fd < 0) return;
+    char path[256];
+    seg_index_path(path, sizeof(path), s_seg.dir, s_seg.index);
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd >= 0) {
+        char buf[USB_INDEX_PENDING * 32];
+        size_t len = 0;
+        for (int i = 0; i < s_idx_n; i++) {
+            len += snprintf(buf + len, sizeof(buf) - len, "%lld %ld\n",
+                            (long long)s_idx_pending[i].ts, (long)s_idx_pending[i].off);
+        }
+        if (write(fd, buf, len) != (ssize_t)len) {
+            ESP_LOGW(TAG, "index write failed: %s", strerror(errno));
+        }
+        close(fd);
+    } else {
+        ESP_LOGW(TAG, "open %s failed: %s", path, strerror(errno));
+    }
+    s_idx_n = 0;
+}
+
+// Record the logical end of the current segment. Called with s_usb_mutex
+// held, after the data up to end is synced.
+static void seg_end_write_locked(off_t end)
+{
+    char buf[USB_SEG_END_LEN + 1];
+    snprintf(buf, sizeof(buf), "%0*ld\n", USB_SEG_END_LEN - 1, (long)end);
+    if (pwrite(s_seg.end_fd, buf, USB_SEG_END_LEN, 0) != USB_SEG_END_LEN || fsync(s_seg.end_fd) != 0) {
+        ESP_LOGW(TAG, "end marker write failed: %s", strerror(errno));
+    }
+}
+
+// Logical end-of-data of a segment. The preallocated tail holds whatever the
+// clusters held before (FAT does not zero them), so it is never scanned: an
+// open or unclosed segment has its end in seg-NNNNN.end, a closed one was
+// trimmed to it and the marker removed.
+static off_t seg_find_data_end(const char *seg_full_path, off_t size)
+{
+    char path[256];
+    seg_end_path(path, sizeof(path), seg_full_path);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return size;
+    char buf[USB_SEG_END_LEN + 1];
+    ssize_t r = pread(fd, buf, USB_SEG_END_LEN, 0);
+    close(fd);
+    buf[r > 0 ? r : 0] = '\0';
+    char *tail;
+    long end = strtol(buf, &tail, 10);
+    if (tail == buf || end < 0) return 0;  // marker created, first flush never finished
+    return end < size ? end : size;
+}
+
+long usb_log_data_end(const char *relpath)
+{
+    if (!relpath) return -1;
+    char full_path[256];
+    build_full_path(full_path, sizeof(full_path), relpath);
+    struct stat st;
+    if (stat(full_path, &st) != 0) return -1;
+    return (long)seg_find_data_end(full_path, st.st_size);
+}
+
+// Highest existing segment index in reldir, 0 if none
+static unsigned seg_last_index(const char *reldir)
+{
+    char dirpath[256];
+    build_full_path(dirpath, sizeof(dirpath), reldir);
+    DIR *d = opendir(dirpath);
+    if (!d) return 0;
+    unsigned last = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        unsigned idx;
+        int n = 0;
+        // %n only lands if the whole name matched, so .idx/.end siblings are skipped
+        if (sscanf(e->d_name, "seg-%05u.json%n", &idx, &n) == 1 && n > 0 && e->d_name[n] == '\0' &&
+            idx > last) last = idx;
+    }
+    closedir(d);
+    return last;
+}
+
+// Trim the preallocated tail of a segment left open by a power cut
+static void seg_trim_stale(const char *reldir, unsigned index)
+{
+    char path[256], end_path[256];
+    seg_path(path, sizeof(path), reldir, index);
+    seg_end_path(end_path, sizeof(end_path), path);
+    struct stat st;
+    if (stat(end_path, &st) != 0) return;   // closed cleanly
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return;
+    off_t end = fstat(fd, &st) == 0 ? seg_find_data_end(path, st.st_size) : -1;
+    bool ok = end >= 0;
+    if (ok && end < st.st_size) {
+        ESP_LOGI(TAG, "trimming stale segment %s to %ld bytes", path, (long)end);
+        ok = ftruncate(fd, end) == 0 && fsync(fd) == 0;
+        if (!ok) ESP_LOGW(TAG, "trim failed: %s", strerror(errno));
+    }
+    close(fd);
+    if (ok) unlink(end_path);   // only once the file ends where the marker said
+}
+
+// Grow the current segment to new_end ahead of the writes. Older vfs_fat
+// cannot grow a file with ftruncate (EPERM): after the first refusal segments
+// grow with their writes, cluster by cluster, until the next mount.
+// Called with s_usb_mutex held.
+static void seg_prealloc_locked(off_t new_end, off_t need)
+{
+    if (!s_prealloc_off) {
+        if (ftruncate(s_seg.fd, new_end) == 0) {
+            s_seg.alloc_end = new_end;
+            return;
+        }
+        ESP_LOGW(TAG, "preallocation failed: %s, not retried on this stick", strerror(errno));
+        s_prealloc_off = true;
+    }
+    s_seg.alloc_end = need;
+}
+
+// Write the whole staging block at its aligned offset, growing the
+// preallocated extent first if needed. Called with s_usb_mutex held.
+static int seg_write_block(void)
+{
+    off_t need = s_seg.block_off + USB_SEG_BLOCK_SIZE;
+    if (need > s_seg.alloc_end) seg_prealloc_locked(s_seg.alloc_end + USB_SEG_PREALLOC_SIZE, need);
+
+    int64_t t_write = TRACE_BEGIN();
+    size_t done = 0;
+    while (done < USB_SEG_BLOCK_SIZE) {
+        ssize_t w = pwrite(s_seg.fd, s_stage + done, USB_SEG_BLOCK_SIZE - done, s_seg.block_off + done);
+        if (w <= 0) {
+            ESP_LOGE(TAG, "block write at %ld failed: %s", (long)s_seg.block_off, strerror(errno));
+            return -1;
+        }
+        done += w;
+    }
+    TRACE_END(USB_WRITE, t_write);
+    return 0;
+}
+
+static int seg_stage(const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    while (len > 0) {
+        size_t n = USB_SEG_BLOCK_SIZE - s_seg.stage_len;
+        if (n > len) n = len;
+        memcpy(s_stage + s_seg.stage_len, p, n);
+        s_seg.stage_len += n;
+        p += n;
+        len -= n;
+        if (s_seg.stage_len == USB_SEG_BLOCK_SIZE) {
+            if (seg_write_block() != 0) return -1;
+            s_seg.block_off += USB_SEG_BLOCK_SIZE;
+            s_seg.stage_len = 0;
+        }
+    }
+    return 0;
+}
+
+static int seg_flush_locked(void)
+{
+    if (s_seg.fd < 0) return -1;
+    if (s_seg.stage_len > 0) {
+        memset(s_stage + s_seg.stage_len, 0, USB_SEG_BLOCK_SIZE - s_seg.stage_len);
+        if (seg_write_block() != 0) return -1;
+    }
+    if (fsync(s_seg.fd) != 0) {
+        ESP_LOGW(TAG, "fsync failed: %s", strerror(errno));
+    } else {
+        seg_end_write_locked(s_seg.block_off + (off_t)s_seg.stage_len);
+    }
+    seg_index_write_locked(); // after the data it points into
+    return 0;
+}
+
+static void seg_close_locked(void)
+{
+    if (s_seg.fd < 0) return;
+    seg_flush_locked();
+    off_t end = s_seg.block_off + s_seg.stage_len;
+    bool trimmed = ftruncate(s_seg.fd, end) == 0 && fsync(s_seg.fd) == 0;
+    if (!trimmed) {
+        ESP_LOGW(TAG, "trim to %ld failed: %s", (long)end, strerror(errno));
+    }
+    close(s_seg.fd);
+    close(s_seg.end_fd);
+    if (trimmed) {
+        // the file size is the logical end from now on
+        char path[256], end_path[256];
+        seg_path(path, sizeof(path), s_seg.dir, s_seg.index);
+        seg_end_path(end_path, sizeof(end_path), path);
+        unlink(end_path);
+    }
+    ESP_LOGI(TAG, "closed segment %u (%ld bytes)", s_seg.index, (long)end);
+    s_seg.fd = -1;
+    s_seg.end_fd = -1;
+}
+
+static int seg_open_locked(const char *reldir, unsigned index)
+{
+    char path[256];
+    seg_path(path, sizeof(path), reldir, index);
+    ensure_parent_dir(path);
+
+    // the end marker exists before the file has a preallocated tail to misread
+    char end_path[256];
+    seg_end_path(end_path, sizeof(end_path), path);
+    int end_fd = open(end_path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (end_fd < 0) {
+        ESP_LOGE(TAG, "open %s failed: %s", end_path, strerror(errno));
+        return -1;
+    }
+#ifdef SEG_CONTIGUOUS
+    // first extent in one contiguous run; f_expand only works on an empty file
+    unlink(path);
+    bool contiguous = esp_vfs_fat_create_contiguous_file(s_mount_point, path, USB_SEG_PREALLOC_SIZE, true) == ESP_OK;
+#else
+    bool contiguous = false;
+#endif
+    int fd = open(path, contiguous ? O_RDWR : O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "open segment %s failed: %s", path, strerror(errno));
+        close(end_fd);
+        return -1;
+    }
+    char idx[256];
+    seg_index_path(idx, sizeof(idx), reldir, index);
+    unlink(idx); // left over from a segment with the same index
+    s_seg.fd = fd;
+    s_seg.end_fd = end_fd;
+    s_seg.index = index;
+    strncpy(s_seg.dir, reldir, sizeof(s_seg.dir) - 1);
+    s_seg.dir[sizeof(s_seg.dir) - 1] = '\0';
+    s_seg.block_off = 0;
+    s_seg.stage_len = 0;
+    s_seg.alloc_end = contiguous ? USB_SEG_PREALLOC_SIZE : 0;
+    s_seg.next_index = 0;
+    s_idx_n = 0;
+    seg_end_write_locked(0);
+    if (!contiguous) seg_prealloc_locked(USB_SEG_PREALLOC_SIZE, 0);
+    ESP_LOGI(TAG, "opened segment %s", path);
+    return 0;
+}
+
+// The sibling of reldir that sorts just before it ("logs/s00041" for
+// "logs/s00042"): the session that was logging before a reboot. Session
+// names are zero padded, so name order is creation order.
+static bool seg_prev_dir(const char *reldir, char *out, size_t out_sz)
+{
+    const char *slash = strrchr(reldir, '/');
+    if (!slash) return false;
+    char parent[192];
+    snprintf(parent, sizeof(parent), "%.*s", (int)(slash - reldir), reldir);
+    char dirpath[256];
+    build_full_path(dirpath, sizeof(dirpath), parent);
+    DIR *d = opendir(dirpath);
+    if (!d) return false;
+    char best[64] = "";
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.' || strlen(e->d_name) >= sizeof(best)) continue;
+        if (strcmp(e->d_name, slash + 1) < 0 && strcmp(e->d_name, best) > 0) {
+            strcpy(best, e->d_name);
+        }
+    }
+    closedir(d);
+    if (!best[0]) return false;
+    snprintf(out, out_sz, "%s/%s", parent, best);
+    return true;
+}
+
+int usb_log_open(const char *reldir)
+{
+    if (!reldir) return -1;
+    if (!s_usb_mutex) return -1;
+    if (xSemaphoreTake(s_usb_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        ESP_LOGE(TAG, "mutex take failed");
+        return -1;
+    }
+    seg_close_locked();
+    // a power cut leaves the previous session's last segment open: a new
+    // session never reopens that directory, so trim it here
+    char prev[192];
+    if (seg_prev_dir(reldir, prev, sizeof(prev))) {
+        unsigned prev_last = seg_last_index(prev);
+        if (prev_last > 0) seg_trim_stale(prev, prev_last);
+    }
+    unsigned last = seg_last_index(reldir);
+    if (last > 0) seg_trim_stale(reldir, last);
+    int ret = seg_open_locked(reldir, last + 1);
+    xSemaphoreGive(s_usb_mutex);
+    return ret;
+}
+
+int usb_log_append(int64_t ts, const char *line, size_t len)
+{
+    if (!line) return -1;
+    if (!s_usb_mutex) return -1;
+    if (xSemaphoreTake(s_usb_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        ESP_LOGE(TAG, "mutex take failed");
+        return -1;
+    }
+    if (s_seg.fd < 0) {
+        xSemaphoreGive(s_usb_mutex);
+        return -1;
+    }
+
+    if (s_seg.block_off + (off_t)(s_seg.stage_len + len + 1) > USB_SEG_MAX_SIZE) {
+        char dir[sizeof(s_seg.dir)];
+        memcpy(dir, s_seg.dir, sizeof(dir));
+        unsigned next = s_seg.index + 1;
+        seg_close_locked();
+        if (seg_open_locked(dir, next) != 0) {
+            xSemaphoreGive(s_usb_mutex);
+            return -1;
+        }
+    }
+
+    off_t off = s_seg.block_off + (off_t)s_seg.stage_len;
+    if (off >= s_seg.next_index) {
+        if (s_idx_n == USB_INDEX_PENDING) seg_index_write_locked();
+        s_idx_pending[s_idx_n++] = (usb_index_entry_t){ ts, off };
+        s_seg.next_index = (off / USB_INDEX_STRIDE + 1) * USB_INDEX_STRIDE;
+    }
+
+    int ret = seg_stage(line, len);
+    if (ret == 0) ret = seg_stage("\n", 1);
+    xSemaphoreGive(s_usb_mutex);
+    return ret;
+}
+
+int usb_log_flush(void)
+{
+    if (!s_usb_mutex) return -1;
+    if (xSemaphoreTake(s_usb_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        ESP_LOGE(TAG, "mutex take failed");
+        return -1;
+    }
+    int ret = seg_flush_locked();
+    xSemaphoreGive(s_usb_mutex);
+    return ret;
+}
+
+void usb_log_close(void)
+{
+    if (!s_usb_mutex) return;
+    if (xSemaphoreTake(s_usb_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        ESP_LOGE(TAG, "mutex take failed");
+        return;
+    }
+    seg_close_locked();
+    xSemaphoreGive(s_usb_mutex);
+}
+
+FILE *usb_fopen(const char *relpath, const char *mode)
+{
+    if (!relpath || !mode) return NULL;
+    if (!s_usb_mutex) return NULL;
+    char full_path[256];
+    build_full_path(full_path, sizeof(full_path), relpath);
+
+    if (xSemaphoreTake(s_usb_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) {
+        ESP_LOGE(TAG, "mutex take failed");
+        return NULL;
+    }
+    ensure_parent_dir(full_path);
+    xSemaphoreGive(s_usb_mutex);
+
+    FILE *f = fopen(full_path, mode);
+    if (!f) {
+        ESP_LOGE(TAG, "fopen %s failed: %s", full_path, strerror(errno));
+    }
+    return f;
+}
+
 bool usb_file_exists(const char *relpath)
 {
     if (!relpath) return false;
@@ -202,6 +668,162 @@ bool usb_file_exists(const char *relpath)
     return stat(full_path, &st) == 0;
 }
 
+bool usb_file_stat(const char *relpath, long *size, int64_t *mtime)
+{
+    if (!relpath) return false;
+    char full_path[256];
+    build_full_path(full_path, sizeof(full_path), relpath);
+    struct stat st;
+    if (stat(full_path, &st) != 0) return false;
+    *size = (long)st.st_size;
+    *mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+
+DIR *usb_opendir(const char *reldir)
+{
+    if (!reldir) return NULL;
+    char full_path[256];
+    build_full_path(full_path, sizeof(full_path), reldir);
+    return opendir(full_path);
+}
+
+int usb_remove(const char *relpath)
+{
+    if (!relpath) return -1;
+    char full_path[256];
+    build_full_path(full_path, sizeof(full_path), relpath);
+    if (unlink(full_path) == 0 || rmdir(full_path) == 0) return 0;
+    ESP_LOGW(TAG, "remove %s failed: %s", full_path, strerror(errno));
+    return -1;
+}
+
+bool usb_log_is_current(const char *relpath)
+{
+    if (!relpath || !s_usb_mutex) return false;
+    char cur[224];
+    if (xSemaphoreTake(s_usb_mutex, pdMS_TO_TICKS(5000)) != pdTRUE) return true; // assume busy
+    bool open = s_seg.fd >= 0;
+    if (open) snprintf(cur, sizeof(cur), "%s/seg-%05u.json", s_seg.dir, s_seg.index);
+    xSemaphoreGive(s_usb_mutex);
+    return open && strcmp(cur, relpath) == 0;
+}
+
+bool usb_storage_wait_mounted(int timeout_ms)
+{
+    TickType_t start = xTaskGetTickCount();
+    while (s_mount_point[0] == '\0') {
+        if ((int)((xTaskGetTickCount() - start) * portTICK_PERIOD_MS) >= timeout_ms) return false;
+        vTaskDelay(pdMS_TO_TICKS(USB_MOUNT_POLL_MS));
+    }
+    return true;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+APP_TASK_STORAGE(s_mount_task, 4096);
+APP_TASK_STORAGE(s_host_task, 3072);
+APP_TASK_STORAGE(s_msc_task, 4096);
+APP_QUEUE_STORAGE(s_msc_events, USB_MSC_EVENT_QUEUE_LEN, sizeof(msc_host_event_t));
+
+static QueueHandle_t s_msc_queue = NULL;
+
+// USB host library event loop: enumeration and the class drivers depend on it
+static void usb_host_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        uint32_t flags = 0;
+        usb_host_lib_handle_events(portMAX_DELAY, &flags);
+        if (flags & USB_HOST_LIB_EVENT_FLAGS_NO_CLIENTS) {
+            usb_host_device_free_all();
+        }
+    }
+}
+
+// Runs in the MSC driver's task: hand the event over, mounting blocks
+static void msc_event_cb(const msc_host_event_t *event, void *arg)
+{
+    (void)arg;
+    if (xQueueSend(s_msc_queue, event, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "MSC event %d dropped", (int)event->event);
+    }
+}
+
+// Stick pulled: close the segment and report unmounted, the logger reopens
+// on the next one
+static void usb_storage_detach(void)
+{
+    usb_log_close();
+    if (s_usb_mutex && xSemaphoreTake(s_usb_mutex, portMAX_DELAY) == pdTRUE) {
+        s_mount_point[0] = '\0';
+        memset(s_dir_cache, 0, sizeof(s_dir_cache));
+        xSemaphoreGive(s_usb_mutex);
+    }
+}
+
+// Mount connected sticks at USB_MOUNT_POINT and point the storage layer at them
+static void usb_msc_task(void *arg)
+{
+    (void)arg;
+    msc_host_device_handle_t device = NULL;
+    msc_host_vfs_handle_t vfs = NULL;
+    const esp_vfs_fat_mount_config_t mount_cfg = {
+        .format_if_mount_failed = false,    // never wipe a stick that holds logs
+        .max_files = USB_MAX_OPEN_FILES,
+        .allocation_unit_size = USB_SEG_BLOCK_SIZE,
+    };
+    for (;;) {
+        msc_host_event_t event;
+        xQueueReceive(s_msc_queue, &event, portMAX_DELAY);
+        if (event.event == MSC_DEVICE_CONNECTED) {
+            if (device) continue;   // one stick at a time
+            esp_err_t err = msc_host_install_device(event.device.address, &device);
+            if (err == ESP_OK) err = msc_host_vfs_register(device, USB_MOUNT_POINT, &mount_cfg, &vfs);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "mount failed: %s", esp_err_to_name(err));
+                if (device) msc_host_uninstall_device(device);
+                device = NULL;
+                continue;
+            }
+            ESP_LOGI(TAG, "stick mounted at %s", USB_MOUNT_POINT);
+            usb_storage_init(USB_MOUNT_POINT);
+        } else if (event.event == MSC_DEVICE_DISCONNECTED && event.device.handle == device) {
+            ESP_LOGW(TAG, "stick removed");
+            usb_storage_detach();
+            msc_host_vfs_unregister(vfs);
+            msc_host_uninstall_device(device);
+            device = NULL;
+            vfs = NULL;
+        }
+    }
+}
+
+esp_err_t usb_storage_start(void)
+{
+    const usb_host_config_t host_cfg = {
+        .skip_phy_setup = false,
+        .intr_flags = ESP_INTR_FLAG_LEVEL1,
+    };
+    esp_err_t err = usb_host_install(&host_cfg);
+    if (err != ESP_OK) return err;
+    if (APP_TASK_CREATE(s_host_task, usb_host_task, "usb_host", NULL, tskIDLE_PRIORITY + 6, NULL) != pdPASS) {
+        return ESP_FAIL;
+    }
+
+    s_msc_queue = APP_QUEUE_CREATE(s_msc_events, USB_MSC_EVENT_QUEUE_LEN, sizeof(msc_host_event_t));
+    if (!s_msc_queue) return ESP_ERR_NO_MEM;
+    const msc_host_driver_config_t msc_cfg = {
+        .create_backround_task = true,      // sic, the driver's spelling
+        .task_priority = tskIDLE_PRIORITY + 5,
+        .stack_size = 4096,
+        .callback = msc_event_cb,
+    };
+    err = msc_host_install(&msc_cfg);
+    if (err != ESP_OK) return err;
+    BaseType_t ok = APP_TASK_CREATE(s_msc_task, usb_msc_task, "usb_msc", NULL, tskIDLE_PRIORITY + 5, NULL);
+    return ok == pdPASS ? ESP_OK : ESP_FAIL;
+}
 
 static void usb_mount_test_task(void *arg)
 {
@@ -243,18 +865,17 @@ void usb_main_test(void)
 {
     // Initialize USB Host
     ESP_LOGI(TAG, "Installing USB Host driver...");
-    usb_host_config_t host_cfg = {0};
-    ESP_ERROR_CHECK(usb_host_install(&host_cfg));
+    ESP_ERROR_CHECK(usb_storage_start());
     ESP_LOGI(TAG, "USB Host driver installed");
 
     // Start task that waits for USB mount point and runs write test
-    xTaskCreatePinnedToCore(
+    APP_TASK_CREATE(
+        s_mount_task,
         usb_mount_test_task,
         "usb_mount_test",
-        4096,
         NULL,
         tskIDLE_PRIORITY + 5,
-        NULL,
-        tskNO_AFFINITY
+        NULL
     );
-}
\ No newline at end of file
+}
+#endif // !CONFIG_IDF_TARGET_LINUX
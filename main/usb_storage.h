@@ -3,8 +3,43 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <dirent.h>
 #include <esp_err.h>
 
+/*
+ * Log segments are written in whole blocks from a staging buffer. The block
+ * size must be a multiple of the FAT32 cluster size of the stick (8-16 KB on
+ * 16/32 GB sticks) so every write lands on a cluster boundary.
+ */
+#define USB_SEG_BLOCK_SIZE      (16 * 1024)
+#define USB_SEG_PREALLOC_SIZE   (1024 * 1024)       // extent reserved each time the file grows
+#define USB_SEG_MAX_SIZE        (16 * 1024 * 1024)  // rotate to a new segment after this
+#define USB_MOUNT_POLL_MS       100                 // mount point check period while waiting for the stick
+#define USB_DIR_CACHE_SLOTS     8                   // directories remembered as already created
+#define USB_MOUNT_POINT         "/usb"              // VFS path the stick's FAT volume is registered at
+#define USB_MAX_OPEN_FILES      8                   // segment, its .end and .idx, clock map, readers
+#define USB_MSC_EVENT_QUEUE_LEN 4                   // connect/disconnect events waiting for the mount task
+
+/*
+ * Sparse time index: next to each seg-NNNNN.json the writer keeps
+ * seg-NNNNN.idx, one "ts offset" text line for the first record starting in
+ * every USB_INDEX_STRIDE bytes of the segment. Entries are appended when the
+ * segment is flushed, so the index may lag the data; it holds nothing that
+ * the segment does not, and log_index_rebuild() (log_query.h) recreates it.
+ */
+#define USB_INDEX_STRIDE        USB_SEG_BLOCK_SIZE
+#define USB_INDEX_PENDING       16                  // entries buffered between flushes
+
+/*
+ * Logical end of a segment: while it is open (or after a power cut left it
+ * open) seg-NNNNN.end holds its length up to the last flush, as one line of
+ * USB_SEG_END_LEN - 1 decimal digits. The preallocated tail past it holds
+ * stale clusters, not zeros. Closing trims the file and removes the marker.
+ */
+#define USB_SEG_END_LEN         11
+
 /**
  * Initialize USB storage helper.
  * mount_point should be the VFS mount point (e.g. "/usb").
@@ -23,9 +58,74 @@ int usb_write_atomic(const char *relpath, const void *data, size_t len);
 /** Append a single line (adds newline) to a log file. */
 int usb_append_log(const char *relpath, const char *line);
 
+/**
+ * Open a new log segment under reldir (e.g. "logs"). The segment file is
+ * preallocated in USB_SEG_PREALLOC_SIZE extents, so the FAT and directory
+ * entry are not touched on every append (the first extent contiguous on IDF
+ * 5.3+; without preallocation if the stick's vfs cannot grow a file with
+ * ftruncate). The last segment of reldir and of
+ * the sibling directory sorting just before it (the previous session) are
+ * trimmed first if a power cut left them open. Returns 0 on success, -1 on
+ * error.
+ */
+int usb_log_open(const char *reldir);
+
+/**
+ * Append one record (adds newline) to the current segment. Data is staged in
+ * RAM and written only as whole USB_SEG_BLOCK_SIZE blocks at aligned offsets.
+ * Rotates to a new segment when USB_SEG_MAX_SIZE is reached. ts is the
+ * record's timestamp, the key of the segment's time index.
+ */
+int usb_log_append(int64_t ts, const char *line, size_t len);
+
+/**
+ * Write the partial staging block (zero padded, same aligned offset), fsync
+ * and record the logical end-of-data in the segment's .end marker.
+ */
+int usb_log_flush(void);
+
+/** Flush, trim the preallocated tail to the logical end, close the segment and drop its .end marker. */
+void usb_log_close(void);
+
+/** True if relpath is the segment currently being written (not safe to upload or delete). */
+bool usb_log_is_current(const char *relpath);
+
+/** Logical end-of-data of a segment file (its .end marker if any, else its size), -1 on error. */
+long usb_log_data_end(const char *relpath);
+
+/**
+ * fopen() a file at relative path under the mount point, creating its parent
+ * directory if needed. For side files (traces, indexes) outside the segment writer.
+ */
+FILE *usb_fopen(const char *relpath, const char *mode);
+
 /** Return true if file exists at relative path. */
 bool usb_file_exists(const char *relpath);
 
+/** Size and modification time (seconds) of a file at relative path; false if it does not exist. */
+bool usb_file_stat(const char *relpath, long *size, int64_t *mtime);
+
+/** opendir() a directory at relative path under the mount point. */
+DIR *usb_opendir(const char *reldir);
+
+/** Delete a file or an empty directory at relative path. Returns 0 on success. */
+int usb_remove(const char *relpath);
+
+/**
+ * Install the USB host library (with the task that runs its event loop) and
+ * the MSC class driver, and start a task that mounts a connected stick at
+ * USB_MOUNT_POINT and calls usb_storage_init(). Pulling the stick closes the
+ * current segment and unmounts it; the next one is mounted the same way.
+ * Returns without waiting.
+ */
+esp_err_t usb_storage_start(void);
+
+/** Wait up to timeout_ms for usb_storage_init(). Returns true once mounted. */
+bool usb_storage_wait_mounted(int timeout_ms);
+
+/** Incremented by every usb_storage_init(): caches of a stick's files compare it to notice a swap. */
+uint32_t usb_storage_generation(void);
+
 void usb_main_test(void);
 
 #endif // USB_STORAGE_H
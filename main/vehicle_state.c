@@ -0,0 +1,128 @@
+#include "vehicle_state.h"
+
+#include <stdlib.h>
+#include "esp_log.h"
+#include "obd_plan.h"
+
+static const char *TAG = "vehicle_state";
+
+static const struct {
+    const char *name;
+    uint32_t period_ms[VS_RATE_COUNT];
+    uint32_t heartbeat_ms;
+} s_states[VEHICLE_STATE_COUNT] = {
+#define VS_ROW(id, name, fast_ms, medium_ms, slow_ms, heartbeat_ms) \
+    { name, { fast_ms, medium_ms, slow_ms }, heartbeat_ms },
+    VEHICLE_STATE_LIST(VS_ROW)
+#undef VS_ROW
+};
+
+// Rate of change (units/s) above which a channel marks a transient, 0 = not watched
+static const int32_t s_transient_rate[OBD_CH_COUNT] = {
+    [OBD_CH_RPM] = VS_RPM_RATE,
+    [OBD_CH_SPEED] = VS_SPEED_RATE,
+    [OBD_CH_THROTTLE] = VS_THROTTLE_RATE,
+};
+
+static vehicle_state_t s_state = VEHICLE_OFF;
+static int64_t s_state_since;
+static vehicle_state_t s_candidate = VEHICLE_OFF;
+static int s_candidate_n = 0;
+static int64_t s_transient_until = 0;
+static int64_t s_now = 0;       // time of the latest sample
+
+// Last sample of each channel, for rates of change
+static uint32_t s_have = 0;
+static int32_t s_last[OBD_CH_MAX];
+static int64_t s_last_ts[OBD_CH_MAX];
+
+// Last logged value of each channel, for the deadband
+static uint32_t s_logged = 0;
+static int32_t s_logged_v[OBD_CH_MAX];
+static int64_t s_logged_ts[OBD_CH_MAX];
+
+vehicle_state_t vehicle_state_update(const obd_record_t *rec)
+{
+    vehicle_state_t next;
+
+    if (rec->valid == 0) {
+        next = VEHICLE_OFF; // ECU silent: ignition off
+    } else {
+        for (int ch = 0; ch < OBD_CH_MAX; ch++) {
+            uint32_t bit = 1u << ch;
+            if (!(rec->valid & bit)) continue;
+            int64_t dt = rec->ts - s_last_ts[ch];
+            if (ch < OBD_CH_COUNT && s_transient_rate[ch] && (s_have & bit) && dt > 0 &&
+                (int64_t)abs(rec->v[ch] - s_last[ch]) * 1000 > (int64_t)s_transient_rate[ch] * dt) {
+                s_transient_until = rec->ts + VS_TRANSIENT_HOLD_MS;
+            }
+            s_last[ch] = rec->v[ch];
+            s_last_ts[ch] = rec->ts;
+            s_have |= bit;
+        }
+
+        bool running = (s_have & (1u << OBD_CH_RPM)) && s_last[OBD_CH_RPM] >= VS_RPM_RUNNING;
+        bool moving = (s_have & (1u << OBD_CH_SPEED)) && s_last[OBD_CH_SPEED] >= VS_SPEED_MOVING;
+        if (!running) next = VEHICLE_OFF;
+        else if (rec->ts < s_transient_until) next = VEHICLE_TRANSIENT;
+        else next = moving ? VEHICLE_CRUISE : VEHICLE_IDLE;
+    }
+
+    // hysteresis: a transient is acted on at once, anything else must repeat
+    if (next == s_state) {
+        s_candidate_n = 0;
+    } else {
+        s_candidate_n = next == s_candidate ? s_candidate_n + 1 : 1;
+        s_candidate = next;
+        if (next == VEHICLE_TRANSIENT || s_candidate_n >= VS_CONFIRM_SAMPLES) {
+            ESP_LOGI(TAG, "%s -> %s", s_states[s_state].name, s_states[next].name);
+            s_state = next;
+            s_state_since = rec->ts;
+            s_candidate_n = 0;
+        }
+    }
+    if (s_state_since == 0) s_state_since = rec->ts;
+    s_now = rec->ts;
+    return s_state;
+}
+
+vehicle_state_t vehicle_state_get(void)
+{
+    return s_state;
+}
+
+int64_t vehicle_state_age_ms(void)
+{
+    return s_now > s_state_since ? s_now - s_state_since : 0;
+}
+
+uint32_t vehicle_state_period_ms(int ch)
+{
+    return s_states[s_state].period_ms[obd_plan_active()->rate[ch]];
+}
+
+bool vehicle_state_filter(obd_record_t *rec)
+{
+    uint32_t heartbeat = s_states[s_state].heartbeat_ms;
+    const obd_plan_t *plan = obd_plan_active();
+    for (int ch = 0; ch < OBD_CH_MAX; ch++) {
+        uint32_t bit = 1u << ch;
+        if (!(rec->valid & bit)) continue;
+        bool keep = heartbeat == 0 || !(s_logged & bit) ||
+                    abs(rec->v[ch] - s_logged_v[ch]) >= plan->deadband[ch] ||
+                    rec->ts - s_logged_ts[ch] >= heartbeat;
+        if (keep) {
+            s_logged |= bit;
+            s_logged_v[ch] = rec->v[ch];
+            s_logged_ts[ch] = rec->ts;
+        } else {
+            rec->valid &= ~bit;
+        }
+    }
+    return rec->valid != 0;
+}
+
+const char *vehicle_state_name(vehicle_state_t st)
+{
+    return st < VEHICLE_STATE_COUNT ? s_states[st].name : "?";
+}
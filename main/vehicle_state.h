@@ -0,0 +1,68 @@
+#ifndef VEHICLE_STATE_H
+#define VEHICLE_STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "obd_channels.h"
+
+/*
+ * Vehicle state from decoded channels, driving how often each channel is
+ * polled and how much of it is logged. Transients are sampled fast and
+ * logged in full; steady states are polled slower and only changes larger
+ * than the channel deadband (or a heartbeat) reach the log.
+ *
+ * X(id, name, fast_ms, medium_ms, slow_ms, heartbeat_ms)
+ *   *_ms          polling period of each rate class, 0 = not polled
+ *   heartbeat_ms  a value is logged at least this often even if unchanged,
+ *                 0 = log every sample (no deadband)
+ */
+#define VEHICLE_STATE_LIST(X) \
+    X(OFF,          "off",          2000,   0,      0,      60000) \
+    X(IDLE,         "idle",         1000,   5000,   10000,  10000) \
+    X(CRUISE,       "cruise",       1000,   1000,   10000,  5000) \
+    X(TRANSIENT,    "transient",    200,    500,    5000,   0)
+
+typedef enum {
+#define VS_ENUM(id, name, fast_ms, medium_ms, slow_ms, heartbeat_ms) VEHICLE_##id,
+    VEHICLE_STATE_LIST(VS_ENUM)
+#undef VS_ENUM
+    VEHICLE_STATE_COUNT
+} vehicle_state_t;
+
+/* Rate classes of the channel table (obd_channels.h) and manifests (obd_plan.h) */
+typedef enum { VS_RATE_FAST, VS_RATE_MEDIUM, VS_RATE_SLOW, VS_RATE_COUNT } vs_rate_t;
+
+#define VS_RPM_RUNNING          400     // rpm at or above: engine running
+#define VS_SPEED_MOVING         5       // km/h at or above: moving
+#define VS_RPM_RATE             400     // rpm/s above: transient
+#define VS_SPEED_RATE           5       // km/h/s above: transient
+#define VS_THROTTLE_RATE        100     // 0.1 %/s above: transient
+#define VS_TRANSIENT_HOLD_MS    3000    // stay in TRANSIENT this long after the last fast change
+#define VS_CONFIRM_SAMPLES      2       // consecutive samples needed to leave a state (TRANSIENT enters at once)
+#define VS_LP_AFTER_MS          60000   // engine off this long: park the adapter in low power (ATLP)
+#define VS_LP_POLL_MS           10000   // wake-up and poll period while the adapter is parked
+
+/**
+ * Feed one polled sample (valid may hold only the channels polled this time;
+ * valid == 0 means the ECU did not answer). Returns the current state.
+ */
+vehicle_state_t vehicle_state_update(const obd_record_t *rec);
+
+vehicle_state_t vehicle_state_get(void);
+
+/** Milliseconds (sample time) spent in the current state so far. */
+int64_t vehicle_state_age_ms(void);
+
+/** Polling period of a channel slot of the active plan in the current state, 0 if not polled. */
+uint32_t vehicle_state_period_ms(int ch);
+
+/**
+ * Storage resolution: clear the valid bits of values that moved less than
+ * their deadband (active plan) since last logged (unless the heartbeat expired). Returns
+ * true if anything is left to log.
+ */
+bool vehicle_state_filter(obd_record_t *rec);
+
+const char *vehicle_state_name(vehicle_state_t st);
+
+#endif // VEHICLE_STATE_H
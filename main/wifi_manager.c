@@ -6,6 +6,9 @@
 #include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "app_alloc.h"
 
 /* Separate tags for different log categories */
 static const char *TAG_CONFIG = "wifi_config";   // Initialization / configuration messages
@@ -15,21 +18,46 @@ static const char *TAG_METRICS= "wifi_metrics";  // Periodic metrics messages
 /* Counter for connection retry attempts */
 static int s_retry_num = 0;
 
-/* Task handle for periodic metrics logging (created on successful connection) */
+/* Task handle for periodic metrics logging (created on successful connection).
+ * Swapped under s_metrics_lock: wifi_session_end and the event task both stop it */
 static TaskHandle_t s_metrics_task_handle = NULL;
-
-/* Task handle for periodic WiFi reconnection attempts */
-static TaskHandle_t s_reconnect_task_handle = NULL;
+static portMUX_TYPE s_metrics_lock = portMUX_INITIALIZER_UNLOCKED;
 
 /* Flag to track if connected to WiFi */
 static volatile bool s_wifi_connected = false;
 
-/* Flag to indicate we're attempting direct connection (disable retries during this phase) */
-static volatile bool s_direct_connect_attempt = false;
+/* Flag to indicate a join attempt is running (the event handler must not retry) */
+static volatile bool s_join_attempt = false;
+
+/* Flag to indicate the radio is on (between wifi_session_begin and wifi_session_end) */
+static volatile bool s_session_active = false;
 
 /* Current SSID being connected to */
 static char s_current_ssid[33] = {0};  // 32 chars max for SSID + null terminator
 
+/* Scan results: only the strongest WIFI_SCAN_MAX_APS records are kept */
+static wifi_ap_record_t s_ap_list[WIFI_SCAN_MAX_APS];
+
+/* Learned per known network, matched by SSID when loaded from NVS */
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;        // 0: never joined (or forgotten after failures)
+    uint8_t fails;          // consecutive failed joins
+    uint16_t join_ms;       // connect -> IP, moving average
+    uint16_t scan_ms;       // full scan that found it, moving average
+    uint32_t joins;
+} wifi_learned_t;
+
+static wifi_learned_t s_learned[KNOWN_NETWORKS_COUNT];
+static bool s_learned_dirty = false;
+
+static wifi_duty_stats_t s_duty;
+static int64_t s_radio_on_us = 0;
+
+/* Static storage for the metrics task */
+APP_TASK_STORAGE(s_metrics_task, 4096);
+
 /* Forward declaration of event handler */
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                              int32_t event_id, void* event_data);
@@ -42,43 +70,78 @@ static int rssi_to_percent(int8_t rssi)
     return 2 * (rssi + 100);
 }
 
+/* 1/4 moving average, seeded by the first sample */
+static uint16_t learn_avg(uint16_t avg, uint32_t sample_ms)
+{
+    if (sample_ms > UINT16_MAX) sample_ms = UINT16_MAX;
+    if (avg == 0) return (uint16_t)sample_ms;
+    return (uint16_t)((3u * avg + sample_ms) / 4);
+}
+
+static void learned_load(void)
+{
+    for (int i = 0; i < KNOWN_NETWORKS_COUNT; i++) {
+        strncpy(s_learned[i].ssid, KNOWN_NETWORKS[i].ssid, sizeof(s_learned[i].ssid) - 1);
+    }
+    nvs_handle_t h;
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return;
+    for (int k = 0; k < KNOWN_NETWORKS_COUNT; k++) {
+        char key[8];
+        snprintf(key, sizeof(key), "net%d", k);
+        wifi_learned_t e;
+        size_t len = sizeof(e);
+        if (nvs_get_blob(h, key, &e, &len) != ESP_OK || len != sizeof(e)) continue;
+        /* The credentials file may have been reordered: match by SSID */
+        for (int i = 0; i < KNOWN_NETWORKS_COUNT; i++) {
+            if (strncmp(e.ssid, s_learned[i].ssid, sizeof(e.ssid)) == 0) {
+                s_learned[i] = e;
+                ESP_LOGI(TAG_CONFIG, "Learned %s: channel %d, join %u ms, scan %u ms, %u joins",
+                         e.ssid, e.channel, e.join_ms, e.scan_ms, (unsigned)e.joins);
+                break;
+            }
+        }
+    }
+    nvs_close(h);
+}
+
+static void learned_save(void)
+{
+    if (!s_learned_dirty) return;
+    nvs_handle_t h;
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &h) != ESP_OK) return;
+    for (int i = 0; i < KNOWN_NETWORKS_COUNT; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "net%d", i);
+        nvs_set_blob(h, key, &s_learned[i], sizeof(s_learned[i]));
+    }
+    if (nvs_commit(h) == ESP_OK) s_learned_dirty = false;
+    nvs_close(h);
+}
+
 /**
- * @brief Scans for WiFi networks and connects to the strongest known network
- * 
- * This function performs the following steps:
- * 1. Initializes NVS, TCP/IP stack, and WiFi (once)
- * 2. First tries direct connection for networks with direct_connect=true
- * 3. If no direct connection succeeds, scans and connects to the best known network
- * 4. Retries up to MAXIMUM_RETRY times if scan fails
+ * @brief Initializes TCP/IP stack, WiFi driver and event handlers; the radio stays off
  */
-void wifi_scan_and_connect(void)
+esp_err_t wifi_init(void)
 {
-    /* Initialize NVS (only once) */
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
-    }
-    ESP_ERROR_CHECK(ret);
-    
-    /* Initialize TCP/IP stack and event loop (only once) */
+    /* Initialize TCP/IP stack and event loop */
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     esp_netif_create_default_wifi_sta();
 
-    /* Initialize WiFi with default configuration (only once) */
+    /* Initialize WiFi with default configuration */
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-    
-    /* Set WiFi mode to station */
+
+    /* Set WiFi mode to station; keep the config in RAM, learned data lives in our own NVS namespace */
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
-    ESP_ERROR_CHECK(esp_wifi_start());
-    
-    /* Register event handlers for WiFi and IP events (only once) */
+    /* Modem sleep: Bluetooth shares the radio and needs it to get airtime */
+    ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_MIN_MODEM));
+
+    /* Register event handlers for WiFi and IP events */
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
-    
+
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
                                                       ESP_EVENT_ANY_ID,
                                                       &wifi_event_handler,
@@ -89,165 +152,251 @@ void wifi_scan_and_connect(void)
                                                       &wifi_event_handler,
                                                       NULL,
                                                       &instance_got_ip));
-    
-    /* First, try direct connection for networks marked with direct_connect=true */
+
+    learned_load();
+    ESP_LOGI(TAG_CONFIG, "WiFi ready, radio off until a session starts");
+    return ESP_OK;
+}
+
+/**
+ * @brief Join one known network and wait up to timeout_ms for an IP
+ *
+ * With hint=true the learned channel and BSSID are used, so the driver
+ * probes a single channel instead of scanning all of them.
+ */
+static bool join_network(int idx, bool hint, int timeout_ms)
+{
+    wifi_config_t wifi_config = {
+        .sta = {
+            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
+            .pmf_cfg = {
+                .capable = false,
+                .required = false
+            },
+            .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
+            .sae_h2e_identifier = "",
+        },
+    };
+
+    strncpy((char *)wifi_config.sta.ssid, KNOWN_NETWORKS[idx].ssid, sizeof(wifi_config.sta.ssid) - 1);
+    strncpy((char *)wifi_config.sta.password, KNOWN_NETWORKS[idx].password, sizeof(wifi_config.sta.password) - 1);
+    if (hint) {
+        wifi_config.sta.channel = s_learned[idx].channel;
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, s_learned[idx].bssid, sizeof(wifi_config.sta.bssid));
+    }
+    strncpy(s_current_ssid, KNOWN_NETWORKS[idx].ssid, sizeof(s_current_ssid) - 1);
+
+    ESP_LOGI(TAG_CONN, "Joining %s%s (timeout %d ms)", s_current_ssid, hint ? " on learned channel" : "", timeout_ms);
+    s_join_attempt = true;
+    s_retry_num = 0;
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_wifi_set_config(WIFI_IF_STA, &wifi_config);
+    if (err == ESP_OK) err = esp_wifi_connect();
+
+    /* Wait for the IP address */
+    int wait_time = 0;
+    while (err == ESP_OK && wait_time < timeout_ms && !s_wifi_connected) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+        wait_time += 50;
+    }
+    s_join_attempt = false;
+
+    wifi_learned_t *l = &s_learned[idx];
+    s_learned_dirty = true;
+    if (!s_wifi_connected) {
+        ESP_LOGW(TAG_CONN, "Join of %s failed", s_current_ssid);
+        esp_wifi_disconnect();
+        if (++l->fails >= WIFI_LEARN_MAX_FAILS && l->channel) {
+            ESP_LOGI(TAG_CONN, "Forgetting channel of %s", l->ssid);
+            l->channel = 0; // moved or gone: find it by scanning again
+        }
+        return false;
+    }
+
+    s_duty.last_join_ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        l->channel = ap_info.primary;
+        memcpy(l->bssid, ap_info.bssid, sizeof(l->bssid));
+    }
+    l->join_ms = learn_avg(l->join_ms, s_duty.last_join_ms);
+    l->fails = 0;
+    l->joins++;
+    if (hint) s_duty.targeted_joins++;
+    ESP_LOGI(TAG_CONN, "Joined %s in %u ms (channel %d)", l->ssid, (unsigned)s_duty.last_join_ms, l->channel);
+    return true;
+}
+
+/* Timeout for a network with a learned join time: twice the usual, within bounds */
+static int join_timeout(int idx)
+{
+    int t = 2 * s_learned[idx].join_ms;
+    if (t < WIFI_JOIN_MIN_MS) t = WIFI_JOIN_MIN_MS;
+    if (t > WIFI_JOIN_MAX_MS || s_learned[idx].join_ms == 0) t = WIFI_JOIN_MAX_MS;
+    return t;
+}
+
+/* Learned duration of a full scan (slowest that found a known network), 0 if never scanned */
+static uint32_t scan_cost_ms(void)
+{
+    uint32_t ms = 0;
     for (int i = 0; i < KNOWN_NETWORKS_COUNT; i++) {
-        if (KNOWN_NETWORKS[i].direct_connect) {
-            ESP_LOGI(TAG_CONFIG, "Attempting direct connection to: %s", KNOWN_NETWORKS[i].ssid);
-            
-            s_direct_connect_attempt = true;
-            s_retry_num = 0;  // Reset retry counter
-            
-            wifi_config_t wifi_config = {
-                .sta = {
-                    .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-                    .pmf_cfg = {
-                        .capable = false,
-                        .required = false
-                    },
-                    .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
-                    .sae_h2e_identifier = "",
-                },
-            };
-            
-            strncpy((char *)wifi_config.sta.ssid, KNOWN_NETWORKS[i].ssid, sizeof(wifi_config.sta.ssid) - 1);
-            strncpy((char *)wifi_config.sta.password, KNOWN_NETWORKS[i].password, sizeof(wifi_config.sta.password) - 1);
-            strncpy(s_current_ssid, KNOWN_NETWORKS[i].ssid, sizeof(s_current_ssid) - 1);
-            
-            ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-            ESP_ERROR_CHECK(esp_wifi_connect());
-            
-            /* Wait for connection to succeed (up to 15 seconds for IP assignment) */
-            int wait_time = 0;
-            while (wait_time < 15000 && !s_wifi_connected) {
-                vTaskDelay(pdMS_TO_TICKS(100));
-                wait_time += 100;
-            }
-            
-            s_direct_connect_attempt = false;
-            
-            /* If connected, we're done */
-            if (s_wifi_connected) {
-                ESP_LOGI(TAG_CONFIG, "Direct connection successful!");
-                return;
+        if (s_learned[i].scan_ms > ms) ms = s_learned[i].scan_ms;
+    }
+    return ms;
+}
+
+/* Full scan; returns the strongest known network or -1 */
+static int scan_best_known(void)
+{
+    wifi_scan_config_t scan_config = {
+        .ssid = NULL,           // Scan all SSIDs
+        .bssid = NULL,
+        .channel = 0,           // Scan all channels
+        .show_hidden = true,    // Include hidden networks
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active.min = 100,
+        .scan_time.active.max = 300,
+    };
+
+    int64_t t0 = esp_timer_get_time();
+    if (esp_wifi_scan_start(&scan_config, true) != ESP_OK) return -1;  // true = blocking scan
+    s_duty.last_scan_ms = (uint32_t)((esp_timer_get_time() - t0) / 1000);
+
+    uint16_t ap_count = WIFI_SCAN_MAX_APS;
+    /* Records come sorted by RSSI; the driver frees the rest of the list */
+    if (esp_wifi_scan_get_ap_records(&ap_count, s_ap_list) != ESP_OK || ap_count == 0) {
+        ESP_LOGW(TAG_CONFIG, "No networks found (scan %u ms)", (unsigned)s_duty.last_scan_ms);
+        return -1;
+    }
+    ESP_LOGI(TAG_CONFIG, "Found %d networks in %u ms", ap_count, (unsigned)s_duty.last_scan_ms);
+
+    /* Find the best known network (strongest signal) */
+    int best_network_idx = -1;
+    int8_t best_rssi = -120;  // Worst possible RSSI
+    for (int i = 0; i < ap_count; i++) {
+        ESP_LOGD(TAG_CONFIG, "Found AP: SSID=%s, RSSI=%d, authmode=%d",
+                 s_ap_list[i].ssid, s_ap_list[i].rssi, s_ap_list[i].authmode);
+        for (int j = 0; j < KNOWN_NETWORKS_COUNT; j++) {
+            if (strcmp((const char *)s_ap_list[i].ssid, KNOWN_NETWORKS[j].ssid) == 0) {
+                s_learned[j].scan_ms = learn_avg(s_learned[j].scan_ms, s_duty.last_scan_ms);
+                if (s_ap_list[i].rssi > best_rssi) {
+                    best_rssi = s_ap_list[i].rssi;
+                    best_network_idx = j;
+                }
+                break;
             }
-            
-            /* Otherwise, disconnect and try next direct connect */
-            ESP_LOGW(TAG_CONFIG, "Direct connection to %s failed, trying next network...", KNOWN_NETWORKS[i].ssid);
-            esp_wifi_disconnect();
-            vTaskDelay(pdMS_TO_TICKS(1000));
         }
     }
-    
-    /* If direct connection failed, proceed with scan-based connection */
-    int attempt = 0;
-    
-    while (attempt < MAXIMUM_RETRY) {
-        attempt++;
-        ESP_LOGI(TAG_CONFIG, "Scan connection attempt %d/%d", attempt, MAXIMUM_RETRY);
-        
-        /* Perform WiFi scan */
-        ESP_LOGI(TAG_CONFIG, "Starting WiFi scan...");
-        
-        wifi_scan_config_t scan_config = {
-            .ssid = NULL,           // Scan all SSIDs
-            .bssid = NULL,
-            .channel = 0,           // Scan all channels
-            .show_hidden = true,    // Include hidden networks
-            .scan_type = WIFI_SCAN_TYPE_ACTIVE,
-            .scan_time.active.min = 100,
-            .scan_time.active.max = 300,
-        };
-        
-        ESP_ERROR_CHECK(esp_wifi_scan_start(&scan_config, true));  // true = blocking scan
-        
-        uint16_t ap_count = 0;
-        ESP_ERROR_CHECK(esp_wifi_scan_get_ap_num(&ap_count));
-        
-        if (ap_count == 0) {
-            ESP_LOGW(TAG_CONFIG, "No networks found, retrying...");
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            continue;
-        }
-        
-        ESP_LOGI(TAG_CONFIG, "Found %d networks", ap_count);
-        
-        wifi_ap_record_t *ap_list = (wifi_ap_record_t *)malloc(ap_count * sizeof(wifi_ap_record_t));
-        if (ap_list == NULL) {
-            ESP_LOGE(TAG_CONFIG, "Failed to allocate memory for AP list");
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            continue;
-        }
-        
-        ESP_ERROR_CHECK(esp_wifi_scan_get_ap_records(&ap_count, ap_list));
-        
-        /* Log all found networks */
-        ESP_LOGI(TAG_CONFIG, "Available networks:");
-        for (int i = 0; i < ap_count; i++) {
-            ESP_LOGI(TAG_CONFIG, "  [%d] SSID: %s (RSSI: %d dBm)", i+1, ap_list[i].ssid, ap_list[i].rssi);
-        }
-        
-        /* Find the best known network (strongest signal) */
-        int best_network_idx = -1;
-        int8_t best_rssi = -120;  // Worst possible RSSI
-        
-        for (int i = 0; i < ap_count; i++) {
-            ESP_LOGD(TAG_CONFIG, "Found AP: SSID=%s, RSSI=%d, authmode=%d", 
-                     ap_list[i].ssid, ap_list[i].rssi, ap_list[i].authmode);
-            
-            /* Check if this SSID is in our known networks list */
-            for (int j = 0; j < KNOWN_NETWORKS_COUNT; j++) {
-                if (strcmp((const char *)ap_list[i].ssid, KNOWN_NETWORKS[j].ssid) == 0) {
-                    /* Found a known network - keep track of strongest one */
-                    if (ap_list[i].rssi > best_rssi) {
-                        best_rssi = ap_list[i].rssi;
-                        best_network_idx = j;
-                        ESP_LOGI(TAG_CONFIG, "Found known network: %s (RSSI: %d dBm)", 
-                                 KNOWN_NETWORKS[j].ssid, ap_list[i].rssi);
-                    }
-                    break;
-                }
+    if (best_network_idx >= 0) {
+        ESP_LOGI(TAG_CONFIG, "Best known network: %s (RSSI: %d dBm)", KNOWN_NETWORKS[best_network_idx].ssid, best_rssi);
+    }
+    return best_network_idx;
+}
+
+/**
+ * @brief Switches the radio on and joins a known network
+ *
+ * 1. Networks with a learned channel, fewest failures and most joins first;
+ *    after the first one fails, the next is tried only while the blind waits
+ *    stay shorter than the learned duration of a full scan
+ * 2. Networks with direct_connect=true (e.g. a phone hotspot that may not show in scans)
+ * 3. Up to WIFI_SCAN_ATTEMPTS full scans, joining the strongest known network
+ */
+bool wifi_session_begin(void)
+{
+    if (s_session_active) return s_wifi_connected;
+    s_duty.sessions++;
+    s_duty.last_scan_ms = 0;
+    s_radio_on_us = esp_timer_get_time();
+    s_session_active = true;
+    if (esp_wifi_start() != ESP_OK) {
+        wifi_session_end();
+        s_duty.failed_sessions++;
+        return false;
+    }
+
+    bool tried[KNOWN_NETWORKS_COUNT] = {0};
+    uint32_t scan_ms = scan_cost_ms();
+    uint32_t blind_ms = 0;
+    for (;;) {
+        int pick = -1;
+        for (int i = 0; i < KNOWN_NETWORKS_COUNT; i++) {
+            if (tried[i] || s_learned[i].channel == 0) continue;
+            if (pick < 0 || s_learned[i].fails < s_learned[pick].fails ||
+                (s_learned[i].fails == s_learned[pick].fails && s_learned[i].joins > s_learned[pick].joins)) {
+                pick = i;
             }
         }
-        
-        free(ap_list);
-        
-        if (best_network_idx == -1) {
-            ESP_LOGW(TAG_CONFIG, "No known networks found, retrying...");
-            vTaskDelay(pdMS_TO_TICKS(2000));
-            continue;
+        if (pick < 0) break;
+        int timeout = join_timeout(pick);
+        if (blind_ms > 0 && scan_ms > 0 && blind_ms + (uint32_t)timeout > scan_ms) {
+            ESP_LOGI(TAG_CONFIG, "Scanning instead of another blind join (%u ms spent, scan ~%u ms)",
+                     (unsigned)blind_ms, (unsigned)scan_ms);
+            break;
         }
+        tried[pick] = true;
+        int64_t t0 = esp_timer_get_time();
+        if (join_network(pick, true, timeout)) goto joined;
+        blind_ms += (uint32_t)((esp_timer_get_time() - t0) / 1000);
+    }
 
-        /* Connect to the best known network */
-        ESP_LOGI(TAG_CONFIG, "Connecting to: %s (RSSI: %d dBm)", 
-                 KNOWN_NETWORKS[best_network_idx].ssid, best_rssi);
-        
-        wifi_config_t wifi_config = {
-            .sta = {
-                .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-                .pmf_cfg = {
-                    .capable = false,
-                    .required = false
-                },
-                .sae_pwe_h2e = WPA3_SAE_PWE_BOTH,
-                .sae_h2e_identifier = "",
-            },
-        };
-        
-        strncpy((char *)wifi_config.sta.ssid, KNOWN_NETWORKS[best_network_idx].ssid, sizeof(wifi_config.sta.ssid) - 1);
-        strncpy((char *)wifi_config.sta.password, KNOWN_NETWORKS[best_network_idx].password, sizeof(wifi_config.sta.password) - 1);
-        
-        /* Save the current SSID for use in event handler */
-        strncpy(s_current_ssid, KNOWN_NETWORKS[best_network_idx].ssid, sizeof(s_current_ssid) - 1);
-        
-        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
-        ESP_ERROR_CHECK(esp_wifi_connect());
-
-        ESP_LOGI(TAG_CONFIG, "wifi_scan_and_connect finished");
-        return;  // Successfully started connection attempt
+    for (int i = 0; i < KNOWN_NETWORKS_COUNT; i++) {
+        if (KNOWN_NETWORKS[i].direct_connect && join_network(i, false, join_timeout(i))) goto joined;
+    }
+
+    for (int attempt = 1; attempt <= WIFI_SCAN_ATTEMPTS; attempt++) {
+        ESP_LOGI(TAG_CONFIG, "Scan attempt %d/%d", attempt, WIFI_SCAN_ATTEMPTS);
+        int best = scan_best_known();
+        if (best >= 0 && join_network(best, false, join_timeout(best))) goto joined;
     }
-    
-    ESP_LOGE(TAG_CONFIG, "Failed to find and connect to known network after %d attempts", MAXIMUM_RETRY);
+
+    ESP_LOGE(TAG_CONFIG, "No known network joined, radio off");
+    s_duty.failed_sessions++;
+    wifi_session_end();
+    return false;
+
+joined:
+    learned_save();
+    return true;
+}
+
+/* Take the metrics task handle under the lock so only one caller deletes it */
+static bool metrics_task_stop(void)
+{
+    portENTER_CRITICAL(&s_metrics_lock);
+    TaskHandle_t h = s_metrics_task_handle;
+    s_metrics_task_handle = NULL;
+    portEXIT_CRITICAL(&s_metrics_lock);
+    if (h == NULL) return false;
+    vTaskDelete(h);
+    return true;
+}
+
+void wifi_session_end(void)
+{
+    if (!s_session_active) return;
+    s_session_active = false;
+    esp_wifi_disconnect();
+    esp_wifi_stop();
+    s_wifi_connected = false;
+    metrics_task_stop();
+    uint32_t on_ms = (uint32_t)((esp_timer_get_time() - s_radio_on_us) / 1000);
+    s_duty.radio_on_ms += on_ms;
+    learned_save();
+    ESP_LOGI(TAG_CONN, "Radio off after %u ms (total on %u ms in %u sessions)",
+             (unsigned)on_ms, (unsigned)s_duty.radio_on_ms, (unsigned)s_duty.sessions);
+}
+
+bool wifi_is_connected(void)
+{
+    return s_wifi_connected;
+}
+
+void wifi_get_duty_stats(wifi_duty_stats_t *out)
+{
+    if (out) *out = s_duty;
 }
 
 /* Task that periodically logs RSSI and a computed link quality */
@@ -268,36 +417,14 @@ static void wifi_metrics_task(void *arg)
     }
 }
 
-/**
- * @brief Task that periodically attempts to reconnect to WiFi
- * 
- * This task runs in the background and checks if WiFi is connected.
- * If not connected, it attempts to rescan and reconnect every 5 minutes.
- */
-static void wifi_reconnect_task(void *arg)
-{
-    (void)arg;
-    const int RECONNECT_INTERVAL_MS = 5 * 60 * 1000;  // 5 minutes
-    
-    for (;;) {
-        /* Check if connected */
-        if (!s_wifi_connected) {
-            ESP_LOGW(TAG_CONN, "WiFi disconnected, attempting to reconnect...");
-            wifi_scan_and_connect();
-        }
-        
-        vTaskDelay(pdMS_TO_TICKS(RECONNECT_INTERVAL_MS));
-    }
-}
-
 /**
  * @brief Event handler for WiFi events
- * 
+ *
  * This callback function handles three main events:
- * 1. WIFI_EVENT_STA_START: Initial WiFi startup
+ * 1. WIFI_EVENT_STA_START: Radio switched on (joins are started explicitly)
  * 2. WIFI_EVENT_STA_DISCONNECTED: WiFi disconnection
  * 3. IP_EVENT_STA_GOT_IP: Successful IP address acquisition
- * 
+ *
  * @param arg User-provided argument (unused)
  * @param event_base Base ID of the event
  * @param event_id ID of the event
@@ -306,16 +433,10 @@ static void wifi_reconnect_task(void *arg)
 static void wifi_event_handler(void* arg, esp_event_base_t event_base,
                              int32_t event_id, void* event_data)
 {
-    
-    /* Handle WiFi station start - Initial connection attempt */
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        ESP_LOGI(TAG_CONN, "Trying to connect to SSID: %s", s_current_ssid);
-        esp_wifi_connect();
-    }
-    /* Handle WiFi station start - Initial connection attempt */
+
+    /* Handle WiFi station start - radio is on, wifi_session_begin picks the network */
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        ESP_LOGI(TAG_CONN, "Trying to connect to SSID: %s", s_current_ssid);
-        esp_wifi_connect();
+        ESP_LOGI(TAG_CONN, "Radio on");
     }
     /* Handle WiFi disconnection - stop metrics task and attempt reconnection if under retry limit */
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
@@ -337,22 +458,20 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
             default:
                 reason_str = "Unknown";
         }
-        /* During direct connection attempt, don't retry yet */
-        if (s_direct_connect_attempt) {
-            return;
-        }
-
-        ESP_LOGW(TAG_CONN, "Disconnected from AP, reason: %d (%s)", event->reason, reason_str);
 
         /* If metrics task is running, stop it to avoid stale logging */
-        if (s_metrics_task_handle != NULL) {
-            vTaskDelete(s_metrics_task_handle);
-            s_metrics_task_handle = NULL;
+        if (metrics_task_stop()) {
             ESP_LOGI(TAG_METRICS, "Stopped metrics task due to disconnect");
         }
-        
         s_wifi_connected = false;  // Set disconnected flag
 
+        /* During a join attempt or once the session ended, don't retry */
+        if (s_join_attempt || !s_session_active) {
+            return;
+        }
+
+        ESP_LOGW(TAG_CONN, "Disconnected from AP, reason: %d (%s)", event->reason, reason_str);
+
         if (s_retry_num < MAXIMUM_RETRY) {
             vTaskDelay(pdMS_TO_TICKS(1000)); // Add delay before retry
             esp_wifi_connect();
@@ -372,24 +491,22 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
 
         /* Start metrics task if not already running */
         if (s_metrics_task_handle == NULL) {
-            BaseType_t xres = xTaskCreate(wifi_metrics_task, "wifi_metrics", 4096, NULL, 5, &s_metrics_task_handle);
+            TaskHandle_t h = NULL;
+            BaseType_t xres = APP_TASK_CREATE(s_metrics_task, wifi_metrics_task, "wifi_metrics", NULL, 5, &h);
             if (xres == pdPASS) {
-                ESP_LOGI(TAG_METRICS, "Started metrics task");
-            } else {
-                ESP_LOGW(TAG_METRICS, "Failed to start metrics task (xTaskCreate returned %d)", (int)xres);
-                s_metrics_task_handle = NULL;
-            }
-        }
-        
-        /* Start reconnect task if not already running */
-        if (s_reconnect_task_handle == NULL) {
-            BaseType_t xres = xTaskCreate(wifi_reconnect_task, "wifi_reconnect", 4096, NULL, 4, &s_reconnect_task_handle);
-            if (xres == pdPASS) {
-                ESP_LOGI(TAG_CONN, "Started WiFi reconnect task");
+                /* The session may have ended meanwhile: then it is not published and goes away here */
+                portENTER_CRITICAL(&s_metrics_lock);
+                bool keep = s_session_active;
+                if (keep) s_metrics_task_handle = h;
+                portEXIT_CRITICAL(&s_metrics_lock);
+                if (keep) {
+                    ESP_LOGI(TAG_METRICS, "Started metrics task");
+                } else {
+                    vTaskDelete(h);
+                }
             } else {
-                ESP_LOGW(TAG_CONN, "Failed to start reconnect task");
-                s_reconnect_task_handle = NULL;
+                ESP_LOGW(TAG_METRICS, "Failed to start metrics task (task create returned %d)", (int)xres);
             }
         }
     }
-}
\ No newline at end of file
+}
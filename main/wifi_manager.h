@@ -4,11 +4,18 @@
 /**
  * @file wifi_manager.h
  * @brief WiFi station mode configuration and management
- * 
- * This header file defines the WiFi configuration parameters and
- * declares functions for WiFi station mode initialization.
+ *
+ * The radio is duty cycled: it stays off until the uploader opens a session
+ * (wifi_session_begin), which joins a known network, and is switched off
+ * again when the session ends. Where each network was last joined (channel,
+ * BSSID) and how long scanning and joining took are learned per network and
+ * kept in NVS, so the next session can skip the full scan and size its
+ * timeouts.
  */
 
+#include <stdbool.h>
+#include <stdint.h>
+
 /* Required ESP-IDF components */
 #include "esp_wifi.h"      // Main WiFi driver
 #include "esp_event.h"     // Event handling
@@ -16,28 +23,52 @@
 #include "nvs_flash.h"     // Non-volatile storage
 
 /* WiFi Configuration Parameters */
-#define MAXIMUM_RETRY  10                  // Maximum connection attempts before giving up
+#define MAXIMUM_RETRY  10                  // Reconnects within a session before giving up
+#define WIFI_SCAN_MAX_APS  20              // Scan records kept (static buffer, strongest first)
+#define WIFI_SCAN_ATTEMPTS  2              // Full scans per session when no learned network answers
+#define WIFI_JOIN_MIN_MS    3000           // Shortest wait for an IP on a learned network
+#define WIFI_JOIN_MAX_MS    15000          // Wait for an IP when the network's timing is unknown
+#define WIFI_LEARN_MAX_FAILS  3            // Failed targeted joins before the learned channel is dropped
+#define WIFI_NVS_NAMESPACE  "wifi"
+
+typedef struct {
+    uint32_t sessions;          // radio switched on
+    uint32_t failed_sessions;   // no known network joined
+    uint32_t targeted_joins;    // joined on the learned channel, no full scan
+    uint32_t last_scan_ms;      // last full scan, 0 if skipped
+    uint32_t last_join_ms;      // connect -> IP of the last join
+    uint32_t radio_on_ms;       // total time the radio was on
+} wifi_duty_stats_t;
+
+/**
+ * @brief Initializes the TCP/IP stack, the WiFi driver and its event
+ * handlers and loads what was learned about the known networks. The radio
+ * stays off. NVS must already be initialized (boot NVS phase).
+ */
+esp_err_t wifi_init(void);
 
 /**
- * @brief Initializes and starts the WiFi station
- * 
- * This function:
- * 1. Initializes the TCP/IP stack
- * 2. Creates the WiFi station interface
- * 3. Configures the WiFi driver
- * 4. Sets up event handlers
- * 5. Starts the connection process
+ * @brief Switch the radio on and join a known network
+ *
+ * Networks joined before are tried first on their learned channel and BSSID,
+ * most reliable first, with a timeout derived from their join time;
+ * direct_connect networks follow. Only then is a full scan done, and the
+ * strongest known network joined.
+ *
+ * @return true once an IP address is assigned; on false the radio is off again
  */
-void wifi_init_sta(void);
+bool wifi_session_begin(void);
 
 /**
- * @brief Scan for available WiFi networks and connect to the strongest known one
- * 
- * This function:
- * 1. Performs a WiFi scan to discover available networks
- * 2. Compares found networks against KNOWN_NETWORKS list
- * 3. Connects to the network with the strongest signal (highest RSSI)
+ * @brief Disconnect and switch the radio off
  */
-void wifi_scan_and_connect(void);
+void wifi_session_end(void);
+
+/**
+ * @brief Returns true while the station has an IP address
+ */
+bool wifi_is_connected(void);
+
+void wifi_get_duty_stats(wifi_duty_stats_t *out);
 
-#endif // WIFI_MANAGER_H
\ No newline at end of file
+#endif // WIFI_MANAGER_H
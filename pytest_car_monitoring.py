@@ -0,0 +1,69 @@
+# SPDX-License-Identifier: CC0-1.0
+import json
+import time
+import urllib.error
+import urllib.request
+
+import pytest
+from pytest_embedded_idf.dut import IdfDut
+from pytest_embedded_idf.utils import idf_parametrize
+
+HEAP_GUARD_REPORTS = 3  # heap_guard logs every HEAP_GUARD_REPORT_SAMPLES polling cycles
+HTTP_API_PORT = 8080    # http_api.h on the linux target
+
+
+@pytest.mark.host_test
+@pytest.mark.parametrize('config', ['heap_strict'], indirect=True)
+@idf_parametrize('target', ['linux'], indirect=['target'])
+def test_steady_state_heap_free(dut: IdfDut) -> None:
+    # loopback transport: the polling task runs full cycles against the emulated ELM327;
+    # CONFIG_HEAP_GUARD_STRICT aborts at the first allocation after warm-up
+    samples = 0
+    for _ in range(HEAP_GUARD_REPORTS):
+        report = dut.expect(r'heap_guard: (\d+) samples, (\d+) violations, \d+ exempt allocations \(strict\)', timeout=120)
+        samples, violations = int(report.group(1)), int(report.group(2))
+        assert violations == 0, f'{violations} polling cycles allocated'
+    assert samples >= HEAP_GUARD_REPORTS * 32
+
+
+def _get(path: str) -> 'tuple[int, str, str]':
+    try:
+        with urllib.request.urlopen(f'http://127.0.0.1:{HTTP_API_PORT}{path}', timeout=10) as resp:
+            return resp.status, resp.headers.get('Content-Type', ''), resp.read().decode()
+    except urllib.error.HTTPError as e:
+        return e.code, e.headers.get('Content-Type', ''), e.read().decode()
+
+
+@pytest.mark.host_test
+@idf_parametrize('target', ['linux'], indirect=['target'])
+def test_data_query(dut: IdfDut) -> None:
+    dut.expect(rf'http_api: listening on port {HTTP_API_PORT}', timeout=30)
+
+    # records reach the stick directory at the logger's flush (DATA_LOGGER_FLUSH_MS)
+    records = []
+    deadline = time.monotonic() + 60
+    while not records and time.monotonic() < deadline:
+        time.sleep(2)
+        status, ctype, body = _get('/data')
+        assert status == 200, body
+        assert ctype.startswith('application/x-ndjson')
+        lines = [json.loads(line) for line in body.splitlines() if line]
+        assert not lines or 'session' in lines[0], 'every session starts with its offset line'
+        records = [line for line in lines if 'ts' in line]
+    assert records, 'no records served by GET /data'
+
+    # one channel: every record reduced to ts and rpm, time range honoured
+    status, _, body = _get('/data?channels=rpm')
+    assert status == 200, body
+    offset = 0
+    for line in (json.loads(line) for line in body.splitlines() if line):
+        if 'session' in line:
+            offset = line['offset_ms']
+            continue
+        assert set(line) <= {'ts', 'rpm'}, line
+    last_epoch = records[-1]['ts'] + offset
+    status, _, body = _get(f'/data?from={last_epoch + 1}&to={last_epoch + 1}')
+    assert status == 200 and all('ts' not in json.loads(line) for line in body.splitlines() if line)
+
+    assert _get('/data?from=10&to=5')[0] == 400
+    assert _get('/data?channels=nope')[0] == 400
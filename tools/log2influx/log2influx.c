@@ -0,0 +1,598 @@
+/*
+ * log2influx - bulk import of the stick's log directory into InfluxDB.
+ *
+ * Every segment under the directory is memory mapped, cut into jobs of
+ * JOB_BYTES at line boundaries and converted to line protocol by a pool of
+ * threads. Each thread fills its own batch and writes it to the output file
+ * (one lock per batch) or POSTs it to an HTTP write endpoint over its own
+ * keep-alive connection.
+ *
+ * Records are the lines written by the data logger:
+ *     {"ts":12345, "rpm":2500, "speed":85}
+ * Files under a session directory (sNNNNN) carry milliseconds since boot;
+ * the session's offset from clockmap.txt turns them into epoch milliseconds,
+ * exactly as the on-board uploader does. Files outside a session directory
+ * are taken as epoch milliseconds already. Output timestamps are in ms, so
+ * write with precision=ms.
+ *
+ *   log2influx [options] <logdir>
+ *     -o FILE      write line protocol to FILE (default stdout)
+ *     -u URL       POST batches to URL instead, e.g.
+ *                  http://localhost:8086/api/v2/write?org=o&bucket=car&precision=ms
+ *     -a TOKEN     send "Authorization: Token TOKEN"
+ *     -m NAME      measurement (default "obd")
+ *     -t K=V,...   extra tags on every point
+ *     -c FILE      clock map (default <logdir>/clockmap.txt)
+ *     -j N         threads (default: online CPUs)
+ *     -b N         lines per batch (default 5000)
+ *     -r           keep sessions without a clock mapping (raw ms since boot)
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+
+#define JOB_BYTES           (4u << 20)  // work unit: 4 MB of a segment
+#define DEFAULT_BATCH_LINES 5000
+#define LINE_SLACK          96          // line protocol growth over the JSON line (tags, ts)
+#define MAX_PREFIX          512
+#define MAX_MAPS            4096
+
+typedef struct {
+    char path[512];
+    bool has_session;
+    uint32_t session;
+    const char *data;
+    size_t len;             // logical end, see segment_end()
+    size_t map_len;
+    int64_t offset_ms;
+} log_file_t;
+
+typedef struct {
+    int file;
+    size_t start, end;
+} job_t;
+
+typedef struct {
+    uint32_t session;
+    int64_t offset_ms;
+} clock_map_t;
+
+static struct {
+    const char *out_path;
+    const char *url;
+    const char *token;
+    const char *measurement;
+    const char *tags;
+    const char *clockmap;
+    int threads;
+    int batch_lines;
+    bool raw;
+} s_opt = { .measurement = "obd", .batch_lines = DEFAULT_BATCH_LINES };
+
+static log_file_t *s_files;
+static int s_nfiles, s_files_cap;
+static job_t *s_jobs;
+static int s_njobs;
+static int s_next_job;
+
+static clock_map_t s_maps[MAX_MAPS];
+static int s_nmaps;
+
+static FILE *s_out;
+static pthread_mutex_t s_out_lock = PTHREAD_MUTEX_INITIALIZER;
+static char s_host[256], s_port[16], s_path[1024];
+
+static uint64_t s_records, s_skipped, s_bytes_in, s_bytes_out;
+static int s_failed;
+
+/* ---- scanning ---- */
+
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+// Nonzero iff some byte of v is zero; the lowest flagged byte is exact
+static inline uint64_t zero_bytes(uint64_t v)
+{
+    return (v - ONES) & ~v & HIGHS;
+}
+
+// First ',' or '}' in [p, e), e if none. Eight bytes per step (SWAR): no
+// per-byte branch, and the compiler is free to vectorize the word loop.
+static const char *find_delim(const char *p, const char *e)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (p + 8 <= e) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        uint64_t m = zero_bytes(w ^ (ONES * ',')) | zero_bytes(w ^ (ONES * '}'));
+        if (m) return p + (__builtin_ctzll(m) >> 3);
+        p += 8;
+    }
+#endif
+    while (p < e && *p != ',' && *p != '}') p++;
+    return p;
+}
+
+static char *put_i64(char *o, int64_t v)
+{
+    char tmp[24];
+    int n = 0;
+    uint64_t u = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+    do {
+        tmp[n++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0) *o++ = '-';
+    while (n) *o++ = tmp[--n];
+    return o;
+}
+
+// One JSON record [p, e) -> "prefix k=v,k=v ts\n". Returns bytes written, 0 if not a record.
+static size_t convert_line(const char *p, const char *e, const char *prefix, size_t prefix_len,
+                           int64_t offset_ms, char *out)
+{
+    static const char head[] = "{\"ts\":";
+    if (e - p < (ptrdiff_t)sizeof(head) || memcmp(p, head, sizeof(head) - 1) != 0) return 0;
+    const char *q = p + sizeof(head) - 1;
+    bool neg = *q == '-';
+    if (neg) q++;
+    int64_t ts = 0;
+    const char *digits = q;
+    while (q < e && (unsigned)(*q - '0') < 10) ts = ts * 10 + (*q++ - '0');
+    if (q == digits) return 0;
+    if (neg) ts = -ts;
+
+    char *o = out;
+    memcpy(o, prefix, prefix_len);
+    o += prefix_len;
+    *o++ = ' ';
+    char *fields = o;
+    while (q < e && *q != '}') {
+        const char *k = memchr(q, '"', (size_t)(e - q));
+        if (!k) break;
+        k++;
+        const char *ke = memchr(k, '"', (size_t)(e - k));
+        if (!ke) return 0;
+        const char *v = ke + 1;
+        while (v < e && (*v == ':' || *v == ' ')) v++;
+        const char *ve = find_delim(v, e);
+        if (ve == v) return 0;
+        if (o != fields) *o++ = ',';
+        memcpy(o, k, (size_t)(ke - k));
+        o += ke - k;
+        *o++ = '=';
+        memcpy(o, v, (size_t)(ve - v));
+        o += ve - v;
+        q = ve;
+        if (*q == ',') q++;
+    }
+    if (o == fields) return 0; // only a timestamp
+    *o++ = ' ';
+    o = put_i64(o, ts + offset_ms);
+    *o++ = '\n';
+    return (size_t)(o - out);
+}
+
+/* ---- output ---- */
+
+static int http_connect(void)
+{
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *res;
+    if (getaddrinfo(s_host, s_port, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo *a = res; a; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+static bool write_all(int fd, const char *p, size_t n)
+{
+    while (n) {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w <= 0) return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// POST one batch on a keep-alive connection; returns the HTTP status, -1 on I/O error
+static int http_post(int fd, const char *body, size_t len, bool *keep)
+{
+    char hdr[1536];
+    int n = snprintf(hdr, sizeof(hdr),
+                     "POST %s HTTP/1.1\r\nHost: %s:%s\r\nContent-Type: text/plain; charset=utf-8\r\n"
+                     "Content-Length: %zu\r\n%s%s%s\r\n",
+                     s_path, s_host, s_port, len,
+                     s_opt.token ? "Authorization: Token " : "", s_opt.token ? s_opt.token : "",
+                     s_opt.token ? "\r\n" : "");
+    if (!write_all(fd, hdr, (size_t)n) || !write_all(fd, body, len)) return -1;
+
+    char resp[4096];
+    size_t got = 0;
+    char *hend = NULL;
+    while (!hend) {
+        if (got == sizeof(resp) - 1) return -1;
+        ssize_t r = recv(fd, resp + got, sizeof(resp) - 1 - got, 0);
+        if (r <= 0) return -1;
+        got += (size_t)r;
+        resp[got] = '\0';
+        hend = strstr(resp, "\r\n\r\n");
+    }
+    int status = 0;
+    if (sscanf(resp, "HTTP/%*s %d", &status) != 1) return -1;
+    long body_len = 0;
+    const char *cl = strcasestr(resp, "\r\nContent-Length:");
+    if (cl) body_len = strtol(cl + 17, NULL, 10);
+    *keep = strcasestr(resp, "\r\nConnection: close") == NULL;
+    long have = (long)(got - (size_t)(hend + 4 - resp));
+    while (have < body_len) {
+        ssize_t r = recv(fd, resp, sizeof(resp), 0);
+        if (r <= 0) return -1;
+        have += r;
+    }
+    return status;
+}
+
+typedef struct {
+    char *buf;
+    size_t len, cap;
+    int lines;
+    int fd;             // HTTP connection, -1 if none
+} batch_t;
+
+static void batch_flush(batch_t *b)
+{
+    if (b->len == 0) return;
+    if (s_opt.url) {
+        int status = -1;
+        for (int attempt = 0; attempt < 2 && status < 0; attempt++) {
+            if (b->fd < 0) b->fd = http_connect();
+            if (b->fd < 0) break;
+            bool keep = false;
+            status = http_post(b->fd, b->buf, b->len, &keep);
+            if (status < 0 || !keep) {
+                close(b->fd);
+                b->fd = -1;
+            }
+        }
+        if (status < 200 || status > 299) {
+            fprintf(stderr, "log2influx: POST failed (status %d)\n", status);
+            __atomic_store_n(&s_failed, 1, __ATOMIC_RELAXED);
+            b->len = 0;
+            b->lines = 0;
+            return;
+        }
+    } else {
+        pthread_mutex_lock(&s_out_lock);
+        if (fwrite(b->buf, 1, b->len, s_out) != b->len) __atomic_store_n(&s_failed, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&s_out_lock);
+    }
+    __atomic_add_fetch(&s_bytes_out, b->len, __ATOMIC_RELAXED);
+    b->len = 0;
+    b->lines = 0;
+}
+
+/* ---- workers ---- */
+
+static size_t file_prefix(const log_file_t *f, char *out)
+{
+    int n = snprintf(out, MAX_PREFIX, "%s", s_opt.measurement);
+    if (f->has_session) n += snprintf(out + n, MAX_PREFIX - n, ",session=s%05u", f->session);
+    if (s_opt.tags) n += snprintf(out + n, MAX_PREFIX - n, ",%s", s_opt.tags);
+    return n < MAX_PREFIX ? (size_t)n : MAX_PREFIX - 1;
+}
+
+static void *worker(void *arg)
+{
+    (void)arg;
+    batch_t b = { .fd = -1 };
+    uint64_t records = 0, skipped = 0;
+
+    for (;;) {
+        int j = __atomic_fetch_add(&s_next_job, 1, __ATOMIC_RELAXED);
+        if (j >= s_njobs || __atomic_load_n(&s_failed, __ATOMIC_RELAXED)) break;
+        const log_file_t *f = &s_files[s_jobs[j].file];
+        char prefix[MAX_PREFIX];
+        size_t prefix_len = file_prefix(f, prefix);
+
+        // a job owns the lines that start inside [start, end)
+        const char *p = f->data + s_jobs[j].start;
+        const char *end = f->data + s_jobs[j].end;
+        const char *eof = f->data + f->len;
+        if (s_jobs[j].start > 0 && p[-1] != '\n') {
+            const char *nl = memchr(p, '\n', (size_t)(eof - p));
+            p = nl ? nl + 1 : eof;
+        }
+        while (p < end) {
+            const char *nl = memchr(p, '\n', (size_t)(eof - p));
+            const char *e = nl ? nl : eof;
+            size_t need = prefix_len + (size_t)(e - p) + LINE_SLACK;
+            if (b.len + need > b.cap) {
+                if (b.len) batch_flush(&b);
+                if (need > b.cap) {
+                    b.cap = need > (size_t)s_opt.batch_lines * 128 ? need : (size_t)s_opt.batch_lines * 128;
+                    b.buf = realloc(b.buf, b.cap);
+                    if (!b.buf) {
+                        perror("log2influx");
+                        exit(1);
+                    }
+                }
+            }
+            size_t n = nl ? convert_line(p, e, prefix, prefix_len, f->offset_ms, b.buf + b.len) : 0;
+            if (n) {
+                b.len += n;
+                records++;
+                if (++b.lines >= s_opt.batch_lines) batch_flush(&b);
+            } else {
+                skipped++; // malformed, or the last line cut by a power loss
+            }
+            p = e + 1;
+        }
+    }
+    batch_flush(&b);
+    if (b.fd >= 0) close(b.fd);
+    free(b.buf);
+    __atomic_add_fetch(&s_records, records, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s_skipped, skipped, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+/* ---- input ---- */
+
+static void load_clockmap(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned session;
+        long long mono, epoch;
+        if (sscanf(line, "%u %lld %lld", &session, &mono, &epoch) != 3) continue;
+        int i = 0;
+        while (i < s_nmaps && s_maps[i].session != session) i++;
+        if (i == s_nmaps) {
+            if (s_nmaps == MAX_MAPS) continue;
+            s_nmaps++;
+        }
+        s_maps[i] = (clock_map_t){ session, epoch - mono }; // later syncs win
+    }
+    fclose(f);
+}
+
+static bool session_offset(uint32_t session, int64_t *offset_ms)
+{
+    for (int i = 0; i < s_nmaps; i++) {
+        if (s_maps[i].session == session) {
+            *offset_ms = s_maps[i].offset_ms;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Logical end of a segment: a segment the logger never closed (power cut) has
+// its length in seg-NNNNN.end and a preallocated tail of stale clusters past it.
+static size_t segment_end(const char *path, size_t size)
+{
+    size_t n = strlen(path);
+    if (n < 5 || strcmp(path + n - 5, ".json") != 0) return size;
+    char end_path[520];
+    snprintf(end_path, sizeof(end_path), "%.*s.end", (int)(n - 5), path);
+    FILE *fp = fopen(end_path, "r");
+    if (!fp) return size;
+    long end = 0;
+    if (fscanf(fp, "%ld", &end) != 1 || end < 0) end = 0;
+    fclose(fp);
+    return (size_t)end < size ? (size_t)end : size;
+}
+
+static void add_file(const char *path, bool has_session, uint32_t session)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    const char *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return;
+    madvise((void *)data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    // not a log segment (trace dumps, other JSON)
+    if (st.st_size < 6 || memcmp(data, "{\"ts\":", 6) != 0) {
+        munmap((void *)data, (size_t)st.st_size);
+        return;
+    }
+    int64_t offset_ms = 0;
+    if (has_session && !session_offset(session, &offset_ms) && !s_opt.raw) {
+        fprintf(stderr, "log2influx: %s: session %u never synced NTP, skipped (-r keeps it)\n", path, session);
+        munmap((void *)data, (size_t)st.st_size);
+        return;
+    }
+
+    if (s_nfiles == s_files_cap) {
+        s_files_cap = s_files_cap ? s_files_cap * 2 : 64;
+        s_files = realloc(s_files, sizeof(*s_files) * (size_t)s_files_cap);
+        if (!s_files) {
+            perror("log2influx");
+            exit(1);
+        }
+    }
+    log_file_t *f = &s_files[s_nfiles++];
+    snprintf(f->path, sizeof(f->path), "%s", path);
+    f->has_session = has_session;
+    f->session = session;
+    f->data = data;
+    f->map_len = (size_t)st.st_size;
+    f->len = segment_end(path, (size_t)st.st_size);
+    f->offset_ms = offset_ms;
+    s_bytes_in += f->len;
+}
+
+static void walk(const char *dir, bool has_session, uint32_t session)
+{
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "log2influx: %s: %s\n", dir, strerror(errno));
+        return;
+    }
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            unsigned s;
+            char tail;
+            bool is_session = sscanf(e->d_name, "s%u%c", &s, &tail) == 1;
+            walk(path, is_session || has_session, is_session ? s : session);
+        } else {
+            size_t n = strlen(e->d_name);
+            if (n > 5 && strcmp(e->d_name + n - 5, ".json") == 0) add_file(path, has_session, session);
+        }
+    }
+    closedir(d);
+}
+
+static void make_jobs(void)
+{
+    size_t cap = 0;
+    for (int i = 0; i < s_nfiles; i++) cap += s_files[i].len / JOB_BYTES + 1;
+    s_jobs = malloc(sizeof(*s_jobs) * (cap ? cap : 1));
+    if (!s_jobs) {
+        perror("log2influx");
+        exit(1);
+    }
+    for (int i = 0; i < s_nfiles; i++) {
+        for (size_t off = 0; off < s_files[i].len; off += JOB_BYTES) {
+            size_t end = off + JOB_BYTES < s_files[i].len ? off + JOB_BYTES : s_files[i].len;
+            s_jobs[s_njobs++] = (job_t){ i, off, end };
+        }
+    }
+}
+
+static bool parse_url(const char *url)
+{
+    if (strncmp(url, "http://", 7) != 0) return false;
+    const char *h = url + 7;
+    const char *slash = strchr(h, '/');
+    size_t hl = slash ? (size_t)(slash - h) : strlen(h);
+    if (hl == 0 || hl >= sizeof(s_host)) return false;
+    memcpy(s_host, h, hl);
+    s_host[hl] = '\0';
+    char *colon = strrchr(s_host, ':');
+    if (colon) {
+        *colon = '\0';
+        snprintf(s_port, sizeof(s_port), "%s", colon + 1);
+    } else {
+        snprintf(s_port, sizeof(s_port), "80");
+    }
+    snprintf(s_path, sizeof(s_path), "%s", slash ? slash : "/");
+    return true;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: log2influx [-o file | -u url [-a token]] [-m measurement] [-t k=v,...]\n"
+                    "                  [-c clockmap] [-j threads] [-b lines] [-r] <logdir>\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "o:u:a:m:t:c:j:b:rh")) != -1) {
+        switch (c) {
+        case 'o': s_opt.out_path = optarg; break;
+        case 'u': s_opt.url = optarg; break;
+        case 'a': s_opt.token = optarg; break;
+        case 'm': s_opt.measurement = optarg; break;
+        case 't': s_opt.tags = optarg; break;
+        case 'c': s_opt.clockmap = optarg; break;
+        case 'j': s_opt.threads = atoi(optarg); break;
+        case 'b': s_opt.batch_lines = atoi(optarg); break;
+        case 'r': s_opt.raw = true; break;
+        default: usage();
+        }
+    }
+    if (optind != argc - 1 || s_opt.batch_lines <= 0) usage();
+    const char *logdir = argv[optind];
+    if (s_opt.url && !parse_url(s_opt.url)) {
+        fprintf(stderr, "log2influx: only http://host[:port]/path URLs are supported\n");
+        return 2;
+    }
+    if (s_opt.threads <= 0) s_opt.threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (s_opt.threads <= 0) s_opt.threads = 1;
+
+    char mappath[512];
+    if (!s_opt.clockmap) {
+        snprintf(mappath, sizeof(mappath), "%s/clockmap.txt", logdir);
+        s_opt.clockmap = mappath;
+    }
+    load_clockmap(s_opt.clockmap);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    walk(logdir, false, 0);
+    make_jobs();
+
+    s_out = stdout;
+    if (!s_opt.url && s_opt.out_path) {
+        s_out = fopen(s_opt.out_path, "w");
+        if (!s_out) {
+            fprintf(stderr, "log2influx: %s: %s\n", s_opt.out_path, strerror(errno));
+            return 1;
+        }
+    }
+
+    pthread_t *th = malloc(sizeof(*th) * (size_t)s_opt.threads);
+    if (!th) {
+        perror("log2influx");
+        return 1;
+    }
+    for (int i = 0; i < s_opt.threads; i++) pthread_create(&th[i], NULL, worker, NULL);
+    for (int i = 0; i < s_opt.threads; i++) pthread_join(th[i], NULL);
+    free(th);
+    if (s_out != stdout) fclose(s_out);
+    else fflush(stdout);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double secs = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    if (secs <= 0) secs = 1e-9;
+    fprintf(stderr, "log2influx: %llu records (%llu skipped) from %d files, %.1f MB in, %.1f MB out, "
+                    "%.3f s, %.0f records/s, %.1f MB/s, %d threads\n",
+            (unsigned long long)s_records, (unsigned long long)s_skipped, s_nfiles,
+            (double)s_bytes_in / 1e6, (double)s_bytes_out / 1e6, secs,
+            (double)s_records / secs, (double)s_bytes_in / 1e6 / secs, s_opt.threads);
+
+    for (int i = 0; i < s_nfiles; i++) munmap((void *)s_files[i].data, s_files[i].map_len);
+    free(s_files);
+    free(s_jobs);
+    return s_failed ? 1 : 0;
+}